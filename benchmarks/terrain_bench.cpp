@@ -0,0 +1,718 @@
+// Headless micro-benchmarks for the CPU-side generators (see CMakeLists.txt).
+//
+// Each case is timed with one warm-up run and then repeated until a time budget
+// is spent; min / median / mean wall time per run go into a JSON report (stdout,
+// or --out <file>) so results can be diffed between releases. A one-line summary
+// per case goes to stderr.
+//
+//   terrain_bench [--quick] [--out results.json]
+//
+// --quick shrinks the sweeps and the time budget for smoke runs.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "terrain/terraingenerator.h"
+#include "terrain/heightfield_query.h"
+#include "terrain/erosion.h"
+#include "terrain/voxel_chunk.h"
+#include "terrain/voxel_world.h"
+#include "terrain/noise.h"
+#include "vegetation/lsystem_tree.h"
+#include "particles/particle.h"
+#include "utils/bezier.h"
+#include "lut_utils.h"
+
+namespace {
+
+// results feed this so the optimizer cannot drop the timed work
+volatile double g_sink = 0.0;
+
+struct Param {
+    std::string key;
+    std::string value; // already JSON-encoded
+};
+
+struct Result {
+    std::string group, name;
+    std::vector<Param> params;
+    long long items = 1; // work items per run (samples, particles, ...)
+    int reps = 0;
+    double minMs = 0, medianMs = 0, meanMs = 0;
+};
+
+Param num(const std::string &key, double v) {
+    std::ostringstream s;
+    s << v;
+    return {key, s.str()};
+}
+Param str(const std::string &key, const std::string &v) { return {key, "\"" + v + "\""}; }
+
+class Bench {
+public:
+    Bench(bool quick, bool large) : m_quick(quick), m_large(large) {}
+
+    bool quick() const { return m_quick; }
+    // also run the cases that need several GB of memory
+    bool large() const { return m_large; }
+
+    // fn runs one repetition; items is the amount of work it does (for ns/item)
+    void run(const std::string &group, const std::string &name, std::vector<Param> params,
+             long long items, const std::function<void()> &fn)
+    {
+        using Clock = std::chrono::steady_clock;
+        const double budgetMs = m_quick ? 100.0 : 1000.0;
+        const int minReps = m_quick ? 1 : 3;
+        const int maxReps = m_quick ? 5 : 50;
+
+        fn(); // warm-up: page faults, caches, lazy tables
+
+        std::vector<double> times;
+        double total = 0.0;
+        while (int(times.size()) < minReps || (total < budgetMs && int(times.size()) < maxReps)) {
+            auto t0 = Clock::now();
+            fn();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            times.push_back(ms);
+            total += ms;
+        }
+
+        Result r;
+        r.group = group;
+        r.name = name;
+        r.params = std::move(params);
+        r.items = items;
+        r.reps = int(times.size());
+        std::sort(times.begin(), times.end());
+        r.minMs = times.front();
+        r.medianMs = times[times.size() / 2];
+        r.meanMs = total / times.size();
+
+        std::string shown;
+        for (const Param &p : r.params) shown += " " + p.key + "=" + p.value;
+        std::fprintf(stderr, "%-14s %-22s%-34s median %10.3f ms  %9.2f ns/item  (%d reps)\n",
+                     group.c_str(), name.c_str(), shown.c_str(), r.medianMs,
+                     r.medianMs * 1e6 / double(items), r.reps);
+        m_results.push_back(std::move(r));
+    }
+
+    std::string json() const
+    {
+        std::ostringstream s;
+        s << "{\n";
+        s << "  \"suite\": \"terrain_bench\",\n";
+        s << "  \"format\": 1,\n";
+        s << "  \"quick\": " << (m_quick ? "true" : "false") << ",\n";
+        s << "  \"large\": " << (m_large ? "true" : "false") << ",\n";
+        s << "  \"noise_backend\": \"" << Noise::backendName() << "\",\n";
+        s << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        s << "  \"results\": [\n";
+        for (size_t i = 0; i < m_results.size(); i++) {
+            const Result &r = m_results[i];
+            s << "    {\"group\": \"" << r.group << "\", \"name\": \"" << r.name << "\", \"params\": {";
+            for (size_t k = 0; k < r.params.size(); k++) {
+                s << (k ? ", " : "") << "\"" << r.params[k].key << "\": " << r.params[k].value;
+            }
+            s << "}, \"reps\": " << r.reps << ", \"items\": " << r.items
+              << ", \"min_ms\": " << r.minMs << ", \"median_ms\": " << r.medianMs
+              << ", \"mean_ms\": " << r.meanMs
+              << ", \"ns_per_item\": " << r.medianMs * 1e6 / double(r.items) << "}"
+              << (i + 1 < m_results.size() ? "," : "") << "\n";
+        }
+        s << "  ]\n}\n";
+        return s.str();
+    }
+
+private:
+    bool m_quick;
+    bool m_large;
+    std::vector<Result> m_results;
+};
+
+// Realtime::terrainParamsFromSettings at the default sliders (P1 = P2 = P3 = 1),
+// no extra credits, no erosion
+TerrainGenerator::TerrainParams defaultParams()
+{
+    TerrainGenerator::TerrainParams P;
+    P.baseFreq = 0.25f * std::pow(2.f, (1 - 5) / 3.f);
+    P.heightScale = 0.12f * 1;
+    P.warpStrength = 0.10f;
+    P.riverDepth = 0.0f;
+    P.seaLevel = -0.1f;
+    return P;
+}
+
+void enableStage(TerrainGenerator::TerrainParams &P, const std::string &stage)
+{
+    if (stage == "warp" || stage == "all") P.warpStrength = 0.2f;
+    if (stage == "terrace" || stage == "all") P.cliffSteps = 5;
+    if (stage == "rivers" || stage == "all") {
+        P.enableRivers = true;
+        P.riverFreq = 0.9f;
+        P.riverSharp = 1.7f;
+        P.riverThresh = 0.85f;
+        P.riverDepth = 0.1f;
+    }
+    if (stage == "craters" || stage == "all") {
+        P.enableCraters = true;
+        P.craterDensity = 4.0f;
+        P.craterRadius = 0.05f;
+        P.craterDepth = 0.32f;
+    }
+}
+
+// ===== cases ======================================================
+
+// A fresh generator per run: the heightfield stage cache would otherwise turn
+// every repetition after the first into a no-op.
+void benchTerrain(Bench &b)
+{
+    std::vector<int> meshRes = b.quick() ? std::vector<int>{128, 256}
+                                         : std::vector<int>{128, 256, 512, 1024};
+    if (b.large()) meshRes.push_back(2048);
+    std::vector<int> fieldRes = b.quick() ? std::vector<int>{128, 256, 512}
+                                          : std::vector<int>{128, 256, 512, 1024, 2048};
+    const TerrainGenerator::TerrainParams P = defaultParams();
+
+    // the unindexed vertex soup is 216 floats per quad; 2048^2 needs ~3.6 GB (--large)
+    for (int res : meshRes) {
+        b.run("terrain", "generateTerrain", {num("resolution", res)}, (long long)res * res, [&] {
+            TerrainGenerator gen;
+            gen.setParams(P);
+            gen.setResolution(res);
+            g_sink = g_sink + gen.generateTerrain().size();
+        });
+    }
+    for (int res : fieldRes) {
+        b.run("terrain", "generateTerrainIndexed", {num("resolution", res)}, (long long)res * res, [&] {
+            TerrainGenerator gen;
+            gen.setParams(P);
+            gen.setResolution(res);
+            g_sink = g_sink + gen.generateTerrainIndexed().vertices.size();
+        });
+    }
+    for (int workers : {1, 0}) {
+        for (int res : fieldRes) {
+            b.run("terrain", "buildHeightfield", {num("resolution", res), num("workers", workers)},
+                  (long long)(res + 3) * (res + 3), [&] {
+                TerrainGenerator gen;
+                gen.setParams(P);
+                gen.setResolution(res);
+                gen.setWorkerCount(workers);
+                g_sink = g_sink + gen.buildHeightfield().heights[0];
+            });
+        }
+    }
+}
+
+// full erosion pass on a 256 heightfield (droplet density 1, default params)
+void benchErosion(Bench &b)
+{
+    TerrainGenerator gen;
+    gen.setParams(defaultParams());
+    const TerrainGenerator::Heightfield &hf = gen.buildHeightfield();
+
+    HydraulicErosion::Params E;
+    E.density = b.quick() ? 0.25f : 1.0f;
+    const long long droplets = (long long)(E.density * hf.resolution * hf.resolution);
+    for (int workers : {1, 0}) {
+        b.run("erosion", "HydraulicErosion::run", {num("resolution", hf.resolution), num("density", E.density),
+              num("workers", workers)}, droplets, [&] {
+            HydraulicErosion erosion;
+            erosion.reset(hf.heights, hf.resolution, E, 1);
+            erosion.run(workers);
+            g_sink = g_sink + erosion.heights()[0];
+        });
+    }
+}
+
+// Analytic normals (TerrainGenerator::setAnalyticNormals) against the ring normals
+// they replace: the same mesh built both ways, with the angle between the two
+// normals of each vertex reported on the analytic run (max and mean, degrees).
+// River beds and crater rims are sharper than the grid spacing, so the ring
+// smooths them; there the error shrinks as the resolution grows.
+void benchAnalyticNormals(Bench &b)
+{
+    const std::vector<int> resolutions = b.quick() ? std::vector<int>{256} : std::vector<int>{256, 1024};
+    auto decode = [](const TerrainGenerator::TerrainVertex &v) {
+        glm::vec3 n(v.octX / 32767.f, v.octY / 32767.f, 0.f);
+        n.z = 1.f - std::abs(n.x) - std::abs(n.y);
+        if (n.z < 0.f) {
+            const glm::vec2 e(n.x, n.y);
+            n.x = (1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f);
+            n.y = (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f);
+        }
+        return glm::normalize(n);
+    };
+
+    for (int res : resolutions)
+    for (const char *stage : {"base", "warp", "terrace", "rivers", "craters", "all"}) {
+        TerrainGenerator::TerrainParams P = defaultParams();
+        enableStage(P, stage);
+        TerrainGenerator ring, analytic;
+        for (TerrainGenerator *gen : {&ring, &analytic}) {
+            gen->setParams(P);
+            gen->setResolution(res);
+        }
+        analytic.setAnalyticNormals(true);
+        if (!analytic.analyticNormalsSupported()) continue;
+
+        const TerrainGenerator::TerrainMesh a = ring.generateTerrainIndexed();
+        const TerrainGenerator::TerrainMesh c = analytic.generateTerrainIndexed();
+        double maxDeg = 0.0, sumDeg = 0.0;
+        for (size_t i = 0; i < a.vertices.size(); i++) {
+            const float cosine = glm::clamp(glm::dot(decode(a.vertices[i]), decode(c.vertices[i])), -1.f, 1.f);
+            const double deg = glm::degrees(std::acos(double(cosine)));
+            maxDeg = std::max(maxDeg, deg);
+            sumDeg += deg;
+        }
+
+        for (TerrainGenerator *gen : {&ring, &analytic}) {
+            const bool isAnalytic = gen == &analytic;
+            std::vector<Param> params = {num("resolution", res), str("stages", stage),
+                                         str("normals", isAnalytic ? "analytic" : "ring")};
+            if (isAnalytic) {
+                params.push_back(num("max_angle_deg", maxDeg));
+                params.push_back(num("mean_angle_deg", sumDeg / double(a.vertices.size())));
+            }
+            b.run("terrain", "generateTerrainIndexed", params, (long long)(res + 1) * (res + 1), [&] {
+                gen->setParams(P); // same params: only the mesh and normals are rebuilt
+                g_sink = g_sink + gen->generateTerrainIndexed().vertices.size();
+            });
+        }
+    }
+}
+
+// getHeight per optional stage: scalar (sampleHeight01 -> getHeight) and batched
+void benchHeightStages(Bench &b)
+{
+    const int n = b.quick() ? 16384 : 65536;
+    std::vector<float> xs(n), ys(n), out(n);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist01(0.f, 1.f);
+    for (int i = 0; i < n; i++) { xs[i] = dist01(rng); ys[i] = dist01(rng); }
+
+    for (const char *stage : {"base", "warp", "terrace", "rivers", "craters", "all"}) {
+        TerrainGenerator::TerrainParams P = defaultParams();
+        enableStage(P, stage);
+        TerrainGenerator gen;
+        gen.setParams(P);
+
+        b.run("height_stage", "getHeight", {str("stage", stage)}, n, [&] {
+            float acc = 0.f;
+            for (int i = 0; i < n; i++) acc += gen.sampleHeight01(xs[i], ys[i]);
+            g_sink = g_sink + acc;
+        });
+        b.run("height_stage", "heightBatch", {str("stage", stage)}, n, [&] {
+            gen.heightBatch(xs.data(), ys.data(), out.data(), n);
+            g_sink = g_sink + out[n / 2];
+        });
+    }
+}
+
+void benchLSystem(Bench &b)
+{
+    // one of buildForest's grammars
+    std::unordered_map<char, std::string> rules;
+    rules['X'] = "F[+FX][-FX][&FX][^FX]FX";
+    rules['F'] = "FF";
+
+    const int maxIter = b.quick() ? 4 : 5;
+    for (int iter = 1; iter <= maxIter; iter++) {
+        LSystemParams p;
+        p.iterations = iter;
+        size_t branches = 0;
+        {
+            LSystemTree probe(p);
+            probe.generate("X", rules);
+            branches = probe.branches().size();
+        }
+        b.run("lsystem", "generate", {num("iterations", iter)}, (long long)std::max<size_t>(branches, 1), [&] {
+            LSystemTree tree(p);
+            tree.generate("X", rules);
+            g_sink = g_sink + tree.branches().size() + tree.leaves().size();
+        });
+    }
+}
+
+// buildForest/buildRocks candidate tests: surface point + slope per candidate
+void benchPlacement(Bench &b)
+{
+    TerrainGenerator::TerrainParams P = defaultParams();
+    enableStage(P, "warp");
+    TerrainGenerator gen;
+    gen.setParams(P);
+    HeightfieldQuery query(gen.buildHeightfield());
+
+    for (int candidates : b.quick() ? std::vector<int>{1024} : std::vector<int>{1024, 16384}) {
+        std::vector<glm::vec2> uv(candidates);
+        std::mt19937 rng(5678);
+        std::uniform_real_distribution<float> dist01(0.f, 1.f);
+        for (glm::vec2 &p : uv) p = glm::vec2(dist01(rng), dist01(rng));
+
+        // centre plus two finite-difference taps through the noise chain
+        b.run("placement", "procedural_3tap", {num("candidates", candidates)}, candidates, [&] {
+            const float eps = 1.0f / 512.0f;
+            float acc = 0.f;
+            for (const glm::vec2 &p : uv) {
+                float h0 = gen.sampleSurfacePos(p.x, p.y).z;
+                float hx = gen.sampleSurfacePos(std::min(p.x + eps, 1.f), p.y).z;
+                float hy = gen.sampleSurfacePos(p.x, std::min(p.y + eps, 1.f)).z;
+                acc += h0 + (hx - h0) + (hy - h0);
+            }
+            g_sink = g_sink + acc;
+        });
+        b.run("placement", "heightfield_query", {num("candidates", candidates)}, candidates, [&] {
+            float acc = 0.f;
+            for (const glm::vec2 &p : uv) {
+                glm::vec2 g = query.gradient(p);
+                acc += query.height(p) + g.x + g.y;
+            }
+            g_sink = g_sink + acc;
+        });
+    }
+}
+
+using Storage = VoxelChunk::Storage;
+constexpr Storage kStorages[] = {Storage::Dense, Storage::Columns, Storage::Bricks};
+
+const char *storageName(Storage s)
+{
+    return s == Storage::Columns ? "columns" : s == Storage::Bricks ? "bricks" : "dense";
+}
+
+void benchVoxel(Bench &b)
+{
+    for (Storage storage : kStorages) {
+        for (bool greedy : {false, true}) {
+            for (int size : b.quick() ? std::vector<int>{32} : std::vector<int>{32, 64}) {
+                b.run("voxel", "VoxelChunk::build",
+                      {num("size", size), str("storage", storageName(storage)),
+                       str("mesher", greedy ? "greedy" : "naive")},
+                      (long long)size * size * size, [&] {
+                    VoxelChunk chunk;
+                    chunk.sx = chunk.sy = chunk.sz = size;
+                    chunk.storage = storage;
+                    chunk.greedy = greedy;
+                    g_sink = g_sink + chunk.build().size() + chunk.storageBytes();
+                });
+            }
+        }
+    }
+}
+
+// heightmap columns and storage fill only; ridge exponent 2 has its own fast path
+void benchVoxelGenerate(Bench &b)
+{
+    for (float ridgeExp : {2.f, 1.5f}) {
+        for (Storage storage : kStorages) {
+            const int size = 64;
+            b.run("voxel", "VoxelChunk::generate",
+                  {num("size", size), num("ridge_exp", ridgeExp), str("storage", storageName(storage))},
+                  (long long)size * size, [&] {
+                VoxelChunk chunk;
+                chunk.sx = chunk.sy = chunk.sz = size;
+                chunk.storage = storage;
+                chunk.ridgeExp = ridgeExp;
+                chunk.generate();
+                g_sink = g_sink + chunk.storageBytes();
+            });
+        }
+    }
+}
+
+// One dig or build of a radius-3 sphere on the surface of a generated chunk, then
+// the sections it dirtied remeshed, against remeshing every section.
+void benchVoxelEdit(Bench &b)
+{
+    const int size = 64;
+    for (Storage s : kStorages) {
+        VoxelChunk chunk;
+        chunk.sx = chunk.sy = chunk.sz = size;
+        chunk.greedy = true;
+        chunk.storage = s;
+        chunk.generate();
+        chunk.takeDirtySections();
+        const auto storage = str("storage", storageName(s));
+
+        int edit = 0;
+        b.run("voxel", "VoxelChunk::edit+remesh", {num("size", size), num("radius", 3), storage}, 1, [&] {
+            // alternate dig and build at the same spot, so the chunk stays put
+            const int x = 8 + (edit / 2) * 7 % (size - 16), z = 8 + (edit / 2) * 13 % (size - 16);
+            int y = size - 1;
+            while (y > 0 && !chunk.material(x, y, z)) y--;
+            chunk.fillSphere(glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f), 3.f, edit % 2 ? 1 : 0);
+            edit++;
+            for (int s : chunk.takeDirtySections()) g_sink = g_sink + chunk.meshSection(s).size();
+        });
+        b.run("voxel", "VoxelChunk::meshSections", {num("size", size), storage}, 1, [&] {
+            std::vector<float> vertices;
+            std::vector<uint32_t> sectionEnds;
+            chunk.meshSections(nullptr, vertices, sectionEnds);
+            g_sink = g_sink + vertices.size();
+        });
+    }
+}
+
+// A greedy section mesh of a generated chunk in the float and the packed vertex
+// layout, with and without ambient occlusion, with the vertex bytes each produces.
+void benchVoxelPacked(Bench &b)
+{
+    const int size = 64;
+    for (bool occlusion : {false, true}) {
+        VoxelChunk chunk;
+        chunk.sx = chunk.sy = chunk.sz = size;
+        chunk.greedy = true;
+        chunk.occlusion = occlusion;
+        chunk.storage = Storage::Columns;
+        chunk.generate();
+        std::vector<uint32_t> sectionEnds;
+
+        std::vector<float> floats;
+        chunk.meshSections(nullptr, floats, sectionEnds);
+        b.run("voxel", "VoxelChunk::meshSections",
+              {num("size", size), str("layout", "float"), num("occlusion", occlusion),
+               num("vertex_bytes", double(floats.size() * sizeof(float)))},
+              1, [&] {
+            std::vector<float> vertices;
+            chunk.meshSections(nullptr, vertices, sectionEnds);
+            g_sink = g_sink + vertices.size();
+        });
+
+        std::vector<VoxelChunk::PackedVertex> packed;
+        chunk.meshSections(nullptr, packed, sectionEnds);
+        b.run("voxel", "VoxelChunk::meshSections",
+              {num("size", size), str("layout", "packed"), num("occlusion", occlusion),
+               num("vertex_bytes", double(packed.size() * sizeof(VoxelChunk::PackedVertex)))},
+              1, [&] {
+            std::vector<VoxelChunk::PackedVertex> vertices;
+            chunk.meshSections(nullptr, vertices, sectionEnds);
+            g_sink = g_sink + vertices.size();
+        });
+    }
+}
+
+// A 256-tall chunk with terrain spanning most of its height: generation, then a
+// full section mesh against its four neighbours (as VoxelWorld meshes it), which
+// also reports the resident storage bytes.
+void benchVoxelTall(Bench &b)
+{
+    const int size = 64, height = 256;
+    for (Storage s : kStorages) {
+        VoxelChunk chunk;
+        chunk.sx = chunk.sz = size;
+        chunk.sy = height;
+        chunk.baseHeight = 96;
+        chunk.heightAmp = 128;
+        chunk.greedy = true;
+        chunk.storage = s;
+        b.run("voxel", "VoxelChunk::generate", {num("size", size), num("height", height), str("storage", storageName(s))},
+              (long long)size * size, [&] {
+            chunk.generate();
+            g_sink = g_sink + chunk.storageBytes();
+        });
+
+        VoxelChunk::Neighbours neighbours;
+        const glm::ivec3 offsets[4] = {{-size, 0, 0}, {size, 0, 0}, {0, 0, -size}, {0, 0, size}};
+        const int facing[4] = {1, 0, 3, 2};
+        for (int side = 0; side < 4; side++) {
+            VoxelChunk n = chunk;
+            n.origin = offsets[side];
+            n.generate();
+            n.edgeOccupancy(facing[side], neighbours.side[side]);
+        }
+        b.run("voxel", "VoxelChunk::meshSections",
+              {num("size", size), num("height", height), str("storage", storageName(s)),
+               num("storage_bytes", double(chunk.storageBytes()))},
+              (long long)size * height * size, [&] {
+            std::vector<float> vertices;
+            std::vector<uint32_t> sectionEnds;
+            chunk.meshSections(&neighbours, vertices, sectionEnds);
+            g_sink = g_sink + vertices.size();
+        });
+    }
+}
+
+// Streams a whole world from scratch around a still camera: every chunk within
+// one ring past the radius generated, every chunk within it meshed and polled.
+void benchVoxelWorld(Bench &b)
+{
+    VoxelChunk params;
+    params.sx = params.sz = 32;
+    params.sy = 64;
+    params.greedy = true;
+    params.storage = Storage::Columns;
+    const int radius = b.quick() ? 2 : 4;
+    const int meshes = (2 * radius + 1) * (2 * radius + 1);
+    for (int threads : {1, 4}) {
+        b.run("voxel", "VoxelWorld::stream", {num("radius", radius), num("threads", threads)},
+              (long long)meshes * params.sx * params.sz, [&] {
+            VoxelWorld world;
+            world.configure(params, radius);
+            world.start(threads);
+            int polled = 0;
+            while (polled < meshes) {
+                world.update(glm::vec3(16.f, 40.f, 16.f));
+                VoxelWorld::MeshResult r;
+                while (world.poll(r)) {
+                    polled++;
+                    g_sink = g_sink + r.vertices.size();
+                }
+                std::this_thread::yield();
+            }
+        });
+    }
+}
+
+// Batched ray casts into a streamed world: short rays down onto the terrain, and
+// long shallow rays over it that cross mostly empty sections and chunks.
+void benchVoxelRaycast(Bench &b)
+{
+    VoxelChunk params;
+    params.sx = params.sz = 32;
+    params.sy = 64;
+    params.storage = Storage::Columns;
+    const int radius = 2;
+    VoxelWorld world;
+    world.configure(params, radius);
+    world.start(1);
+    do {
+        world.update(glm::vec3(16.f, 40.f, 16.f));
+        VoxelWorld::MeshResult r;
+        while (world.poll(r)) {}
+        std::this_thread::yield();
+    } while (world.outstanding() > 0);
+
+    const int n = 4096;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> across(-48.f, 80.f), unit(-1.f, 1.f);
+    for (const char *kind : {"down", "shallow"}) {
+        const bool down = kind[0] == 'd';
+        std::vector<VoxelWorld::Ray> rays(n);
+        for (VoxelWorld::Ray &ray : rays) {
+            ray.origin = glm::vec3(across(rng), down ? 60.f : 48.f, across(rng));
+            ray.dir = down ? glm::vec3(0.2f * unit(rng), -1.f, 0.2f * unit(rng))
+                           : glm::vec3(unit(rng), -0.05f, unit(rng));
+            ray.maxDistance = down ? 64.f : 160.f;
+        }
+        std::vector<VoxelChunk::RayHit> hits(n);
+        b.run("voxel", "VoxelWorld::raycast", {num("rays", n), str("kind", kind)}, n, [&] {
+            g_sink = g_sink + world.raycast(rays.data(), n, hits.data());
+        });
+    }
+}
+
+void benchBezier(Bench &b)
+{
+    BezierSpline<glm::vec3> spline;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-10.f, 10.f);
+    for (int k = 0; k < 16; k++) spline.addKeyframe(glm::vec3(dist(rng), dist(rng), dist(rng)), float(k));
+
+    const int samples = b.quick() ? 20000 : 200000;
+    b.run("bezier", "evaluate", {num("keyframes", 16)}, samples, [&] {
+        glm::vec3 acc(0.f);
+        for (int i = 0; i < samples; i++) acc += spline.evaluate(15.f * float(i) / float(samples));
+        g_sink = g_sink + acc.x;
+    });
+}
+
+// ParticleSystem::update lives next to its GL code; this times the per-particle
+// integration step it runs for every particle each frame
+void benchParticles(Bench &b)
+{
+    const int frames = 60;
+    for (int count : {10000, 100000}) {
+        std::vector<Particle> particles(count);
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> dist01(0.f, 1.f);
+        for (Particle &p : particles) {
+            p.m_position = glm::vec3(dist01(rng), 25.f, dist01(rng));
+            p.m_velocity = glm::vec3(0.f, -1.f - dist01(rng), 0.f);
+            p.m_acceleration = glm::vec3(0.1f, 0.f, -0.1f);
+            p.m_lifeRemaining = 1e9f;
+        }
+        b.run("particles", "Particle::update", {num("particles", count), num("frames", frames)},
+              (long long)count * frames, [&] {
+            for (int f = 0; f < frames; f++)
+                for (Particle &p : particles) p.update(1.f / 60.f);
+            g_sink = g_sink + particles[0].m_position.y;
+        });
+    }
+}
+
+void benchLUT(Bench &b)
+{
+    for (int size : {16, 32, 64}) {
+        for (int preset : {0, 1, 3}) {
+            b.run("lut", "generateStyledLUT", {num("size", size), num("preset", preset)},
+                  (long long)size * size * size, [&] {
+                g_sink = g_sink + LUTUtils::generateStyledLUT(size, preset).size();
+            });
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bool quick = false, large = false;
+    const char *outPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--large") == 0) {
+            large = true;
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--large] [--out results.json]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Bench b(quick, large);
+    benchTerrain(b);
+    benchAnalyticNormals(b);
+    benchHeightStages(b);
+    benchErosion(b);
+    benchLSystem(b);
+    benchPlacement(b);
+    benchVoxel(b);
+    benchVoxelGenerate(b);
+    benchVoxelEdit(b);
+    benchVoxelPacked(b);
+    benchVoxelTall(b);
+    benchVoxelWorld(b);
+    benchVoxelRaycast(b);
+    benchBezier(b);
+    benchParticles(b);
+    benchLUT(b);
+
+    const std::string report = b.json();
+    if (outPath) {
+        std::ofstream out(outPath);
+        out << report;
+        if (!out) {
+            std::fprintf(stderr, "could not write %s\n", outPath);
+            return 1;
+        }
+    } else {
+        std::fputs(report.c_str(), stdout);
+    }
+    return 0;
+}
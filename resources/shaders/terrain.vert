@@ -23,8 +23,7 @@
 #version 330 core
 
 layout(location=0) in vec3 vertex;
-layout(location=1) in vec3 normal;
-layout(location=2) in vec3 inTex;   // 现在这就是 (u,v,0)
+layout(location=1) in vec2 octNormal; // octahedral-encoded normal in [-1,1]^2
 
 out vec3 v_worldPos;
 out vec3 v_worldNormal;
@@ -33,19 +32,44 @@ out vec2 v_uv;
 uniform mat4 uProj;
 uniform mat4 uView;
 uniform mat4 uModel;
+uniform float uUVScale; // texture repeats across the (0..1)^2 tile
+
+// GPU displacement: a flat grid takes z and its normal from textures
+uniform bool uDisplace;
+uniform sampler2D uHeightMap; // R32F, texel (s, t) = (col, row)
+uniform sampler2D uNormalMap; // RG16_SNORM octahedral normals, same layout
+uniform int uMapSize;         // texels per side = grid vertices per side
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
-    // 先算世界坐标（包含你的 R*S*T）:contentReference[oaicite:4]{index=4}
-    vec4 world = uModel * vec4(vertex, 1.0);
+    vec3 pos = vertex;
+    vec2 oct = octNormal;
+    if (uDisplace) {
+        // grid vertices sit exactly on texels: no filtering, same values as the mesh path
+        ivec2 texel = ivec2(vertex.yx * float(uMapSize - 1) + 0.5);
+        pos.z = texelFetch(uHeightMap, texel, 0).r;
+        oct = texelFetch(uNormalMap, texel, 0).rg;
+    }
+
+    // 先算世界坐标（包含你的 R*S*T）
+    vec4 world = uModel * vec4(pos, 1.0);
     v_worldPos = world.xyz;
 
     // normal matrix
     mat3 Nmat = transpose(inverse(mat3(uModel)));
-    v_worldNormal = normalize(Nmat * normal);
+    v_worldNormal = normalize(Nmat * octDecode(oct));
 
-    // 把 attribute2 的 xy 当成 UV
-    v_uv = inTex.xy;
+    // UV from the grid position (vertex.xy = grid index / resolution)
+    v_uv = vertex.xy * uUVScale;
 
     gl_Position = uProj * uView * world;
 }
@@ -0,0 +1,66 @@
+#version 330 core
+
+// CDLOD terrain: one shared grid drawn per quadtree patch, heights from a texture.
+// Outputs match terrain.vert, so terrain.frag shades both paths.
+
+layout(location=0) in vec2 gridPos;    // [0,1]^2 on the shared patch grid
+layout(location=1) in vec4 patchInfo;  // per instance: local min corner.xy, size, lod level
+
+out vec3 v_worldPos;
+out vec3 v_worldNormal;
+out vec2 v_uv;
+
+uniform mat4 uProj;
+uniform mat4 uView;
+uniform mat4 uModel;
+uniform float uUVScale;    // texture repeats across the (0..1)^2 tile
+// world-space eye the patches were selected for; every pass (the mirrored reflection
+// too) morphs with it, so neighbouring patches meet. Lighting uses terrain.frag's uEye.
+uniform vec3 uMorphEye;
+
+uniform sampler2D uHeightTex; // R32F heightfield incl. one-sample apron, texel (s, t) = (col, row)
+uniform float uHeightRes;     // quads per side of the heightfield (apron excluded)
+uniform float uGridDim;       // quads per side of the grid mesh being drawn
+uniform vec2 uMorph[16];      // per lod level: (morph start, morph end) in world units
+
+float heightAt(vec2 p)
+{
+    // local (x, y) -> texel centre of sample (row = x * res, col = y * res)
+    vec2 uv = (p.yx * uHeightRes + 1.5) / (uHeightRes + 3.0);
+    return textureLod(uHeightTex, uv, 0.0).r;
+}
+
+void main()
+{
+    vec2 origin = patchInfo.xy;
+    float size  = patchInfo.z;
+    int   level = int(patchInfo.w);
+
+    // distance at the unmorphed position decides how far to fold onto the coarser grid
+    vec2 local = origin + gridPos * size;
+    vec3 world = (uModel * vec4(local, heightAt(local), 1.0)).xyz;
+    vec2 band  = uMorph[level];
+    float k    = clamp((distance(world, uMorphEye) - band.x) / (band.y - band.x), 0.0, 1.0);
+
+    // odd grid vertices slide onto their even neighbours: at k = 1 this patch
+    // matches the next level's grid exactly, so neighbours meet without cracks
+    vec2 odd = fract(gridPos * uGridDim * 0.5) * 2.0 / uGridDim;
+    local = origin + (gridPos - odd * k) * size;
+
+    float h = heightAt(local);
+    vec4 worldPos = uModel * vec4(local, h, 1.0);
+    v_worldPos = worldPos.xyz;
+
+    // central differences at heightfield spacing
+    float d  = 1.0 / uHeightRes;
+    float hx = heightAt(local + vec2(d, 0.0)) - heightAt(local - vec2(d, 0.0));
+    float hy = heightAt(local + vec2(0.0, d)) - heightAt(local - vec2(0.0, d));
+    vec3 n = normalize(vec3(-hx, -hy, 2.0 * d));
+
+    mat3 Nmat = transpose(inverse(mat3(uModel)));
+    v_worldNormal = normalize(Nmat * n);
+
+    v_uv = local * uUVScale;
+
+    gl_Position = uProj * uView * worldPos;
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+in vec3 v_worldPos;
+in vec3 v_worldNormal;
+in vec3 v_color;
+
+out vec4 fragColor;
+
+uniform vec3 uEye;
+
+// global sun + ambient light (consistent with terrain)
+uniform vec3 uSunDir;       // FROM light TO scene
+uniform vec3 uSunColor;
+uniform vec3 uAmbientColor;
+
+uniform bool  uEnableFog;
+uniform vec3  uFogColor;
+uniform float uFogDensity;
+
+void main()
+{
+    vec3 N = normalize(v_worldNormal);
+    vec3 L = normalize(-uSunDir);  // light comes from -dir
+
+    float NdotL = max(dot(N, L), 0.0);
+    vec3 color = v_color * (uAmbientColor + NdotL * uSunColor);
+
+    // simple distance fog: using world-space distance
+    if (uEnableFog) {
+        float dist = length(uEye - v_worldPos);
+        float fog  = clamp(1.0 - exp(-uFogDensity * dist), 0.0, 1.0);
+        color = mix(color, uFogColor, fog);
+    }
+
+    fragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+// VoxelChunk::PackedVertex: a = x | z << 12 | face << 24,
+// b = y | material << 16 | occlusion level << 24, chunk-local voxel units
+layout(location = 0) in uvec2 a_packed;
+
+// uniform scale + translation, so normals need no normal matrix
+uniform mat4 uModel;
+uniform mat4 uView;
+uniform mat4 uProj;
+
+uniform vec3 uChunkOrigin;   // of the mesh being drawn, in voxels
+uniform vec3 uPalette[3];    // VoxelChunk::materialColor per material
+
+out vec3 v_worldPos;
+out vec3 v_worldNormal;
+out vec3 v_color;
+
+// face directions in VoxelChunk order
+const vec3 kNormals[6] = vec3[6](vec3(0, 1, 0), vec3(0, -1, 0), vec3(-1, 0, 0),
+                                 vec3(1, 0, 0), vec3(0, 0, -1), vec3(0, 0, 1));
+
+void main()
+{
+    uint a = a_packed.x, b = a_packed.y;
+    vec3 pos  = vec3(float(a & 0xFFFu), float(b & 0xFFFFu), float((a >> 12) & 0xFFFu));
+    uint face = (a >> 24) & 0xFFu;
+    uint material = min((b >> 16) & 0xFFu, 2u);
+    float level   = float((b >> 24) & 3u);
+
+    vec4 world = uModel * vec4(uChunkOrigin + pos, 1.0);
+    v_worldPos    = world.xyz;
+    v_worldNormal = kNormals[min(face, 5u)];
+    // VoxelChunk::occlusionShade
+    v_color       = uPalette[material] * (0.55 + 0.15 * level);
+
+    gl_Position = uProj * uView * world;
+}
@@ -25,6 +25,11 @@ uniform float u_waterClarity;
 uniform float u_fresnelPower;
 uniform float u_waveSpeed;
 
+// terrain heights as a texture (GPU displacement mode); uv is the terrain-local xy
+uniform bool uUseHeightMap;
+uniform sampler2D uTerrainHeight;  // R32F local heights, texel (s, t) = (col, row)
+uniform float uTerrainHeightScale; // local height -> world units
+
 
 
 // Fresnel
@@ -71,6 +76,12 @@ void main() {
     float floorDist = 2.0 * near * far / (far + near - (2.0 * floorDepth - 1.0) * (far - near));
     float waterDist = 2.0 * near * far / (far + near - (2.0 * waterDepthVal - 1.0) * (far - near));
     float waterDepth = floorDist - waterDist;
+    if (uUseHeightMap) {
+        // exact water column from the heightfield instead of the refraction depth buffer
+        vec2 ts = vec2(textureSize(uTerrainHeight, 0));
+        float h = texture(uTerrainHeight, (uv.yx * (ts - 1.0) + 0.5) / ts).r;
+        waterDepth = max(ws_pos.y - h * uTerrainHeightScale, 0.0);
+    }
     float depthFactor = clamp(waterDepth * u_waterClarity, 0.0, 1.0);
 
     vec3 waterBase = vec3(0.0, 0.3, 0.5);
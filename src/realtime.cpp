@@ -14,6 +14,7 @@
 #include <cmath>
 #include <glm/gtx/norm.hpp>
 #include <random>
+#include "utils/frustum.h"
 
 namespace
 {
@@ -41,11 +42,82 @@ namespace
         return lerp(1.0f, minFactor, s);
     }
 
+    // TerrainGenerator::TerrainVertex is uploaded as-is through GLIndexedMesh
+    static_assert(sizeof(TerrainGenerator::TerrainVertex) == sizeof(GLVertexPOct),
+                  "terrain vertex layout must match GLVertexPOct");
+    // and VoxelChunk::PackedVertex through GLSectionedMesh
+    static_assert(sizeof(VoxelChunk::PackedVertex) == sizeof(GLVertexVoxel),
+                  "voxel vertex layout must match GLVertexVoxel");
+
     inline float terrainSizeFromSlider(int v)
     {
         return 24.f + 4.f * float(v - 1); // v=10 => 24 + 36 = 60
     }
 
+    // Terrain-local bounds of an instance of a unit primitive (within [-0.5, 0.5]^3)
+    // drawn with the world matrix model; toLocal maps world to terrain-local space.
+    void instanceBounds(const glm::mat4 &model, const glm::mat4 &toLocal, glm::vec3 &lo, glm::vec3 &hi)
+    {
+        const glm::mat4 M = toLocal * model;
+        const glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(M[0])) + glm::abs(glm::vec3(M[1])) +
+                                         glm::abs(glm::vec3(M[2])));
+        lo = glm::vec3(M[3]) - extent;
+        hi = glm::vec3(M[3]) + extent;
+    }
+
+    // cell of the instance's origin on an n x n grid over the tile, row-major with x as the row
+    int instanceCell(const glm::mat4 &model, const glm::mat4 &toLocal, int n)
+    {
+        const glm::vec3 p = glm::vec3(toLocal * model[3]);
+        const int ix = std::clamp(int(std::floor(p.x * float(n))), 0, n - 1);
+        const int iy = std::clamp(int(std::floor(p.y * float(n))), 0, n - 1);
+        return ix * n + iy;
+    }
+
+    // Stable counting sort of instances by cell, so each cell's instances are one run.
+    template <typename T, typename ModelOf>
+    void sortInstancesByCell(std::vector<T> &items, ModelOf modelOf, const glm::mat4 &toLocal, int n)
+    {
+        std::vector<int> cells(items.size());
+        std::vector<size_t> start(size_t(n) * n + 1, 0);
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            cells[i] = instanceCell(modelOf(items[i]), toLocal, n);
+            start[cells[i] + 1]++;
+        }
+        for (size_t i = 1; i < start.size(); i++)
+            start[i] += start[i - 1];
+
+        std::vector<T> sorted(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            sorted[start[cells[i]]++] = std::move(items[i]);
+        items.swap(sorted);
+    }
+
+    // One group per run of consecutive instances in the same cell; instances sorted
+    // with sortInstancesByCell give one group per non-empty cell.
+    std::vector<InstanceGroup> groupInstances(std::span<const glm::mat4> models, const glm::mat4 &toLocal, int n)
+    {
+        std::vector<InstanceGroup> groups;
+        int current = -1;
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            const int cell = instanceCell(models[i], toLocal, n);
+            glm::vec3 lo, hi;
+            instanceBounds(models[i], toLocal, lo, hi);
+            if (cell != current)
+            {
+                groups.push_back({lo, hi, uint32_t(i), 0});
+                current = cell;
+            }
+            InstanceGroup &g = groups.back();
+            g.min = glm::min(g.min, lo);
+            g.max = glm::max(g.max, hi);
+            g.count++;
+        }
+        return groups;
+    }
+
 }
 
 // helper functions
@@ -156,6 +228,23 @@ void Realtime::calculateFrustumCorners(glm::vec3 corners[4]) const {
     corners[3] = (nearCenter + halfRight - halfUp) - m_cam.eye;
 }
 
+// Surface point on the local (0..1)^2 tile from the uploaded heightfield, raised to
+// the sea level like TerrainGenerator::sampleSurfacePos.
+glm::vec3 Realtime::surfaceLocal(glm::vec2 uv) const
+{
+    float seaLocal = m_terrainParams.seaLevel * m_terrainParams.heightScale;
+    return glm::vec3(uv, std::max(m_heightQuery.height(uv), seaLocal));
+}
+
+// World-space height change per unit of u and v; flat where the sea clamps the surface.
+glm::vec2 Realtime::surfaceSlopeWorld(glm::vec2 uv) const
+{
+    float seaLocal = m_terrainParams.seaLevel * m_terrainParams.heightScale;
+    glm::vec2 g = m_heightQuery.height(uv) > seaLocal ? m_heightQuery.gradient(uv) : glm::vec2(0.f);
+    const glm::mat4 &M = m_terrainModel;
+    return glm::vec2(M[0][1] + M[2][1] * g.x, M[1][1] + M[2][1] * g.y);
+}
+
 void Realtime::buildForest() {
     const size_t maxBranches = 800000;
     const size_t maxLeaves = 1600000;
@@ -240,7 +329,7 @@ void Realtime::buildForest() {
         for (int tries = 0; tries < 32 && !foundCenter; ++tries)
         {
             glm::vec2 uv(dist01(rng), dist01(rng));
-            glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
+            glm::vec3 surfLocal = surfaceLocal(uv);
             glm::vec3 surfWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
             if (surfWorld.y <= seaHeightWorld + seaMargin)
                 continue;
@@ -265,7 +354,7 @@ void Realtime::buildForest() {
             uv.x = clamp01(uv.x);
             uv.y = clamp01(uv.y);
 
-            glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
+            glm::vec3 surfLocal = surfaceLocal(uv);
             glm::vec3 pWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
 
             if (pWorld.y <= seaHeightWorld + seaMargin)
@@ -277,21 +366,11 @@ void Realtime::buildForest() {
                 0.0f, 1.0f);
 
             // Estimate normal -> Estimate slope
-            auto sampleHeightWorld = [&](float u, float v)
-            {
-                glm::vec2 uvc(clamp01(u), clamp01(v));
-                glm::vec3 pL = m_terrainGen.sampleSurfacePos(uvc.x, uvc.y);
-                glm::vec3 pW = glm::vec3(m_terrainModel * glm::vec4(pL, 1.f));
-                return pW.y;
-            };
-
             const float eps = 1.0f / 512.0f;
-            float h0 = pWorld.y;
-            float hdx = sampleHeightWorld(uv.x + eps, uv.y);
-            float hdy = sampleHeightWorld(uv.x, uv.y + eps);
+            glm::vec2 dh = surfaceSlopeWorld(uv) * eps;
 
-            glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
-            glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
+            glm::vec3 dx = glm::vec3(eps, dh.x, 0.f);
+            glm::vec3 dz = glm::vec3(0.f, dh.y, eps);
             glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
 
             // slope = 0 (flat), 1 (vertical)
@@ -410,15 +489,27 @@ void Realtime::buildForest() {
               << ", clusters=" << clusterCount
               << " (s4=" << s4 << ", s5=" << s5 << ", s6=" << s6 << ")\n";
 
-    // Upload branch instance matrix to VBO
-    m_branchInstanceCount = static_cast<GLsizei>(m_forestBranches.size());
+    // grouped by cell for culling (see uploadForestInstances)
+    const glm::mat4 toLocal = glm::inverse(m_terrainModel);
+    sortInstancesByCell(m_forestBranches, [](const BranchInstance &b) -> const glm::mat4 & { return b.model; },
+                        toLocal, m_instanceCellsPerSide);
+    sortInstancesByCell(m_forestLeaves, [](const glm::mat4 &M) -> const glm::mat4 & { return M; },
+                        toLocal, m_instanceCellsPerSide);
+
     std::vector<glm::mat4> branchModels;
-    branchModels.reserve(m_branchInstanceCount);
+    branchModels.reserve(m_forestBranches.size());
     for (const BranchInstance &b : m_forestBranches)
     {
         branchModels.push_back(b.model);
     }
+    uploadForestInstances(branchModels, m_forestLeaves);
+}
 
+void Realtime::uploadForestInstances(std::span<const glm::mat4> branchModels,
+                                     std::span<const glm::mat4> leaves)
+{
+    // Upload branch instance matrix to VBO
+    m_branchInstanceCount = static_cast<GLsizei>(branchModels.size());
     glBindBuffer(GL_ARRAY_BUFFER, m_branchInstanceVBO);
     glBufferData(GL_ARRAY_BUFFER,
                  branchModels.size() * sizeof(glm::mat4),
@@ -426,16 +517,20 @@ void Realtime::buildForest() {
                  GL_STATIC_DRAW);
 
     // Upload leaf instance matrix to VBO
-    m_leafInstanceCount = static_cast<GLsizei>(m_forestLeaves.size());
-    if (!m_forestLeaves.empty())
+    m_leafInstanceCount = static_cast<GLsizei>(leaves.size());
+    if (!leaves.empty())
     {
         glBindBuffer(GL_ARRAY_BUFFER, m_leafInstanceVBO);
         glBufferData(GL_ARRAY_BUFFER,
-                     m_forestLeaves.size() * sizeof(glm::mat4),
-                     m_forestLeaves.data(),
+                     leaves.size() * sizeof(glm::mat4),
+                     leaves.data(),
                      GL_STATIC_DRAW);
     }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const glm::mat4 toLocal = glm::inverse(m_terrainModel);
+    m_branchGroups = groupInstances(branchModels, toLocal, m_instanceCellsPerSide);
+    m_leafGroups = groupInstances(leaves, toLocal, m_instanceCellsPerSide);
 }
 
 void Realtime::buildRocks()
@@ -454,13 +549,10 @@ void Realtime::buildRocks()
     float seaHeightWorld = m_terrainParams.seaLevel;
     float heightScale = m_terrainParams.heightScale;
 
-    auto clamp01 = [](float v)
-    { return glm::clamp(v, 0.f, 1.f); };
-
     for (int i = 0; i < rockCount; ++i)
     {
         glm::vec2 uv(dist01(rng), dist01(rng));
-        glm::vec3 surfLocal = m_terrainGen.sampleSurfacePos(uv.x, uv.y);
+        glm::vec3 surfLocal = surfaceLocal(uv);
         glm::vec3 pWorld = glm::vec3(m_terrainModel * glm::vec4(surfLocal, 1.f));
 
         // Don't place rocks underwater (or maybe some near the shore)
@@ -468,21 +560,11 @@ void Realtime::buildRocks()
             continue;
 
         // Calculate slope
-        auto sampleHeightWorld = [&](float u, float v)
-        {
-            glm::vec2 uvc(clamp01(u), clamp01(v));
-            glm::vec3 pL = m_terrainGen.sampleSurfacePos(uvc.x, uvc.y);
-            glm::vec3 pW = glm::vec3(m_terrainModel * glm::vec4(pL, 1.f));
-            return pW.y;
-        };
-
         const float eps = 1.0f / 512.0f;
-        float h0 = pWorld.y;
-        float hdx = sampleHeightWorld(uv.x + eps, uv.y);
-        float hdy = sampleHeightWorld(uv.x, uv.y + eps);
+        glm::vec2 dh = surfaceSlopeWorld(uv) * eps;
 
-        glm::vec3 dx = glm::vec3(eps, hdx - h0, 0.f);
-        glm::vec3 dz = glm::vec3(0.f, hdy - h0, eps);
+        glm::vec3 dx = glm::vec3(eps, dh.x, 0.f);
+        glm::vec3 dz = glm::vec3(0.f, dh.y, eps);
         glm::vec3 nWorld = glm::normalize(glm::cross(dz, dx));
 
         float slope = glm::clamp(1.0f - glm::dot(nWorld, glm::vec3(0, 1, 0)), 0.0f, 1.0f);
@@ -525,17 +607,25 @@ void Realtime::buildRocks()
 
     std::cout << "[buildRocks] rocks=" << m_rocks.size() << "\n";
 
+    sortInstancesByCell(m_rocks, [](const glm::mat4 &M) -> const glm::mat4 & { return M; },
+                        glm::inverse(m_terrainModel), m_instanceCellsPerSide);
+    uploadRockInstances(m_rocks);
+}
+
+void Realtime::uploadRockInstances(std::span<const glm::mat4> rocks)
+{
     // Upload to VBO
-    m_rockInstanceCount = static_cast<GLsizei>(m_rocks.size());
-    if (!m_rocks.empty())
+    m_rockInstanceCount = static_cast<GLsizei>(rocks.size());
+    if (!rocks.empty())
     {
         glBindBuffer(GL_ARRAY_BUFFER, m_rockInstanceVBO);
         glBufferData(GL_ARRAY_BUFFER,
-                     m_rocks.size() * sizeof(glm::mat4),
-                     m_rocks.data(),
+                     rocks.size() * sizeof(glm::mat4),
+                     rocks.data(),
                      GL_STATIC_DRAW);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
+    m_rockGroups = groupInstances(rocks, glm::inverse(m_terrainModel), m_instanceCellsPerSide);
 }
 
 GLuint Realtime::loadTexture2D(const QString &path, bool srgb)
@@ -788,102 +878,108 @@ void Realtime::renderScene()
     }
 
     // terrain
-    if (m_hasTerrain && m_progTerrain)
+    if (m_voxelTerrain)
+        drawVoxelWorld(m_cam.view(), sunDir, sunColor, ambColor);
+    else if (m_hasTerrain && m_progTerrain)
     {
+        const GLuint terrainProg = activeTerrainProgram();
+
         glPolygonMode(GL_FRONT_AND_BACK, m_terrainWire ? GL_LINE : GL_FILL);
 
-        glUseProgram(m_progTerrain);
+        glUseProgram(terrainProg);
 
         auto set4 = [&](const char *n, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progTerrain, n),
+            glUniformMatrix4fv(glGetUniformLocation(terrainProg, n),
                                1, GL_FALSE, &M[0][0]);
         };
         set4("uProj", m_cam.proj());
         set4("uView", m_cam.view());
         set4("uModel", m_terrainModel);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "wireshade"),
+        glUniform1i(glGetUniformLocation(terrainProg, "wireshade"),
                     m_terrainWire ? 1 : 0);
+        glUniform1f(glGetUniformLocation(terrainProg, "uUVScale"),
+                    TerrainGenerator::kUVScale);
 
         // Lighting & Height Parameters
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uEye"), 1, &m_cam.eye[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uSunDir"), 1, &sunDir[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uSunColor"), 1, &sunColor[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uAmbientColor"), 1, &ambColor[0]);
 
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uEnableFog"), m_enableFog);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uFogDensity"), m_fogDensity);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uFogColor"), 1, &m_fogColor[0]);
+        glUniform1i(glGetUniformLocation(terrainProg, "uEnableFog"), m_enableFog);
+        glUniform1f(glGetUniformLocation(terrainProg, "uFogDensity"), m_fogDensity);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uFogColor"), 1, &m_fogColor[0]);
 
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
+        glUniform1f(glGetUniformLocation(terrainProg, "uSeaHeight"), m_seaHeightWorld);
+        glUniform1f(glGetUniformLocation(terrainProg, "uHeightScale"), m_heightScaleWorld);
 
         // normal intentisty
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
+        glUniform1f(glGetUniformLocation(terrainProg, "uNormalStrength"), 1.15f);
 
         // bind texture to sampler
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassAlbedo"), 0);
 
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockAlbedo"), 1);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachAlbedo"), 2);
 
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassNormal"), 3);
 
         glActiveTexture(GL_TEXTURE4);
         glBindTexture(GL_TEXTURE_2D, m_texRockNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockNormal"), 4);
 
         glActiveTexture(GL_TEXTURE5);
         glBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachNormal"), 5);
 
         glActiveTexture(GL_TEXTURE6);
         glBindTexture(GL_TEXTURE_2D, m_texGrassRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassRough"), 6);
 
         glActiveTexture(GL_TEXTURE7);
         glBindTexture(GL_TEXTURE_2D, m_texRockRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockRough"), 7);
 
         glActiveTexture(GL_TEXTURE8);
         glBindTexture(GL_TEXTURE_2D, m_texBeachRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachRough"), 8);
 
         glActiveTexture(GL_TEXTURE9);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighAlbedo"), 9);
 
         glActiveTexture(GL_TEXTURE10);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighNormal"), 10);
 
         glActiveTexture(GL_TEXTURE11);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighRough"), 11);
 
         glActiveTexture(GL_TEXTURE12);
         glBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowAlbedo"), 12);
 
         glActiveTexture(GL_TEXTURE13);
         glBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowNormal"), 13);
 
         glActiveTexture(GL_TEXTURE14);
         glBindTexture(GL_TEXTURE_2D, m_texSnowRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowRough"), 14);
 
-        m_terrainMesh.draw();
+        drawTerrainTiles(terrainProg, "uModel", false, m_cam.view());
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
@@ -896,7 +992,6 @@ void Realtime::renderScene()
 
         glUseProgram(m_progWater);
 
-        glUniformMatrix4fv(glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
         glUniform3fv(glGetUniformLocation(m_progWater, "ws_cam_pos"), 1, &m_cam.eye[0]);
@@ -905,16 +1000,20 @@ void Realtime::renderScene()
         glUniform1f(glGetUniformLocation(m_progWater, "uFogDensity"), m_fogDensity);
         glUniform3fv(glGetUniformLocation(m_progWater, "uFogColor"), 1, &m_fogColor[0]);
 
-        m_waterMesh.draw();
+        bindWaterHeightMap(5);
+        drawTerrainTiles(m_progWater, "model_matrix", true, m_cam.view());
 
         glDepthMask(GL_TRUE);
         glDisable(GL_BLEND);
     }
 
     // forest: use instance rendering shader
-    if (m_drawForest && m_treeCylinderMesh && m_branchInstanceCount > 0)
+    // trees and rocks stand on the heightmap terrain
+    if (m_drawForest && !m_voxelTerrain && m_treeCylinderMesh && m_branchInstanceCount > 0)
     {
         glUseProgram(m_progForest);
+        const Frustum instanceFrustum = Frustum::fromMatrix(m_cam.proj() * m_cam.view() * m_terrainModel);
+        const bool instanceHorizon = horizonCullingActive();
 
         auto setMat4 = [&](const char *name, const glm::mat4 &M)
         {
@@ -943,7 +1042,7 @@ void Realtime::renderScene()
         glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
         glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
 
-        m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
+        drawInstanceGroups(*m_treeCylinderMesh, m_branchInstanceVBO, m_branchGroups, instanceFrustum, instanceHorizon);
 
         // then, draw the leaves (green texture)
         if (m_leafMesh && m_leafInstanceCount > 0)
@@ -958,7 +1057,7 @@ void Realtime::renderScene()
             glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
             glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_leafMesh->drawInstanced(m_leafInstanceCount);
+            drawInstanceGroups(*m_leafMesh, m_leafInstanceVBO, m_leafGroups, instanceFrustum, instanceHorizon);
         }
 
         // then, draw the rocks (gray texture)
@@ -973,7 +1072,7 @@ void Realtime::renderScene()
             glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &rockKs[0]);
             glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_rockMesh->drawInstanced(m_rockInstanceCount);
+            drawInstanceGroups(*m_rockMesh, m_rockInstanceVBO, m_rockGroups, instanceFrustum, instanceHorizon);
         }
     }
 
@@ -984,7 +1083,7 @@ void Realtime::renderScene()
     }
 }
 
-void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
+void Realtime::renderSceneObject(const glm::mat4 &viewMatrix, bool horizonCull)
 {
     // global sun/ambient definition
     glm::vec3 sunDir = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
@@ -1034,108 +1133,117 @@ void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
     }
 
     // terrain
-    if (m_hasTerrain && m_progTerrain)
+    if (m_voxelTerrain)
+        drawVoxelWorld(viewMatrix, sunDir, sunColor, ambColor);
+    else if (m_hasTerrain && m_progTerrain)
     {
+        const GLuint terrainProg = activeTerrainProgram();
+
         glPolygonMode(GL_FRONT_AND_BACK, m_terrainWire ? GL_LINE : GL_FILL);
 
-        glUseProgram(m_progTerrain);
+        glUseProgram(terrainProg);
 
         auto set4 = [&](const char *n, const glm::mat4 &M)
         {
-            glUniformMatrix4fv(glGetUniformLocation(m_progTerrain, n),
+            glUniformMatrix4fv(glGetUniformLocation(terrainProg, n),
                                1, GL_FALSE, &M[0][0]);
         };
         set4("uProj", m_cam.proj());
         set4("uView", viewMatrix);
         set4("uModel", m_terrainModel);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "wireshade"),
+        glUniform1i(glGetUniformLocation(terrainProg, "wireshade"),
                     m_terrainWire ? 1 : 0);
+        glUniform1f(glGetUniformLocation(terrainProg, "uUVScale"),
+                    TerrainGenerator::kUVScale);
 
         // Lighting & Height Parameters
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uEye"), 1, &m_cam.eye[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uEye"), 1, &m_cam.eye[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunDir"), 1, &sunDir[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uSunColor"), 1, &sunColor[0]);
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uAmbientColor"), 1, &ambColor[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uSunDir"), 1, &sunDir[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uSunColor"), 1, &sunColor[0]);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uAmbientColor"), 1, &ambColor[0]);
 
-        glUniform3fv(glGetUniformLocation(m_progTerrain, "uFogColor"), 1, &fogColor[0]);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uFogDensity"), fogDensity);
+        glUniform3fv(glGetUniformLocation(terrainProg, "uFogColor"), 1, &fogColor[0]);
+        glUniform1f(glGetUniformLocation(terrainProg, "uFogDensity"), fogDensity);
 
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uSeaHeight"), m_seaHeightWorld);
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uHeightScale"), m_heightScaleWorld);
+        glUniform1f(glGetUniformLocation(terrainProg, "uSeaHeight"), m_seaHeightWorld);
+        glUniform1f(glGetUniformLocation(terrainProg, "uHeightScale"), m_heightScaleWorld);
 
         // normal intentisty
-        glUniform1f(glGetUniformLocation(m_progTerrain, "uNormalStrength"), 1.15f);
+        glUniform1f(glGetUniformLocation(terrainProg, "uNormalStrength"), 1.15f);
 
         // bind texture to sampler
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, m_texGrassAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassAlbedo"), 0);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassAlbedo"), 0);
 
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, m_texRockAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockAlbedo"), 1);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockAlbedo"), 1);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, m_texBeachAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachAlbedo"), 2);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachAlbedo"), 2);
 
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, m_texGrassNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassNormal"), 3);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassNormal"), 3);
 
         glActiveTexture(GL_TEXTURE4);
         glBindTexture(GL_TEXTURE_2D, m_texRockNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockNormal"), 4);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockNormal"), 4);
 
         glActiveTexture(GL_TEXTURE5);
         glBindTexture(GL_TEXTURE_2D, m_texBeachNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachNormal"), 5);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachNormal"), 5);
 
         glActiveTexture(GL_TEXTURE6);
         glBindTexture(GL_TEXTURE_2D, m_texGrassRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uGrassRough"), 6);
+        glUniform1i(glGetUniformLocation(terrainProg, "uGrassRough"), 6);
 
         glActiveTexture(GL_TEXTURE7);
         glBindTexture(GL_TEXTURE_2D, m_texRockRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockRough"), 7);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockRough"), 7);
 
         glActiveTexture(GL_TEXTURE8);
         glBindTexture(GL_TEXTURE_2D, m_texBeachRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uBeachRough"), 8);
+        glUniform1i(glGetUniformLocation(terrainProg, "uBeachRough"), 8);
 
         glActiveTexture(GL_TEXTURE9);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighAlbedo"), 9);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighAlbedo"), 9);
 
         glActiveTexture(GL_TEXTURE10);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighNormal"), 10);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighNormal"), 10);
 
         glActiveTexture(GL_TEXTURE11);
         glBindTexture(GL_TEXTURE_2D, m_texRockHighRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uRockHighRough"), 11);
+        glUniform1i(glGetUniformLocation(terrainProg, "uRockHighRough"), 11);
 
         glActiveTexture(GL_TEXTURE12);
         glBindTexture(GL_TEXTURE_2D, m_texSnowAlbedo);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowAlbedo"), 12);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowAlbedo"), 12);
 
         glActiveTexture(GL_TEXTURE13);
         glBindTexture(GL_TEXTURE_2D, m_texSnowNormal);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowNormal"), 13);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowNormal"), 13);
 
         glActiveTexture(GL_TEXTURE14);
         glBindTexture(GL_TEXTURE_2D, m_texSnowRough);
-        glUniform1i(glGetUniformLocation(m_progTerrain, "uSnowRough"), 14);
+        glUniform1i(glGetUniformLocation(terrainProg, "uSnowRough"), 14);
 
-        m_terrainMesh.draw();
+        drawTerrainTiles(terrainProg, "uModel", false, viewMatrix);
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
     // forest: use instance rendering shader
-    if (m_drawForest && m_treeCylinderMesh && m_branchInstanceCount > 0)
+    // trees and rocks stand on the heightmap terrain
+    if (m_drawForest && !m_voxelTerrain && m_treeCylinderMesh && m_branchInstanceCount > 0)
     {
         glUseProgram(m_progForest);
+        const Frustum instanceFrustum = Frustum::fromMatrix(m_cam.proj() * viewMatrix * m_terrainModel);
+        const bool instanceHorizon = horizonCull && horizonCullingActive();
 
         auto setMat4 = [&](const char *name, const glm::mat4 &M)
         {
@@ -1164,7 +1272,7 @@ void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
         glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &barkKs[0]);
         glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 12.f);
 
-        m_treeCylinderMesh->drawInstanced(m_branchInstanceCount);
+        drawInstanceGroups(*m_treeCylinderMesh, m_branchInstanceVBO, m_branchGroups, instanceFrustum, instanceHorizon);
 
         // then, draw the leaves (green texture)
         if (m_leafMesh && m_leafInstanceCount > 0)
@@ -1179,7 +1287,7 @@ void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
             glUniform3fv(glGetUniformLocation(m_progForest, "u_mat.ks"), 1, &leafKs[0]);
             glUniform1f(glGetUniformLocation(m_progForest, "u_mat.shininess"), 10.f);
 
-            m_leafMesh->drawInstanced(m_leafInstanceCount);
+            drawInstanceGroups(*m_leafMesh, m_leafInstanceVBO, m_leafGroups, instanceFrustum, instanceHorizon);
         }
 
         // then, draw the rocks (gray texture)
@@ -1200,7 +1308,7 @@ void Realtime::renderSceneObject(const glm::mat4 &viewMatrix)
             glUniform1i(glGetUniformLocation(m_progForest, "uTexture"), 15);
             glUniform1i(glGetUniformLocation(m_progForest, "uUseTexture"), 1);
 
-            m_rockMesh->drawInstanced(m_rockInstanceCount);
+            drawInstanceGroups(*m_rockMesh, m_rockInstanceVBO, m_rockGroups, instanceFrustum, instanceHorizon);
 
             // Reset
             glUniform1i(glGetUniformLocation(m_progForest, "uUseTexture"), 0);
@@ -1224,7 +1332,8 @@ void Realtime::renderReflection()
     glm::vec3 originalCamPos = m_cam.eye;
     m_cam.eye.y = 2.0f * WATER_HEIGHT - m_cam.eye.y;
 
-    renderSceneObject(mirroredView);
+    // the mirrored eye is below the water, the horizon does not apply to it
+    renderSceneObject(mirroredView, false);
     m_cam.eye = originalCamPos;
 
     glDisable(GL_CLIP_PLANE0);
@@ -1242,7 +1351,7 @@ void Realtime::renderRefraction()
     m_currentClipPlane = glm::vec4(0.0f, -1.0f, 0.0f, WATER_HEIGHT);
 
     // Use normal view matrix
-    renderSceneObject(m_cam.view());
+    renderSceneObject(m_cam.view(), true);
 
     glDisable(GL_CLIP_PLANE0);
 }
@@ -1289,9 +1398,6 @@ void Realtime::renderWater()
     glBindTexture(GL_TEXTURE_2D, m_waterDUDVTexture);
     glUniform1i(glGetUniformLocation(m_progWater, "u_dudvMap"), 4);
 
-    // Set MVP matrix for water quad
-    glUniformMatrix4fv(glGetUniformLocation(m_progWater, "model_matrix"), 1, GL_FALSE, &m_terrainModel[0][0]);
-
     // View & Proj
     glUniformMatrix4fv(glGetUniformLocation(m_progWater, "view_matrix"), 1, GL_FALSE, &m_cam.view()[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(m_progWater, "proj_matrix"), 1, GL_FALSE, &m_cam.proj()[0][0]);
@@ -1338,8 +1444,11 @@ void Realtime::renderWater()
     glUniform3fv(glGetUniformLocation(m_progWater, "light[0].pos"), 1, &zero[0]);
     glUniform3fv(glGetUniformLocation(m_progWater, "light[0].function"), 1, &zero[0]);
 
-    // draw water quad
-    m_waterMesh.draw();
+    // Terrain height map (GPU displacement mode)
+    bindWaterHeightMap(5);
+
+    // draw water quad(s)
+    drawTerrainTiles(m_progWater, "model_matrix", true, m_cam.view());
 
     // Restore depth writing and disable blending
     glUseProgram(0);
@@ -1376,6 +1485,11 @@ Realtime::Realtime(QWidget *parent)
     m_keyMap[Qt::Key_Space] = false;
 
     // If you must use this function, do not edit anything above this
+
+    // erosion advances per frame in timerEvent instead of blocking settingsChanged
+    // (or paintGL, for the CDLOD heightfield)
+    m_terrainGen.setIncrementalErosion(true);
+    m_cdlodGen.setIncrementalErosion(true);
 }
 
 void Realtime::rebuildWaterMesh()
@@ -1421,6 +1535,621 @@ void Realtime::rebuildWaterMesh()
     m_waterMesh.uploadinterleavedPNC(verts);
 }
 
+// ================== GPU displacement terrain
+
+// Regenerates the terrain for the current params: the full packed mesh, or only
+// the height/normal textures when GPU displacement is on. In mesh mode the
+// uploaded mesh is moved into *generated when given (for the world bake).
+void Realtime::uploadTerrain(TerrainGenerator::TerrainMesh *generated)
+{
+    if (!m_gpuDisplace)
+    {
+        TerrainGenerator::TerrainMesh terrain = buildTerrainMesh();
+        m_terrainMesh.uploadPackedPOct(terrain.vertices.data(), terrain.vertices.size(),
+                                       terrain.indices);
+        m_terrainPatches = TerrainPatches::build(terrain.vertices, terrain.indices, m_terrainPatchesPerSide);
+        m_horizon.build(terrain.vertices, terrain.indices, m_terrainGen.getResolution());
+        m_heightQuery = HeightfieldQuery(m_terrainGen.heightfield());
+        if (generated)
+            *generated = std::move(terrain);
+        return;
+    }
+
+    TerrainGenerator::TerrainMaps maps = m_terrainGen.generateTerrainMaps();
+    m_horizon.clear();
+    m_heightQuery = HeightfieldQuery(m_terrainGen.heightfield());
+
+    // the grid and texture storage only change with the resolution
+    if (maps.size != m_terrainMapSize)
+    {
+        TerrainGenerator::TerrainMesh grid = TerrainGenerator::flatGrid(maps.size - 1);
+        m_terrainGrid.uploadPackedPOct(grid.vertices.data(), grid.vertices.size(), grid.indices);
+
+        auto allocate = [&](GLuint &tex, GLint internalFormat, GLenum format, GLenum type, GLint filter)
+        {
+            if (!tex)
+                glGenTextures(1, &tex);
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, maps.size, maps.size, 0, format, type, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        };
+        // heights are filtered when the water shader samples them between vertices
+        allocate(m_texTerrainHeightMap, GL_R32F, GL_RED, GL_FLOAT, GL_LINEAR);
+        allocate(m_texTerrainNormalMap, GL_RG16_SNORM, GL_RG, GL_SHORT, GL_NEAREST);
+        m_terrainMapSize = maps.size;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainHeightMap);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, maps.size, maps.size, GL_RED, GL_FLOAT, maps.heights.data());
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainNormalMap);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, maps.size, maps.size, GL_RG, GL_SHORT, maps.normals.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TerrainGenerator::TerrainMesh Realtime::buildTerrainMesh()
+{
+    TerrainGenerator::TerrainMesh terrain = m_adaptiveTerrain
+        ? m_terrainGen.generateTerrainAdaptive(m_terrainTriangleBudget, m_terrainMaxError)
+        : m_terrainGen.generateTerrainIndexed();
+    TerrainPatches::sortByPatch(terrain, m_terrainPatchesPerSide);
+    return terrain;
+}
+
+// Runs one frame's slice of the terrain erosion. Rebuilding the mesh costs a few
+// ms, so the partly eroded terrain is re-uploaded a few times a second, and once
+// more at the end, when trees and rocks move onto the final ground.
+void Realtime::advanceErosion()
+{
+    m_terrainGen.stepErosion(m_erosionDropletsPerFrame, m_erosionBudgetMs);
+    const bool finished = !m_terrainGen.erosionPending();
+    if (!finished && m_erosionUploadTimer.isValid() && m_erosionUploadTimer.elapsed() < 250)
+        return;
+    m_erosionUploadTimer.start();
+
+    makeCurrent();
+    TerrainGenerator::TerrainMesh generated;
+    uploadTerrain(&generated);
+    if (finished)
+    {
+        if (m_drawForest)
+        {
+            buildForest();
+            buildRocks();
+        }
+        // GPU displacement leaves generated empty: nothing to bake
+        if (m_erosionBakeKey && !m_gpuDisplace && !generated.vertices.empty())
+            writeWorldBake(m_erosionBakeKey, generated);
+        m_erosionBakeKey = 0;
+    }
+    doneCurrent();
+    update();
+}
+
+// CDLOD's heightfield is a separate, larger generator: rebuildCDLOD only starts its
+// erosion, which then advances here, paced like advanceErosion.
+void Realtime::advanceCDLODErosion()
+{
+    m_cdlodGen.stepErosion(m_erosionDropletsPerFrame, m_erosionBudgetMs);
+    const bool finished = !m_cdlodGen.erosionPending();
+    if (!finished && m_cdlodErosionTimer.isValid() && m_cdlodErosionTimer.elapsed() < 250)
+        return;
+    m_cdlodErosionTimer.start();
+    m_cdlodDirty = true; // updateCDLOD picks up the progress
+    update();
+}
+
+// Called from drawTerrainTiles with m_progTerrain bound and the shared terrain uniforms set.
+void Realtime::drawDisplacedTerrain()
+{
+    glUniform1i(glGetUniformLocation(m_progTerrain, "uDisplace"), 1);
+    glUniform1i(glGetUniformLocation(m_progTerrain, "uMapSize"), m_terrainMapSize);
+
+    glActiveTexture(GL_TEXTURE15);
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainHeightMap);
+    glUniform1i(glGetUniformLocation(m_progTerrain, "uHeightMap"), 15);
+    glActiveTexture(GL_TEXTURE16);
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainNormalMap);
+    glUniform1i(glGetUniformLocation(m_progTerrain, "uNormalMap"), 16);
+
+    m_terrainGrid.draw();
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Lets the water shader read the terrain under it (only the single-tile height map exists).
+void Realtime::bindWaterHeightMap(int unit)
+{
+    const bool use = m_gpuDisplace && !m_streamTerrain && m_texTerrainHeightMap;
+    glUniform1i(glGetUniformLocation(m_progWater, "uUseHeightMap"), use ? 1 : 0);
+    if (!use)
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainHeightMap);
+    glUniform1i(glGetUniformLocation(m_progWater, "uTerrainHeight"), unit);
+    // local z -> world: length of the model's z column
+    glUniform1f(glGetUniformLocation(m_progWater, "uTerrainHeightScale"),
+                glm::length(glm::vec3(m_terrainModel[2])));
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// ================== World bake
+
+void Realtime::uploadBakedTerrain(const WorldBake::Contents &c)
+{
+    m_terrainMesh.uploadPackedPOct(c.vertices.data(), c.vertices.size(),
+                                   c.indices.data(), c.indices.size());
+    // baked indices were sorted by patch before they were written
+    m_terrainPatches = TerrainPatches::build(c.vertices, c.indices, m_terrainPatchesPerSide);
+    m_horizon.build(c.vertices, c.indices, c.resolution);
+
+    TerrainGenerator::Heightfield hf;
+    hf.resolution = c.resolution;
+    hf.heights.assign(c.heights.begin(), c.heights.end());
+    m_heightQuery = HeightfieldQuery(std::move(hf));
+}
+
+void Realtime::uploadBakedForest(const WorldBake::Contents &c)
+{
+    // instance VBOs come straight from the mapping; the CPU copies only mirror
+    // what buildForest/buildRocks would have left behind
+    uploadForestInstances(c.branchModels, c.leaves);
+    uploadRockInstances(c.rocks);
+
+    m_forestBranches.resize(c.branchModels.size());
+    for (size_t i = 0; i < c.branchModels.size(); i++)
+    {
+        m_forestBranches[i].model = c.branchModels[i];
+        m_forestBranches[i].radius = c.branchRadii[i];
+    }
+    m_forestLeaves.assign(c.leaves.begin(), c.leaves.end());
+    m_rocks.assign(c.rocks.begin(), c.rocks.end());
+}
+
+// Saves what settingsChanged just generated; terrain is the uploaded mesh.
+void Realtime::writeWorldBake(uint64_t key, const TerrainGenerator::TerrainMesh &terrain)
+{
+    std::vector<glm::mat4> branchModels;
+    std::vector<float> branchRadii;
+    if (m_drawForest)
+    {
+        branchModels.reserve(m_forestBranches.size());
+        branchRadii.reserve(m_forestBranches.size());
+        for (const BranchInstance &b : m_forestBranches)
+        {
+            branchModels.push_back(b.model);
+            branchRadii.push_back(b.radius);
+        }
+    }
+
+    const TerrainGenerator::Heightfield &hf = m_terrainGen.heightfield();
+    WorldBake::Contents c;
+    c.resolution = hf.resolution;
+    c.heights = hf.heights;
+    c.vertices = terrain.vertices;
+    c.indices = terrain.indices;
+    c.branchModels = branchModels;
+    c.branchRadii = branchRadii;
+    if (m_drawForest)
+    {
+        c.leaves = m_forestLeaves;
+        c.rocks = m_rocks;
+    }
+    WorldBake::write(WorldBake::pathFor(key), key, c);
+}
+
+// The terrain, forest and rocks of the settings at startup, through the same world
+// bake lookup as settingsChanged, which then finds them already built. Needs
+// m_terrainModel and the instance buffers.
+void Realtime::buildInitialTerrain()
+{
+    m_terrainParams = terrainParamsFromSettings();
+    m_terrainGen.setParams(m_terrainParams);
+    m_terrainKey = TerrainGenerator::paramsKey(m_terrainParams);
+    m_seaHeightWorld = m_terrainParams.seaLevel * m_terrainParams.heightScale * 10.f;
+    m_heightScaleWorld = m_terrainParams.heightScale * 10.f;
+    rebuildWaterMesh();
+
+    // the forest inputs of the key
+    m_drawForest = settings.extraCredit4;
+    m_forestSettings = glm::ivec3(settings.shapeParameter4, settings.shapeParameter5,
+                                  settings.shapeParameter6);
+    m_rockSettings = settings.shapeParameter7;
+    m_forestBuilt = m_drawForest;
+
+    const bool bakeable = !m_gpuDisplace && !m_streamTerrain;
+    const uint64_t bakeKey = worldBakeKey(m_terrainParams);
+    m_worldBakeKey = bakeKey;
+    WorldBake bake;
+    if (bakeable && bake.open(WorldBake::pathFor(bakeKey), bakeKey))
+    {
+        uploadBakedTerrain(bake.contents());
+        if (m_drawForest)
+            uploadBakedForest(bake.contents());
+        return;
+    }
+
+    TerrainGenerator::TerrainMesh generated;
+    uploadTerrain(&generated);
+    if (m_drawForest)
+    {
+        buildForest();
+        buildRocks();
+    }
+    if (!bakeable)
+        return;
+    if (m_terrainGen.erosionPending())
+        m_erosionBakeKey = bakeKey;
+    else
+        writeWorldBake(bakeKey, generated);
+}
+
+// ================== CDLOD terrain
+
+GLuint Realtime::activeTerrainProgram() const
+{
+    return (m_useCDLOD && !m_streamTerrain && m_progTerrainCDLOD) ? m_progTerrainCDLOD : m_progTerrain;
+}
+
+// Heightfield at m_cdlodResolution -> R32F texture + quadtree min/max.
+void Realtime::rebuildCDLOD()
+{
+    // kept between rebuilds so its height stages are reused (see buildHeightfield)
+    m_cdlodGen.setParams(m_terrainParams);
+    m_cdlodGen.setResolution(m_cdlodResolution);
+    const TerrainGenerator::Heightfield &hf = m_cdlodGen.buildHeightfield();
+
+    if (!m_texTerrainHeight)
+        glGenTextures(1, &m_texTerrainHeight);
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainHeight);
+    // rows of the heightfield are x, so texel (s, t) = (col, row); apron included
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, hf.stride(), hf.stride(), 0,
+                 GL_RED, GL_FLOAT, hf.heights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_cdlodTree.build(hf, m_cdlodGridDim);
+    m_cdlodTree.setRanges(m_cdlodBaseRange);
+
+    if (m_cdlodGrid.dim != m_cdlodGridDim)
+    {
+        m_cdlodGrid.create(m_cdlodGridDim);
+        m_cdlodGridHalf.create(m_cdlodGridDim / 2);
+    }
+    m_cdlodDirty = false;
+}
+
+// Once per frame: pick patches for the real camera. The mirrored reflection pass
+// reuses them, and drawCDLOD morphs every pass with this same eye (m_cdlodEye),
+// since a patch morphed for another eye no longer meets its neighbours.
+void Realtime::updateCDLOD()
+{
+    if (!m_useCDLOD || m_streamTerrain || !m_progTerrainCDLOD)
+        return;
+    if (m_cdlodDirty)
+        rebuildCDLOD();
+
+    m_cdlodEye = m_cam.eye;
+    glm::vec3 eyeLocal = glm::vec3(glm::inverse(m_terrainModel) * glm::vec4(m_cdlodEye, 1.f));
+    // scale part of m_terrainModel: lengths of its axis columns
+    const glm::vec3 metric(glm::length(glm::vec3(m_terrainModel[0])),
+                           glm::length(glm::vec3(m_terrainModel[1])),
+                           glm::length(glm::vec3(m_terrainModel[2])));
+    m_cdlodTree.select(eyeLocal, metric, m_cdlodFull, m_cdlodQuarters);
+
+    static_assert(sizeof(CDLODQuadtree::Patch) == 4 * sizeof(float), "patch must match the vec4 instance attribute");
+    m_cdlodGrid.uploadInstances(m_cdlodFull.data(), m_cdlodFull.size());
+    m_cdlodGridHalf.uploadInstances(m_cdlodQuarters.data(), m_cdlodQuarters.size());
+}
+
+// Called from drawTerrainTiles with m_progTerrainCDLOD bound and the shared terrain uniforms set.
+void Realtime::drawCDLOD()
+{
+    const GLuint prog = m_progTerrainCDLOD;
+
+    glActiveTexture(GL_TEXTURE15);
+    glBindTexture(GL_TEXTURE_2D, m_texTerrainHeight);
+    glUniform1i(glGetUniformLocation(prog, "uHeightTex"), 15);
+    glUniform1f(glGetUniformLocation(prog, "uHeightRes"), float(m_cdlodResolution));
+
+    std::vector<glm::vec2> morph(16, glm::vec2(0.f, 1.f));
+    for (int l = 0; l < std::min(m_cdlodTree.levels(), 16); l++)
+        morph[l] = m_cdlodTree.morphRange(l);
+    glUniform2fv(glGetUniformLocation(prog, "uMorph"), 16, &morph[0][0]);
+    // the selection's eye, not the pass's uEye (mirrored for the reflection)
+    glUniform3fv(glGetUniformLocation(prog, "uMorphEye"), 1, &m_cdlodEye[0]);
+
+    glUniform1f(glGetUniformLocation(prog, "uGridDim"), float(m_cdlodGrid.dim));
+    m_cdlodGrid.draw();
+    glUniform1f(glGetUniformLocation(prog, "uGridDim"), float(m_cdlodGridHalf.dim));
+    m_cdlodGridHalf.draw();
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// ================== Endless terrain
+
+void Realtime::drawTerrainTiles(GLuint prog, const char *modelUniform, bool water, const glm::mat4 &view)
+{
+    GLint loc = glGetUniformLocation(prog, modelUniform);
+    if (!m_streamTerrain)
+    {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, &m_terrainModel[0][0]);
+        if (water) m_waterMesh.draw();
+        else if (prog == m_progTerrainCDLOD) drawCDLOD();
+        else if (m_gpuDisplace) drawDisplacedTerrain();
+        else
+        {
+            glUniform1i(glGetUniformLocation(prog, "uDisplace"), 0);
+            drawTerrainPatches(view);
+        }
+        return;
+    }
+    if (!water)
+        glUniform1i(glGetUniformLocation(prog, "uDisplace"), 0);
+    for (const auto &[coord, tile] : m_tiles)
+    {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, &tile.model[0][0]);
+        if (water) m_waterMesh.draw();
+        else tile.mesh.draw();
+    }
+}
+
+// Each pass culls with its own view: the main camera, the mirrored reflection
+// camera and the refraction pass see different parts of the tile.
+void Realtime::drawTerrainPatches(const glm::mat4 &view)
+{
+    if (m_terrainPatches.empty())
+    {
+        m_terrainMesh.draw();
+        return;
+    }
+
+    const Frustum frustum = Frustum::fromMatrix(m_cam.proj() * view * m_terrainModel);
+    m_patchCounts.clear();
+    m_patchFirsts.clear();
+    for (const TerrainPatch &p : m_terrainPatches)
+    {
+        if (!frustum.intersects(p.min, p.max))
+            continue;
+        // patches are stored back to back: a visible neighbour extends the last range
+        if (!m_patchFirsts.empty() && m_patchFirsts.back() + GLuint(m_patchCounts.back()) == p.firstIndex)
+            m_patchCounts.back() += GLsizei(p.indexCount);
+        else
+        {
+            m_patchFirsts.push_back(p.firstIndex);
+            m_patchCounts.push_back(GLsizei(p.indexCount));
+        }
+    }
+    if (!m_patchCounts.empty())
+        m_terrainMesh.drawRanges(m_patchCounts, m_patchFirsts);
+}
+
+// The horizon only describes m_terrainMesh, so the other terrain modes skip it.
+bool Realtime::horizonCullingActive() const
+{
+    return m_horizonCulling && !m_streamTerrain && !m_useCDLOD && !m_gpuDisplace && !m_horizon.empty();
+}
+
+// Called once per frame, before the passes that draw trees and rocks.
+void Realtime::updateHorizon()
+{
+    if (!m_drawForest || !horizonCullingActive())
+        return;
+    m_horizon.update(glm::vec3(glm::inverse(m_terrainModel) * glm::vec4(m_cam.eye, 1.f)));
+}
+
+// frustum: built from proj * view * m_terrainModel, like the terrain patches';
+// horizon: also skip groups m_horizon hides (only valid for the main camera's eye)
+void Realtime::drawInstanceGroups(const GLMesh &mesh, GLuint instanceVbo, const std::vector<InstanceGroup> &groups,
+                                  const Frustum &frustum, bool horizon)
+{
+    m_instanceCounts.clear();
+    m_instanceFirsts.clear();
+    for (const InstanceGroup &g : groups)
+    {
+        if (!frustum.intersects(g.min, g.max) || (horizon && m_horizon.occluded(g.min, g.max)))
+            continue;
+        if (!m_instanceFirsts.empty() && m_instanceFirsts.back() + GLuint(m_instanceCounts.back()) == g.first)
+            m_instanceCounts.back() += GLsizei(g.count);
+        else
+        {
+            m_instanceFirsts.push_back(g.first);
+            m_instanceCounts.push_back(GLsizei(g.count));
+        }
+    }
+    mesh.drawInstancedRanges(instanceVbo, 2, m_instanceFirsts, m_instanceCounts);
+}
+
+void Realtime::clearTerrainTiles()
+{
+    for (auto &[coord, tile] : m_tiles)
+        tile.mesh.destroy();
+    m_tiles.clear();
+    m_tileBytes = 0;
+}
+
+// Called once per frame with the GL context current.
+void Realtime::updateTerrainTiles()
+{
+    if (!m_streamTerrain)
+        return;
+    m_frameIndex++;
+
+    // camera -> terrain-local (z-up, one unit per tile) -> tile coordinate
+    glm::vec3 local = glm::vec3(glm::inverse(m_terrainModel) * glm::vec4(m_cam.eye, 1.f));
+    const int cx = int(std::floor(local.x));
+    const int cy = int(std::floor(local.y));
+
+    // 1) everything inside the radius stays fresh in the LRU; missing tiles are
+    //    requested nearest-first so the streamer fills the centre before the rim
+    std::vector<std::pair<int, TileCoord>> missing;
+    for (int dy = -m_tileRadius; dy <= m_tileRadius; dy++)
+    {
+        for (int dx = -m_tileRadius; dx <= m_tileRadius; dx++)
+        {
+            TileCoord c{cx + dx, cy + dy};
+            auto it = m_tiles.find(c);
+            if (it != m_tiles.end())
+                it->second.lastUsedFrame = m_frameIndex;
+            else
+                missing.push_back({dx * dx + dy * dy, c});
+        }
+    }
+    std::sort(missing.begin(), missing.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::vector<TileCoord> wanted;
+    wanted.reserve(missing.size());
+    for (const auto &m : missing)
+        wanted.push_back(m.second);
+    m_tileStreamer.request(wanted);
+
+    // 2) upload finished tiles until this frame's budget is spent
+    QElapsedTimer budget;
+    budget.start();
+    TerrainTileStreamer::Result ready;
+    while (budget.nsecsElapsed() < qint64(m_tileUploadBudgetMs * 1e6f) && m_tileStreamer.poll(ready))
+    {
+        TerrainTile &tile = m_tiles[ready.coord];
+        tile.mesh.uploadPackedPOct(ready.mesh.vertices.data(), ready.mesh.vertices.size(),
+                                   ready.mesh.indices);
+        tile.model = m_terrainModel *
+                     glm::translate(glm::mat4(1.f), glm::vec3(ready.coord.x, ready.coord.y, 0.f));
+        tile.lastUsedFrame = m_frameIndex;
+        m_tileBytes += tile.mesh.byteSize;
+    }
+
+    // 3) evict least recently used tiles while over the memory cap
+    //    (tiles used this frame are never evicted, even if the cap is too small)
+    while (m_tileBytes > m_tileCacheBytes)
+    {
+        auto lru = m_tiles.end();
+        for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        {
+            if (lru == m_tiles.end() || it->second.lastUsedFrame < lru->second.lastUsedFrame)
+                lru = it;
+        }
+        if (lru == m_tiles.end() || lru->second.lastUsedFrame == m_frameIndex)
+            break;
+        m_tileBytes -= lru->second.mesh.byteSize;
+        lru->second.mesh.destroy();
+        m_tiles.erase(lru);
+    }
+}
+
+// ================== Voxel landscape
+
+void Realtime::startVoxelWorld()
+{
+    VoxelChunk params;
+    params.sx = params.sz = 32;
+    params.sy = 64;
+    params.greedy = true;
+    params.occlusion = true;
+    params.storage = VoxelChunk::Storage::Columns;
+    m_voxelWorld.configure(params, m_voxelRadius);
+    m_voxelWorld.start();
+
+    // the chunks' base height sits on the water plane
+    m_voxelModel = glm::translate(glm::mat4(1.f), glm::vec3(0.f, WATER_HEIGHT - params.baseHeight * m_voxelSize, 0.f)) *
+                   glm::scale(glm::mat4(1.f), glm::vec3(m_voxelSize));
+}
+
+void Realtime::clearVoxelMeshes()
+{
+    for (auto &[coord, mesh] : m_voxelMeshes)
+        mesh.destroy();
+    m_voxelMeshes.clear();
+}
+
+// Called once per frame with the GL context current.
+void Realtime::updateVoxelWorld()
+{
+    if (!m_voxelTerrain)
+        return;
+    m_voxelWorld.update(glm::vec3(glm::inverse(m_voxelModel) * glm::vec4(m_cam.eye, 1.f)));
+
+    // drop the meshes of chunks the world forgot
+    for (auto it = m_voxelMeshes.begin(); it != m_voxelMeshes.end();)
+    {
+        if (m_voxelWorld.hasMesh(it->first))
+            ++it;
+        else
+        {
+            it->second.destroy();
+            it = m_voxelMeshes.erase(it);
+        }
+    }
+
+    QElapsedTimer budget;
+    budget.start();
+    VoxelWorld::MeshResult ready;
+    while (budget.nsecsElapsed() < qint64(m_voxelUploadBudgetMs * 1e6f) && m_voxelWorld.poll(ready))
+        m_voxelMeshes[ready.coord].upload(ready.vertices.data(), ready.sectionEnds);
+
+    // edited sections are never deferred, only their bytes go up
+    VoxelWorld::SectionMesh section;
+    while (m_voxelWorld.pollSection(section))
+    {
+        auto it = m_voxelMeshes.find(section.coord);
+        if (it != m_voxelMeshes.end())
+            it->second.updateSection(section.section, section.vertices.data(), section.vertices.size());
+    }
+}
+
+void Realtime::editVoxelWorld(bool dig)
+{
+    // the view ray in voxel units: dig out the cell it hits, build on the face it hits,
+    // and edit at its far end when it hits nothing
+    const glm::mat4 toVoxels = glm::inverse(m_voxelModel);
+    const glm::vec3 origin = glm::vec3(toVoxels * glm::vec4(m_cam.eye, 1.f));
+    const glm::vec3 dir = glm::normalize(glm::vec3(toVoxels * glm::vec4(m_cam.look, 0.f)));
+    const float reach = m_voxelEditReach / m_voxelSize;
+    glm::vec3 centre = origin + dir * reach;
+    VoxelChunk::RayHit hit;
+    if (m_voxelWorld.raycast(origin, dir, reach, hit))
+        centre = glm::vec3(dig ? hit.cell : hit.cell + hit.normal) + 0.5f;
+    // material 1 is dirt (2 is grass)
+    m_voxelWorld.fillSphere(centre, m_voxelEditRadius, dig ? 0 : 1);
+}
+
+void Realtime::drawVoxelWorld(const glm::mat4 &view, const glm::vec3 &sunDir, const glm::vec3 &sunColor,
+                              const glm::vec3 &ambColor)
+{
+    if (!m_progVoxel || m_voxelMeshes.empty())
+        return;
+    glUseProgram(m_progVoxel);
+    glUniformMatrix4fv(glGetUniformLocation(m_progVoxel, "uProj"), 1, GL_FALSE, &m_cam.proj()[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(m_progVoxel, "uView"), 1, GL_FALSE, &view[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(m_progVoxel, "uModel"), 1, GL_FALSE, &m_voxelModel[0][0]);
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uEye"), 1, &m_cam.eye[0]);
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uSunDir"), 1, &sunDir[0]);
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uSunColor"), 1, &sunColor[0]);
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uAmbientColor"), 1, &ambColor[0]);
+    glUniform1i(glGetUniformLocation(m_progVoxel, "uEnableFog"), m_enableFog);
+    glUniform1f(glGetUniformLocation(m_progVoxel, "uFogDensity"), m_fogDensity);
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uFogColor"), 1, &m_fogColor[0]);
+    glm::vec3 palette[3];
+    for (int m = 0; m < 3; m++)
+        palette[m] = VoxelChunk::materialColor(uint8_t(m));
+    glUniform3fv(glGetUniformLocation(m_progVoxel, "uPalette"), 3, &palette[0][0]);
+
+    // vertices are chunk-local
+    const GLint originLoc = glGetUniformLocation(m_progVoxel, "uChunkOrigin");
+    for (const auto &[coord, mesh] : m_voxelMeshes)
+    {
+        const glm::vec3 origin(m_voxelWorld.origin(coord));
+        glUniform3fv(originLoc, 1, &origin[0]);
+        mesh.draw();
+    }
+}
+
 void Realtime::finish()
 {
     killTimer(m_timer);
@@ -1446,6 +2175,11 @@ void Realtime::finish()
         glDeleteProgram(m_progTerrain);
         m_progTerrain = 0;
     }
+    if (m_progTerrainCDLOD)
+    {
+        glDeleteProgram(m_progTerrainCDLOD);
+        m_progTerrainCDLOD = 0;
+    }
     if (m_progWater)
     {
         glDeleteProgram(m_progWater);
@@ -1482,6 +2216,39 @@ void Realtime::finish()
     }
     destroySceneFBO();
     m_screenQuad.destroy();
+    m_terrainMesh.destroy();
+    m_terrainPatches.clear();
+    m_horizon.clear();
+    m_branchGroups.clear();
+    m_leafGroups.clear();
+    m_rockGroups.clear();
+    m_tileStreamer.stop();
+    clearTerrainTiles();
+    m_voxelWorld.stop();
+    clearVoxelMeshes();
+    if (m_progVoxel)
+    {
+        glDeleteProgram(m_progVoxel);
+        m_progVoxel = 0;
+    }
+    m_cdlodGrid.destroy();
+    m_cdlodGridHalf.destroy();
+    m_terrainGrid.destroy();
+    if (m_texTerrainHeightMap)
+    {
+        glDeleteTextures(1, &m_texTerrainHeightMap);
+        m_texTerrainHeightMap = 0;
+    }
+    if (m_texTerrainNormalMap)
+    {
+        glDeleteTextures(1, &m_texTerrainNormalMap);
+        m_texTerrainNormalMap = 0;
+    }
+    if (m_texTerrainHeight)
+    {
+        glDeleteTextures(1, &m_texTerrainHeight);
+        m_texTerrainHeight = 0;
+    }
 
     if (m_texColorLUT) {
         glDeleteTextures(1, &m_texColorLUT);
@@ -1551,6 +2318,19 @@ void Realtime::initializeGL()
         m_progTerrain = 0;
     }
 
+    // CDLOD terrain: own vertex stage, same fragment shading
+    try
+    {
+        m_progTerrainCDLOD = ShaderLoader::createShaderProgram(
+            ":/resources/shaders/terrain_cdlod.vert",
+            ":/resources/shaders/terrain.frag");
+    }
+    catch (const std::exception &e)
+    {
+        qWarning("CDLOD terrain shader compile/link error: %s", e.what());
+        m_progTerrainCDLOD = 0;
+    }
+
     // forest shader
     try
     {
@@ -1564,6 +2344,19 @@ void Realtime::initializeGL()
         m_progTerrain = 0;
     }
 
+    // voxel landscape shader
+    try
+    {
+        m_progVoxel = ShaderLoader::createShaderProgram(
+            ":/resources/shaders/voxel.vert",
+            ":/resources/shaders/voxel.frag");
+    }
+    catch (const std::exception &e)
+    {
+        qWarning("Voxel shader compile/link error: %s", e.what());
+        m_progVoxel = 0;
+    }
+
     // water shader
     try
     {
@@ -1618,8 +2411,6 @@ void Realtime::initializeGL()
 
     if (m_progTerrain)
     {
-        std::vector<float> interlPNC = m_terrainGen.generateTerrain();
-        m_terrainMesh.uploadinterleavedPNC(interlPNC);
         m_hasTerrain = true;
 
         // loading terrain textures
@@ -1665,7 +2456,7 @@ void Realtime::initializeGL()
     // rock mesh
     m_rockMesh = getOrCreateMesh(PrimitiveType::PRIMITIVE_SPHERE, 4, 8);
 
-    m_drawForest = false; // off by default, controlled by EC4 checkbox.
+    m_drawForest = settings.extraCredit4; // off by default, controlled by EC4 checkbox.
 
     // instancing attribute for branches
     glBindVertexArray(m_treeCylinderMesh->vao);
@@ -1715,6 +2506,10 @@ void Realtime::initializeGL()
     }
     glBindVertexArray(0);
 
+    // after m_terrainModel and the instance buffers: a bake may hold the forest too
+    if (m_progTerrain)
+        buildInitialTerrain();
+
     // Camera initial values (will be overridden by scene & settings)
     m_cam.aspect = (height() > 0) ? float(width()) / float(height()) : 1.f;
     m_cam.nearP = settings.nearPlane;
@@ -1832,6 +2627,11 @@ void Realtime::paintGL() {
         return;
     }
 
+    updateTerrainTiles();
+    updateVoxelWorld();
+    updateCDLOD();
+    updateHorizon();
+
     GLint prevFBO = 0;
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
 
@@ -2014,23 +2814,9 @@ void Realtime::sceneChanged()
     update(); // asks for a PaintGL() call to occur
 }
 
-void Realtime::settingsChanged()
+// map UI -> Terrain Parameters
+TerrainGenerator::TerrainParams Realtime::terrainParamsFromSettings() const
 {
-
-    if (!m_glInitialized)
-    {
-        m_cam.nearP = std::max(EPS, settings.nearPlane);
-        m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
-        return;
-    }
-
-    makeCurrent();
-
-    // Update camera near/far immediately
-    m_cam.nearP = std::max(EPS, settings.nearPlane);
-    m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
-
-    // map UI -> Terrain Parameters
     TerrainGenerator::TerrainParams P;
 
     // P1: mountain roughness / frequency
@@ -2079,29 +2865,139 @@ void Realtime::settingsChanged()
     P.seaLevel = -0.1f;
     P.oceanBias = 0.0f; // Aborted
 
-    m_terrainParams = P;
-    m_terrainGen.setParams(m_terrainParams);
+    // E: hydraulic erosion, about one droplet per grid cell
+    P.erosionDensity = m_erodeTerrain ? 1.0f : 0.0f;
 
-    // calc. sea height / height under world scale for texture coloring
-    m_seaHeightWorld = m_terrainParams.seaLevel * m_terrainParams.heightScale * 10.f;
-    m_heightScaleWorld = m_terrainParams.heightScale * 10.f;
+    return P;
+}
 
-    std::vector<float> interlPNC = m_terrainGen.generateTerrain();
-    m_terrainMesh.uploadinterleavedPNC(interlPNC);
+// World bake key of the current settings: the terrain params, the mesh options and,
+// with the forest on, its sliders.
+uint64_t Realtime::worldBakeKey(const TerrainGenerator::TerrainParams &P)
+{
+    return WorldBake::key(P, m_terrainGen.getResolution(),
+                          {int(m_adaptiveTerrain),
+                           m_adaptiveTerrain ? m_terrainTriangleBudget : 0,
+                           m_adaptiveTerrain ? int(m_terrainMaxError * 1e6f) : 0,
+                           int(m_drawForest),
+                           m_drawForest ? settings.shapeParameter4 : 0,
+                           m_drawForest ? settings.shapeParameter5 : 0,
+                           m_drawForest ? settings.shapeParameter6 : 0,
+                           m_drawForest ? settings.shapeParameter7 : 0});
+}
 
-    rebuildWaterMesh();
+void Realtime::settingsChanged()
+{
+
+    if (!m_glInitialized)
+    {
+        m_cam.nearP = std::max(EPS, settings.nearPlane);
+        m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
+        return;
+    }
+
+    makeCurrent();
+
+    // Update camera near/far immediately
+    m_cam.nearP = std::max(EPS, settings.nearPlane);
+    m_cam.farP = std::max(m_cam.nearP + EPS, settings.farPlane);
+
+    const TerrainGenerator::TerrainParams P = terrainParamsFromSettings();
+
+    // UI changes that leave the terrain params alone (near/far, forest sliders, ...)
+    // skip the terrain, water and tile rebuilds entirely
+    const uint64_t terrainKey = TerrainGenerator::paramsKey(P);
+    const bool terrainChanged = terrainKey != m_terrainKey;
+    m_terrainKey = terrainKey;
 
     m_drawForest = settings.extraCredit4;
+    const glm::ivec3 forestSettings(settings.shapeParameter4, settings.shapeParameter5,
+                                    settings.shapeParameter6);
+    const int rockSettings = settings.shapeParameter7;
+
+    // World bake: whenever an input of its key changes (terrain params, EC4, forest
+    // and rock sliders), a bake of these exact settings replaces generation with
+    // uploads from the mapped file; with the terrain unchanged only its forest and
+    // rocks are taken. Streaming and GPU displacement build their own data, so they skip it.
+    const uint64_t bakeKey = worldBakeKey(P);
+    const bool worldChanged = bakeKey != m_worldBakeKey;
+    m_worldBakeKey = bakeKey;
+    const bool bakeable = worldChanged && !m_gpuDisplace && !m_streamTerrain;
+    WorldBake bake;
+    const bool fromBake = bakeable && bake.open(WorldBake::pathFor(bakeKey), bakeKey);
+    TerrainGenerator::TerrainMesh generated;
+
+    if (terrainChanged)
+    {
+        m_terrainParams = P;
+        m_terrainGen.setParams(m_terrainParams);
+
+        // calc. sea height / height under world scale for texture coloring
+        m_seaHeightWorld = m_terrainParams.seaLevel * m_terrainParams.heightScale * 10.f;
+        m_heightScaleWorld = m_terrainParams.heightScale * 10.f;
+
+        if (fromBake)
+            uploadBakedTerrain(bake.contents());
+        else
+            uploadTerrain(&generated);
+
+        m_cdlodDirty = true;
+
+        // streamed tiles were built from the old params
+        if (m_streamTerrain)
+        {
+            m_tileStreamer.configure(m_terrainParams, m_tileResolution);
+            clearTerrainTiles();
+        }
+
+        rebuildWaterMesh();
+    }
+
+    // trees and rocks are sampled on the terrain: rebuild them with it, or when their sliders move
     if (m_drawForest)
     {
-        buildForest();
-        buildRocks();
+        if (fromBake)
+        {
+            uploadBakedForest(bake.contents());
+            m_forestSettings = forestSettings;
+            m_rockSettings = rockSettings;
+        }
+        if (!fromBake && (terrainChanged || !m_forestBuilt || forestSettings != m_forestSettings))
+        {
+            buildForest();
+            m_forestSettings = forestSettings;
+        }
+        if (!fromBake && (terrainChanged || !m_forestBuilt || rockSettings != m_rockSettings))
+        {
+            buildRocks();
+            m_rockSettings = rockSettings;
+        }
+        m_forestBuilt = true;
     }
     else
     {
         m_forestBranches.clear();
         m_rocks.clear();
         m_rockInstanceCount = 0;
+        m_forestBuilt = false;
+    }
+
+    // a terrain still being eroded is baked when advanceErosion finishes it; settings
+    // outside the key (near/far, ...) keep that pending bake
+    if (worldChanged)
+        m_erosionBakeKey = 0;
+    if (bakeable && !fromBake)
+    {
+        if (m_terrainGen.erosionPending())
+            m_erosionBakeKey = bakeKey;
+        else
+        {
+            // an unchanged terrain was not regenerated above: rebuild the uploaded
+            // mesh (from the cached heightfield, unless it came from a bake)
+            if (!terrainChanged)
+                generated = buildTerrainMesh();
+            writeWorldBake(bakeKey, generated);
+        }
     }
 
     doneCurrent();
@@ -2128,6 +3024,84 @@ void Realtime::keyPressEvent(QKeyEvent *event)
         update();
     }
 
+    // Endless terrain toggle
+    if (event->key() == Qt::Key_I) {
+        m_streamTerrain = !m_streamTerrain;
+        if (m_streamTerrain) {
+            m_tileStreamer.configure(m_terrainParams, m_tileResolution);
+            m_tileStreamer.start();
+        } else {
+            m_tileStreamer.stop();
+            makeCurrent();
+            clearTerrainTiles();
+            doneCurrent();
+        }
+        update();
+    }
+
+    // Voxel landscape toggle
+    if (event->key() == Qt::Key_V) {
+        m_voxelTerrain = !m_voxelTerrain;
+        if (m_voxelTerrain) {
+            startVoxelWorld();
+        } else {
+            m_voxelWorld.stop();
+            makeCurrent();
+            clearVoxelMeshes();
+            doneCurrent();
+        }
+        update();
+    }
+
+    // Voxel dig / build
+    if ((event->key() == Qt::Key_X || event->key() == Qt::Key_C) && m_voxelTerrain) {
+        editVoxelWorld(event->key() == Qt::Key_X);
+        update();
+    }
+
+    // GPU displacement terrain toggle
+    if (event->key() == Qt::Key_G) {
+        m_gpuDisplace = !m_gpuDisplace;
+        m_erosionBakeKey = 0; // its key was for the other mode
+        if (m_hasTerrain) {
+            makeCurrent();
+            uploadTerrain();
+            doneCurrent();
+        }
+        update();
+    }
+
+    // Adaptive terrain triangulation toggle (single-tile mesh mode)
+    if (event->key() == Qt::Key_M) {
+        m_adaptiveTerrain = !m_adaptiveTerrain;
+        m_erosionBakeKey = 0; // its key was for the other mesh
+        if (m_hasTerrain && !m_gpuDisplace) {
+            makeCurrent();
+            uploadTerrain();
+            doneCurrent();
+        }
+        update();
+    }
+
+    // Hydraulic erosion toggle
+    if (event->key() == Qt::Key_E) {
+        m_erodeTerrain = !m_erodeTerrain;
+        if (m_hasTerrain)
+            settingsChanged();
+    }
+
+    // Horizon culling of trees and rocks toggle
+    if (event->key() == Qt::Key_H) {
+        m_horizonCulling = !m_horizonCulling;
+        update();
+    }
+
+    // CDLOD terrain toggle
+    if (event->key() == Qt::Key_O) {
+        m_useCDLOD = !m_useCDLOD;
+        update();
+    }
+
     // Color LUT toggle
     if (event->key() == Qt::Key_L) {
         m_enableColorLUT = !m_enableColorLUT;
@@ -2207,6 +3181,12 @@ void Realtime::timerEvent(QTimerEvent *event)
 
     m_time += dt; // water animation time var.
 
+    // one erosion job per frame: the mesh terrain first, then CDLOD's while it is drawn
+    if (m_terrainGen.erosionPending())
+        advanceErosion();
+    else if (m_useCDLOD && !m_streamTerrain && m_cdlodGen.erosionPending())
+        advanceCDLODErosion();
+
     if (m_isPathAnimating)
     {
         float t = m_pathTimer.elapsed() / 1000.0f;
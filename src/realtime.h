@@ -19,13 +19,30 @@
 #include "utils/shaderloader.h" // shader program builder
 #include "camera.h"             // Camera class (view/proj, yaw/pitch/move)
 
-// #include "terrain/voxel_chunk.h"
+#include "terrain/voxel_world.h"
 #include "terrain/terraingenerator.h"
+#include "terrain/terrain_tiles.h"
+#include "terrain/cdlod.h"
+#include "terrain/heightfield_query.h"
+#include "terrain/terrain_patches.h"
+#include "terrain/horizon_culling.h"
+#include "utils/world_bake.h"
 #include "vegetation/lsystem_tree.h"
 #include "particles/particlesystem.h"
 #include "utils/camera_path.h"
 #include "lut_utils.h"
 
+struct Frustum;
+
+// A run of consecutive instances of an instance VBO, culled as one box.
+// Bounds are in terrain-local space, like TerrainPatch.
+struct InstanceGroup
+{
+    glm::vec3 min, max;
+    uint32_t first;
+    uint32_t count;
+};
+
 class Realtime : public QOpenGLWidget
 {
 public:
@@ -129,15 +146,82 @@ private:
     std::vector<DrawItem> m_drawList;                             // per-instance draw commands
 
     // terrain
-    // reserved for infinite generation (if needed)
+    // endless terrain (toggle with I): tiles streamed in around the camera
     // data for a single tile: its own mesh + model matrix
     struct TerrainTile
     {
-        GLMesh mesh;
+        GLIndexedMesh mesh;
         glm::mat4 model = glm::mat4(1.f);
+        uint64_t lastUsedFrame = 0; // LRU stamp, refreshed while inside the view radius
     };
-
-    GLMesh m_terrainMesh;
+    using TileCoord = TerrainTileStreamer::TileCoord;
+
+    bool m_streamTerrain = false;
+    TerrainTileStreamer m_tileStreamer; // background generation
+    std::unordered_map<TileCoord, TerrainTile, TerrainTileStreamer::TileCoordHash> m_tiles; // GPU-resident
+    size_t m_tileBytes = 0;
+    uint64_t m_frameIndex = 0;
+    int m_tileRadius = 3;                          // tiles kept around the camera tile
+    int m_tileResolution = 128;                    // quads per tile side
+    float m_tileUploadBudgetMs = 2.0f;             // max upload time per frame
+    size_t m_tileCacheBytes = size_t(96) << 20;    // LRU cap on resident tile buffers
+
+    // voxel landscape (toggle with V): drawn instead of the terrain, its chunks
+    // generated and meshed in the background around the camera; X digs, C builds
+    using VoxelCoord = VoxelWorld::ChunkCoord;
+    bool m_voxelTerrain = false;
+    VoxelWorld m_voxelWorld;
+    std::unordered_map<VoxelCoord, GLSectionedMesh, VoxelWorld::ChunkCoordHash> m_voxelMeshes; // GPU-resident
+    glm::mat4 m_voxelModel = glm::mat4(1.f);   // voxel units -> world
+    float m_voxelSize = 0.25f;                 // world units per voxel
+    int m_voxelRadius = 8;                     // chunks meshed around the camera chunk
+    float m_voxelEditReach = 8.0f;             // world units the edit ray reaches from the eye
+    float m_voxelEditRadius = 3.0f;            // voxels
+    float m_voxelUploadBudgetMs = 2.0f;        // max upload time per frame
+    GLuint m_progVoxel = 0;
+
+    // GPU displacement terrain (toggle with G): a static flat grid displaced in terrain.vert
+    bool m_gpuDisplace = false;
+    GLIndexedMesh m_terrainGrid;          // flat (resolution + 1)^2 grid, built once per resolution
+    GLuint m_texTerrainHeightMap = 0;     // R32F heights, texel (s, t) = (col, row)
+    GLuint m_texTerrainNormalMap = 0;     // RG16_SNORM octahedral normals
+    int m_terrainMapSize = 0;             // texels per side of both maps
+
+    // CDLOD terrain (toggle with O): quadtree patches of one shared grid over a height texture
+    bool m_useCDLOD = false;
+    bool m_cdlodDirty = true;             // params changed since the height texture was built
+    GLuint m_progTerrainCDLOD = 0;        // terrain_cdlod.vert + terrain.frag
+    GLuint m_texTerrainHeight = 0;        // R32F heightfield, apron included
+    int m_cdlodResolution = 1024;         // heightfield quads per side: gridDim * 2^k (up to 4096)
+    int m_cdlodGridDim = 32;              // quads per side of the shared patch grid
+    float m_cdlodBaseRange = 16.f;        // world units covered by the finest level
+    CDLODQuadtree m_cdlodTree;
+    TerrainGenerator m_cdlodGen;          // m_cdlodResolution heightfield, stage caches kept
+    GLPatchGrid m_cdlodGrid;              // whole nodes
+    GLPatchGrid m_cdlodGridHalf;          // quadrants of partly refined nodes
+    std::vector<CDLODQuadtree::Patch> m_cdlodFull, m_cdlodQuarters;
+    glm::vec3 m_cdlodEye = glm::vec3(0.f); // world eye of that selection, the morph eye of every pass
+
+    // Adaptive terrain triangulation (toggle with M): generateTerrainAdaptive instead of the full grid
+    bool m_adaptiveTerrain = false;
+    int m_terrainTriangleBudget = 32768;  // triangles for the whole tile (full grid at 256: 131072)
+    float m_terrainMaxError = 0.002f;     // local z units (x10 in world), refinement stops below it
+
+    // Hydraulic erosion (toggle with E): m_terrainGen erodes incrementally, one slice per frame,
+    // then m_cdlodGen while CDLOD draws
+    bool m_erodeTerrain = false;
+    int m_erosionDropletsPerFrame = 4096;
+    double m_erosionBudgetMs = 4.0;       // per frame
+    QElapsedTimer m_erosionUploadTimer;   // paces re-uploads of the partly eroded terrain
+    QElapsedTimer m_cdlodErosionTimer;    // same for the CDLOD height texture
+    uint64_t m_erosionBakeKey = 0;        // world bake to write once erosion finishes, 0 = none
+    uint64_t m_worldBakeKey = 0;          // worldBakeKey of the terrain, forest and rocks shown now
+
+    GLIndexedMesh m_terrainMesh; // shared-vertex packed terrain (generateTerrainIndexed)
+    std::vector<TerrainPatch> m_terrainPatches; // index ranges of m_terrainMesh, frustum-culled per pass
+    int m_terrainPatchesPerSide = 8;
+    std::vector<GLsizei> m_patchCounts;         // scratch: visible ranges of the current pass
+    std::vector<GLuint> m_patchFirsts;
     GLuint m_progTerrain = 0;
     bool m_hasTerrain = false;
     bool m_terrainWire = false;
@@ -148,6 +232,8 @@ private:
     float m_heightScaleWorld = 1.f; // The current terrain's heightScale (world height)
 
     TerrainGenerator::TerrainParams m_terrainParams; // save the most recent setParams value
+    uint64_t m_terrainKey = 0;                       // paramsKey of m_terrainParams, 0 = not built yet
+    HeightfieldQuery m_heightQuery;                  // grid of the uploaded terrain, for placement
 
     // terrain textures
     GLuint m_texGrassAlbedo = 0;
@@ -217,6 +303,10 @@ private:
     GLMesh *m_leafMesh = nullptr;
     GLMesh *m_rockMesh = nullptr;
     bool m_drawForest = false;
+    // settings the current trees/rocks were built from
+    bool m_forestBuilt = false;
+    glm::ivec3 m_forestSettings = glm::ivec3(0); // shapeParameter4..6
+    int m_rockSettings = 0;                      // shapeParameter7
     std::vector<BranchInstance> m_forestBranches; // all branch instances (including all trees)
     std::vector<glm::mat4> m_forestLeaves;
     std::vector<glm::mat4> m_rocks;
@@ -231,6 +321,18 @@ private:
     GLsizei m_leafInstanceCount = 0;
     GLsizei m_rockInstanceCount = 0;
 
+    // Culling of trees and rocks: instances are sorted into m_instanceCellsPerSide^2
+    // cells of the tile, and every pass draws only the groups inside its frustum and,
+    // with horizon culling on (toggle with H), not hidden behind the terrain.
+    std::vector<InstanceGroup> m_branchGroups;
+    std::vector<InstanceGroup> m_leafGroups;
+    std::vector<InstanceGroup> m_rockGroups;
+    int m_instanceCellsPerSide = 16;
+    bool m_horizonCulling = true;
+    HorizonCuller m_horizon;              // over m_terrainMesh; empty in the other terrain modes
+    std::vector<GLsizei> m_instanceCounts; // scratch: visible ranges of the current draw
+    std::vector<GLuint> m_instanceFirsts;
+
     // --- Post-processing / FBO ---
     GLuint m_fboScene = 0;
     GLuint m_texSceneColor = 0;
@@ -267,12 +369,58 @@ private:
 
     void buildForest(); // Generate/Rebuild Forest
     void buildRocks();  // Generate/Rebuild Rocks
+    void uploadForestInstances(std::span<const glm::mat4> branchModels,
+                               std::span<const glm::mat4> leaves);
+    void uploadRockInstances(std::span<const glm::mat4> rocks);
+    glm::vec3 surfaceLocal(glm::vec2 uv) const;      // sea-clamped surface point, local space
+    glm::vec2 surfaceSlopeWorld(glm::vec2 uv) const; // d(world y)/d(u, v)
 
     GLuint loadTexture2D(const QString &path, bool srgb = false);
     GLuint loadCubemap(const std::vector<QString> &faces); // 加载 Cubemap 的辅助函数
 
     void rebuildWaterMesh();
 
+    // world bake (see utils/world_bake.h)
+    void uploadBakedTerrain(const WorldBake::Contents &c);
+    void uploadBakedForest(const WorldBake::Contents &c);
+    void writeWorldBake(uint64_t key, const TerrainGenerator::TerrainMesh &terrain);
+    void buildInitialTerrain(); // initializeGL's terrain, forest and rocks, from a bake when there is one
+    TerrainGenerator::TerrainParams terrainParamsFromSettings() const; // UI -> terrain params
+    uint64_t worldBakeKey(const TerrainGenerator::TerrainParams &P);
+
+    // GPU displacement terrain
+    void uploadTerrain(TerrainGenerator::TerrainMesh *generated = nullptr); // mesh or height/normal maps, depending on m_gpuDisplace
+    TerrainGenerator::TerrainMesh buildTerrainMesh(); // uploadTerrain's mesh (m_gpuDisplace off), patch-sorted
+    void drawDisplacedTerrain();
+    void advanceErosion(); // one frame of incremental erosion, re-uploads the terrain now and then
+    void advanceCDLODErosion(); // the same for m_cdlodGen, rebuilds CDLOD now and then
+    void bindWaterHeightMap(int unit);
+
+    // CDLOD terrain
+    GLuint activeTerrainProgram() const; // CDLOD or classic terrain program
+    void rebuildCDLOD();
+    void updateCDLOD();
+    void drawCDLOD();
+
+    // endless terrain
+    void updateTerrainTiles(); // request/upload/evict tiles around the camera
+    void clearTerrainTiles();
+    // draws the terrain (or water quad) once, or once per resident tile when streaming
+    void drawTerrainTiles(GLuint prog, const char *modelUniform, bool water, const glm::mat4 &view);
+    void drawTerrainPatches(const glm::mat4 &view); // visible patches of m_terrainMesh
+    bool horizonCullingActive() const;
+    void updateHorizon();
+    void drawInstanceGroups(const GLMesh &mesh, GLuint instanceVbo, const std::vector<InstanceGroup> &groups,
+                            const Frustum &frustum, bool horizon);
+
+    // voxel landscape
+    void startVoxelWorld();
+    void updateVoxelWorld(); // schedule chunks around the camera, upload/drop their meshes
+    void clearVoxelMeshes();
+    void editVoxelWorld(bool dig); // a sphere where the view ray hits the voxels
+    void drawVoxelWorld(const glm::mat4 &view, const glm::vec3 &sunDir, const glm::vec3 &sunColor,
+                        const glm::vec3 &ambColor);
+
     void ensureSceneFBO(int w, int h); // create/resize scene FBO （color+depth texture）
     void destroySceneFBO();
 
@@ -280,7 +428,7 @@ private:
     void renderScene();
 
     glm::mat4 createMirroredViewMatrix(float waterHeight);
-    void renderSceneObject(const glm::mat4 &viewMatrix);
+    void renderSceneObject(const glm::mat4 &viewMatrix, bool horizonCull);
     void renderReflection();
     void renderRefraction();
     void renderWater();
@@ -0,0 +1,134 @@
+#include "cdlod.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <limits>
+
+void CDLODQuadtree::build(const TerrainGenerator::Heightfield &hf, int gridDim)
+{
+    m_gridDim = gridDim;
+    m_levels.clear();
+
+    const int res = hf.resolution;
+    int leaves = std::max(1, res / gridDim);
+
+    // leaves: min/max over the (gridDim + 1)^2 samples each patch touches
+    Level leaf;
+    leaf.nodes = leaves;
+    leaf.minMax.resize(size_t(leaves) * leaves);
+    for (int ny = 0; ny < leaves; ny++) {
+        for (int nx = 0; nx < leaves; nx++) {
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (int row = nx * gridDim; row <= (nx + 1) * gridDim; row++) {
+                for (int col = ny * gridDim; col <= (ny + 1) * gridDim; col++) {
+                    float h = hf.at(row, col);
+                    lo = std::min(lo, h);
+                    hi = std::max(hi, h);
+                }
+            }
+            leaf.minMax[size_t(ny) * leaves + nx] = glm::vec2(lo, hi);
+        }
+    }
+    m_levels.push_back(std::move(leaf));
+
+    // parents: union of their four children, up to a single root
+    while (m_levels.back().nodes > 1) {
+        const Level &child = m_levels.back();
+        Level parent;
+        parent.nodes = child.nodes / 2;
+        parent.minMax.resize(size_t(parent.nodes) * parent.nodes);
+        for (int ny = 0; ny < parent.nodes; ny++) {
+            for (int nx = 0; nx < parent.nodes; nx++) {
+                glm::vec2 mm(FLT_MAX, -FLT_MAX);
+                for (int c = 0; c < 4; c++) {
+                    glm::vec2 cm = child.minMax[size_t(2 * ny + c / 2) * child.nodes + (2 * nx + c % 2)];
+                    mm.x = std::min(mm.x, cm.x);
+                    mm.y = std::max(mm.y, cm.y);
+                }
+                parent.minMax[size_t(ny) * parent.nodes + nx] = mm;
+            }
+        }
+        m_levels.push_back(std::move(parent));
+    }
+
+    updateRanges();
+}
+
+void CDLODQuadtree::setRanges(float baseRange, float morphStart)
+{
+    m_baseRange = baseRange;
+    m_morphStart = morphStart;
+    updateRanges();
+}
+
+void CDLODQuadtree::updateRanges()
+{
+    const int n = levels();
+    m_range.assign(n, 0.f);
+    m_morph.assign(n, glm::vec2(0.f));
+
+    float prev = 0.f;
+    for (int l = 0; l < n; l++) {
+        float r = m_baseRange * float(1 << l);
+        if (l == n - 1) r = std::numeric_limits<float>::max(); // the root never drops out
+        m_range[l] = r;
+
+        // the top level has nothing coarser to morph into
+        if (l == n - 1) {
+            m_morph[l] = glm::vec2(FLT_MAX * 0.5f, FLT_MAX);
+        } else {
+            m_morph[l] = glm::vec2(prev + (r - prev) * m_morphStart, r);
+        }
+        prev = r;
+    }
+}
+
+float CDLODQuadtree::nodeDistance(int level, int nx, int ny,
+                                  const glm::vec3 &eyeLocal, const glm::vec3 &metric) const
+{
+    const Level &L = m_levels[level];
+    const float size = 1.f / float(L.nodes);
+    glm::vec2 mm = L.minMax[size_t(ny) * L.nodes + nx];
+
+    glm::vec3 lo(nx * size, ny * size, mm.x);
+    glm::vec3 hi((nx + 1) * size, (ny + 1) * size, mm.y);
+    glm::vec3 d = (glm::max(lo - eyeLocal, glm::vec3(0.f)) +
+                   glm::max(eyeLocal - hi, glm::vec3(0.f))) * metric;
+    return glm::length(d);
+}
+
+// Returns false when the node lies beyond this level's range (the caller then
+// covers that area at its own, coarser level).
+bool CDLODQuadtree::selectNode(int level, int nx, int ny,
+                               const glm::vec3 &eyeLocal, const glm::vec3 &metric,
+                               std::vector<Patch> &full, std::vector<Patch> &quarters) const
+{
+    const float dist = nodeDistance(level, nx, ny, eyeLocal, metric);
+    if (dist > m_range[level]) return false;
+
+    const float size = 1.f / float(m_levels[level].nodes);
+    if (level == 0 || dist > m_range[level - 1]) {
+        full.push_back({nx * size, ny * size, size, float(level)});
+        return true;
+    }
+
+    // partly within the finer range: recurse, filling the rest at this level
+    const float half = size * 0.5f;
+    for (int c = 0; c < 4; c++) {
+        int cx = 2 * nx + c % 2;
+        int cy = 2 * ny + c / 2;
+        if (!selectNode(level - 1, cx, cy, eyeLocal, metric, full, quarters)) {
+            quarters.push_back({cx * half, cy * half, half, float(level)});
+        }
+    }
+    return true;
+}
+
+void CDLODQuadtree::select(const glm::vec3 &eyeLocal, const glm::vec3 &metric,
+                           std::vector<Patch> &full, std::vector<Patch> &quarters) const
+{
+    full.clear();
+    quarters.clear();
+    if (m_levels.empty()) return;
+    selectNode(levels() - 1, 0, 0, eyeLocal, metric, full, quarters);
+}
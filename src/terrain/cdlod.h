@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "terraingenerator.h"
+
+// Continuous distance-dependent LOD (CDLOD) patch selection over one heightfield.
+//
+// Every patch is drawn with the same gridDim x gridDim grid mesh; a level-l patch
+// covers 2^l leaf patches, so each level halves the vertex density. The quadtree
+// stores min/max heights per node for distance tests. The vertex shader morphs
+// the grid of a level-l patch onto the level-(l+1) grid as the camera distance
+// approaches the end of that level's range, so neighbouring levels meet without
+// cracks and switch without popping.
+//
+// Everything here is in the tile's local (0..1)^2, z-up space. Distances are
+// measured after scaling by `metric` (the model matrix scale), i.e. in world units.
+class CDLODQuadtree
+{
+public:
+    // one instance of the shared grid mesh (matches the per-instance vec4 attribute)
+    struct Patch {
+        float x, y;  // local-space min corner
+        float size;  // local-space side length
+        float level; // LOD level (0 = finest)
+    };
+
+    // heightfield resolution must be gridDim * 2^k (gridDim even); levels = k + 1
+    void build(const TerrainGenerator::Heightfield &hf, int gridDim);
+
+    // Ranges: level l stays selected up to baseRange * 2^l world units; the top
+    // level covers everything. morphStart is the fraction of each band after which
+    // the morph to the next level begins. Keep baseRange above ~1.5x the world-space
+    // diagonal of a leaf patch, or neighbouring patches may differ by two levels.
+    void setRanges(float baseRange, float morphStart = 0.66f);
+
+    // Patches to draw for a camera at eyeLocal (both lists are cleared first).
+    // `full` are whole nodes drawn with the gridDim mesh; `quarters` are the
+    // quadrants of partly refined nodes, drawn with a gridDim / 2 mesh so they keep
+    // their own level's vertex density.
+    void select(const glm::vec3 &eyeLocal, const glm::vec3 &metric,
+                std::vector<Patch> &full, std::vector<Patch> &quarters) const;
+
+    int levels() const { return int(m_levels.size()); }
+    int gridDim() const { return m_gridDim; }
+    // (start, end) of the morph band of level l, in world units
+    glm::vec2 morphRange(int level) const { return m_morph[level]; }
+
+private:
+    struct Level {
+        int nodes = 0;                 // nodes per side
+        std::vector<glm::vec2> minMax; // per node: (min height, max height)
+    };
+
+    bool selectNode(int level, int nx, int ny,
+                    const glm::vec3 &eyeLocal, const glm::vec3 &metric,
+                    std::vector<Patch> &full, std::vector<Patch> &quarters) const;
+    float nodeDistance(int level, int nx, int ny,
+                       const glm::vec3 &eyeLocal, const glm::vec3 &metric) const;
+
+    void updateRanges();
+
+    int m_gridDim = 32;
+    float m_baseRange = 16.f;
+    float m_morphStart = 0.66f;
+    std::vector<Level> m_levels;    // [0] = leaves
+    std::vector<float> m_range;     // per level, world units
+    std::vector<glm::vec2> m_morph; // per level, world units
+};
@@ -0,0 +1,214 @@
+#include "erosion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+#include "utils/parallel.h"
+
+// integer hash (lowbias32); droplet seeds and start positions
+static inline uint32_t mix32(uint32_t x)
+{
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+void HydraulicErosion::reset(std::vector<float> heights, int resolution, const Params &params, uint64_t key)
+{
+    m_heights = std::move(heights);
+    m_resolution = resolution;
+    m_stride = resolution + 3;
+    m_params = params;
+    m_params.radius = std::clamp(params.radius, 1, 8);
+    m_key = key;
+
+    // brush: linear falloff over the disc, weights sum to one
+    m_brush.clear();
+    const int r = m_params.radius;
+    float sum = 0.f;
+    for (int dx = -r; dx <= r; dx++) {
+        for (int dy = -r; dy <= r; dy++) {
+            float w = float(r) - std::sqrt(float(dx * dx + dy * dy));
+            if (w <= 0.f) continue;
+            m_brush.push_back({dx, dy, w});
+            sum += w;
+        }
+    }
+    for (BrushTap &t : m_brush) t.weight /= sum;
+
+    // tiles, grouped by colour; empty colours are dropped from the schedule
+    m_tiles.clear();
+    const int tilesPerSide = std::max(1, (resolution + kTileSize - 1) / kTileSize);
+    std::vector<int> colours[4];
+    for (int tx = 0; tx < tilesPerSide; tx++) {
+        for (int ty = 0; ty < tilesPerSide; ty++) {
+            Tile t;
+            t.x0 = tx * kTileSize; t.x1 = std::min(resolution, t.x0 + kTileSize);
+            t.y0 = ty * kTileSize; t.y1 = std::min(resolution, t.y0 + kTileSize);
+            t.index = uint32_t(m_tiles.size());
+            float perRound = m_params.density * float((t.x1 - t.x0) * (t.y1 - t.y0)) / kRounds;
+            t.droplets = uint32_t(std::max(0.f, std::round(perRound)));
+            colours[(tx & 1) | ((ty & 1) << 1)].push_back(int(t.index));
+            m_tiles.push_back(t);
+        }
+    }
+
+    m_batches.clear();
+    m_total = 0;
+    for (int round = 0; round < kRounds; round++) {
+        for (const std::vector<int> &c : colours) {
+            if (c.empty()) continue;
+            m_batches.push_back(c);
+            for (int i : c) m_total += m_tiles[i].droplets;
+        }
+    }
+    m_batch = m_tile = 0;
+    m_droplet = 0;
+    m_finished = 0;
+}
+
+void HydraulicErosion::run(int workers)
+{
+    while (!done()) {
+        const std::vector<int> &batch = m_batches[m_batch];
+        const int round = int(m_batch * kRounds / m_batches.size());
+
+        // tiles before m_tile are finished (step() may have stopped mid-batch)
+        const int firstTile = int(m_tile);
+        const uint32_t firstDroplet = m_droplet;
+        for (int i = firstTile; i < int(batch.size()); i++) {
+            m_finished += m_tiles[batch[i]].droplets - (i == firstTile ? firstDroplet : 0);
+        }
+
+        ParallelUtils::forBands(firstTile, int(batch.size()), workers, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const Tile &tile = m_tiles[batch[i]];
+                runDroplets(tile, round, i == firstTile ? firstDroplet : 0, tile.droplets);
+            }
+        });
+
+        m_batch++;
+        m_tile = 0;
+        m_droplet = 0;
+    }
+}
+
+int HydraulicErosion::step(int maxDroplets, double budgetMs)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    int ran = 0;
+    while (!done() && ran < maxDroplets) {
+        const std::vector<int> &batch = m_batches[m_batch];
+        const Tile &tile = m_tiles[batch[m_tile]];
+        const int round = int(m_batch * kRounds / m_batches.size());
+
+        // small slices so the clock is read often enough to hold the budget
+        const uint32_t end = std::min(tile.droplets, m_droplet + uint32_t(std::min(maxDroplets - ran, 64)));
+        runDroplets(tile, round, m_droplet, end);
+        ran += int(end - m_droplet);
+        m_finished += end - m_droplet;
+        m_droplet = end;
+
+        if (m_droplet >= tile.droplets) {
+            m_droplet = 0;
+            if (++m_tile >= batch.size()) {
+                m_tile = 0;
+                m_batch++;
+            }
+        }
+        if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= budgetMs) break;
+    }
+    return ran;
+}
+
+void HydraulicErosion::runDroplets(const Tile &tile, int round, uint32_t first, uint32_t end)
+{
+    const uint32_t base = mix32(mix32(mix32(m_params.seed) ^ uint32_t(round)) ^ tile.index);
+    for (uint32_t i = first; i < end; i++) droplet(tile, mix32(base ^ i));
+}
+
+void HydraulicErosion::droplet(const Tile &tile, uint32_t seed)
+{
+    const Params &P = m_params;
+    const int res = m_resolution;
+    const float gravity = 4.f;
+    const float minCapacity = 1e-4f;
+
+    // droplets stay inside the tile plus this halo; with the brush and the
+    // bilinear taps on top, a tile touches at most kTileSize / 2 - 1 cells past
+    // its edge, so same-coloured tiles stay disjoint
+    const int halo = kTileSize / 2 - P.radius - 2;
+    const float bx0 = float(std::max(0, tile.x0 - halo)), bx1 = float(std::min(res, tile.x1 + halo));
+    const float by0 = float(std::max(0, tile.y0 - halo)), by1 = float(std::min(res, tile.y1 + halo));
+
+    auto rnd = [&seed] {
+        seed = mix32(seed);
+        return float(seed >> 8) * (1.f / 16777216.f);
+    };
+    float px = float(tile.x0) + rnd() * float(tile.x1 - tile.x0);
+    float py = float(tile.y0) + rnd() * float(tile.y1 - tile.y0);
+
+    // bilinear height (and its gradient) of the cell containing (x, y)
+    auto sample = [&](float x, float y, float *gx, float *gy) {
+        const int ix = int(x), iy = int(y);
+        const float fx = x - float(ix), fy = y - float(iy);
+        const float h00 = at(ix, iy), h10 = at(ix + 1, iy);
+        const float h01 = at(ix, iy + 1), h11 = at(ix + 1, iy + 1);
+        if (gx) {
+            *gx = (h10 - h00) * (1.f - fy) + (h11 - h01) * fy;
+            *gy = (h01 - h00) * (1.f - fx) + (h11 - h10) * fx;
+        }
+        return (h00 * (1.f - fx) + h10 * fx) * (1.f - fy) + (h01 * (1.f - fx) + h11 * fx) * fy;
+    };
+
+    float dx = 0.f, dy = 0.f;
+    float speed = 1.f, water = 1.f, sediment = 0.f;
+    for (int step = 0; step < P.lifetime; step++) {
+        const int ix = int(px), iy = int(py);
+        const float fx = px - float(ix), fy = py - float(iy);
+
+        float gx, gy;
+        const float height = sample(px, py, &gx, &gy);
+
+        // new direction: previous one blended with downhill, one cell per step
+        dx = dx * P.inertia - gx * (1.f - P.inertia);
+        dy = dy * P.inertia - gy * (1.f - P.inertia);
+        const float len = std::sqrt(dx * dx + dy * dy);
+        if (len < 1e-12f) break; // flat: nowhere to go
+        dx /= len;
+        dy /= len;
+        px += dx;
+        py += dy;
+        if (px < bx0 || px >= bx1 || py < by0 || py >= by1) break;
+
+        const float drop = sample(px, py, nullptr, nullptr) - height; // > 0: uphill
+        const float capacity = std::max(-drop * speed * water * P.capacity, minCapacity);
+
+        if (sediment > capacity || drop > 0.f) {
+            // uphill: fill the pit behind us (at most up to the new height);
+            // otherwise drop part of what exceeds the capacity
+            const float amount = drop > 0.f ? std::min(drop, sediment) : (sediment - capacity) * P.deposit;
+            sediment -= amount;
+            at(ix,     iy)     += amount * (1.f - fx) * (1.f - fy);
+            at(ix + 1, iy)     += amount * fx * (1.f - fy);
+            at(ix,     iy + 1) += amount * (1.f - fx) * fy;
+            at(ix + 1, iy + 1) += amount * fx * fy;
+        } else {
+            // never dig deeper than the drop, or the droplet would carve a pit
+            const float amount = std::min((capacity - sediment) * P.erode, -drop);
+            for (const BrushTap &t : m_brush) {
+                const int row = ix + t.dx, col = iy + t.dy;
+                if (row < 0 || row > res || col < 0 || col > res) continue;
+                at(row, col) -= amount * t.weight;
+            }
+            sediment += amount;
+        }
+
+        speed = std::sqrt(std::max(0.f, speed * speed - drop * gravity));
+        water *= 1.f - P.evaporate;
+    }
+}
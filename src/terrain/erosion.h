@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Droplet-based hydraulic erosion over a heightfield.
+//
+// Each droplet starts at a random grid position, runs downhill with some inertia,
+// picks up sediment while it speeds up on steep ground and drops it where it slows
+// down or fills a pit. Heights use TerrainGenerator::Heightfield's layout:
+// (resolution + 3)^2 samples, row-major (row = x), one-sample apron. Droplets move
+// over the interior grid; the apron is left untouched.
+//
+// The grid is split into kTileSize tiles coloured 2x2. Droplets are seeded per
+// tile and never leave a halo of kTileSize / 2 around it, so the tiles of one colour
+// never touch the same samples and run on parallel workers; the colours run one
+// after another, over several rounds. Seeds depend only on (seed, round, tile,
+// droplet index), so the result is bit-identical for any worker count and for any
+// mix of run() and step() calls.
+class HydraulicErosion
+{
+public:
+    static constexpr int kTileSize = 64; // grid cells per tile side
+    static constexpr int kRounds = 8;    // passes over the four colours
+
+    struct Params {
+        float density   = 1.0f;  // droplets per grid cell
+        int   lifetime  = 48;    // max steps (one cell each) per droplet
+        float inertia   = 0.05f; // 0..1, share of the previous direction kept per step
+        float capacity  = 4.0f;  // sediment capacity per unit of drop * speed * water
+        float erode     = 0.3f;  // share of the free capacity taken per step
+        float deposit   = 0.3f;  // share of the excess sediment dropped per step
+        float evaporate = 0.02f; // water lost per step
+        int   radius    = 2;     // erosion brush radius in cells, 1..8
+        uint32_t seed   = 0;
+    };
+
+    // Starts a new job on heights; nothing is eroded until run() or step().
+    // key identifies the input (see TerrainGenerator::buildHeightfield).
+    void reset(std::vector<float> heights, int resolution, const Params &params, uint64_t key);
+
+    uint64_t key() const { return m_key; }
+    bool done() const { return m_batch >= m_batches.size(); }
+    float progress() const { return m_total ? float(m_finished) / float(m_total) : 1.f; }
+    // current heights, partly eroded until done()
+    const std::vector<float> &heights() const { return m_heights; }
+
+    // Runs every remaining droplet; the tiles of each colour on parallel workers
+    // (0 = hardware concurrency, 1 = serial).
+    void run(int workers);
+
+    // Runs up to maxDroplets on the calling thread, stopping early once budgetMs
+    // is spent. Returns the number of droplets run.
+    int step(int maxDroplets, double budgetMs);
+
+private:
+    struct Tile {
+        int x0, y0, x1, y1; // cell range [x0, x1) x [y0, y1)
+        uint32_t index;     // seeds the droplets
+        uint32_t droplets;  // per round
+    };
+    struct BrushTap {
+        int dx, dy;
+        float weight;
+    };
+
+    void runDroplets(const Tile &tile, int round, uint32_t first, uint32_t end);
+    void droplet(const Tile &tile, uint32_t seed);
+    float &at(int row, int col) { return m_heights[size_t(row + 1) * m_stride + size_t(col + 1)]; }
+
+    std::vector<float> m_heights;
+    int m_resolution = 0;
+    int m_stride = 0;
+    Params m_params;
+    uint64_t m_key = 0;
+
+    std::vector<Tile> m_tiles;
+    std::vector<BrushTap> m_brush;
+    // kRounds * 4 batches of tile indices, one per (round, colour), in run order
+    std::vector<std::vector<int>> m_batches;
+
+    // cursor: next droplet is m_droplet of tile m_batches[m_batch][m_tile]
+    size_t m_batch = 0;
+    size_t m_tile = 0;
+    uint32_t m_droplet = 0;
+    uint64_t m_finished = 0, m_total = 0;
+};
@@ -0,0 +1,73 @@
+#include "heightfield_query.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+HeightfieldQuery::HeightfieldQuery(TerrainGenerator::Heightfield hf)
+    : m_grid(std::make_shared<const TerrainGenerator::Heightfield>(std::move(hf)))
+{
+}
+
+HeightfieldQuery::Cell HeightfieldQuery::cell(glm::vec2 uv) const
+{
+    assert(valid());
+    const int res = m_grid->resolution;
+
+    // grid point (row, col) sits at local (row / res, col / res)
+    glm::vec2 g = glm::clamp(uv, 0.f, 1.f) * float(res);
+    int row = std::min(int(g.x), res - 1);
+    int col = std::min(int(g.y), res - 1);
+
+    Cell c;
+    c.h00 = m_grid->at(row,     col);
+    c.h10 = m_grid->at(row + 1, col);
+    c.h01 = m_grid->at(row,     col + 1);
+    c.h11 = m_grid->at(row + 1, col + 1);
+    c.fx = g.x - float(row);
+    c.fy = g.y - float(col);
+    return c;
+}
+
+float HeightfieldQuery::height(glm::vec2 uv) const
+{
+    if (!valid()) return 0.f;
+    Cell c = cell(uv);
+    float a = glm::mix(c.h00, c.h10, c.fx);
+    float b = glm::mix(c.h01, c.h11, c.fx);
+    return glm::mix(a, b, c.fy);
+}
+
+glm::vec2 HeightfieldQuery::gradient(glm::vec2 uv) const
+{
+    if (!valid()) return glm::vec2(0.f);
+    Cell c = cell(uv);
+    const float res = float(m_grid->resolution);
+    float du = glm::mix(c.h10 - c.h00, c.h11 - c.h01, c.fy);
+    float dv = glm::mix(c.h01 - c.h00, c.h11 - c.h10, c.fx);
+    return glm::vec2(du, dv) * res;
+}
+
+glm::vec3 HeightfieldQuery::normal(glm::vec2 uv) const
+{
+    glm::vec2 g = gradient(uv);
+    return glm::normalize(glm::vec3(-g.x, -g.y, 1.f));
+}
+
+void HeightfieldQuery::heights(std::span<const glm::vec2> uv, std::span<float> out) const
+{
+    assert(out.size() >= uv.size());
+    for (size_t i = 0; i < uv.size(); i++) out[i] = height(uv[i]);
+}
+
+void HeightfieldQuery::gradients(std::span<const glm::vec2> uv, std::span<glm::vec2> out) const
+{
+    assert(out.size() >= uv.size());
+    for (size_t i = 0; i < uv.size(); i++) out[i] = gradient(uv[i]);
+}
+
+void HeightfieldQuery::normals(std::span<const glm::vec2> uv, std::span<glm::vec3> out) const
+{
+    assert(out.size() >= uv.size());
+    for (size_t i = 0; i < uv.size(); i++) out[i] = normal(uv[i]);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include "glm/glm.hpp"
+#include "terraingenerator.h"
+
+// O(1) height / slope lookups on a generated heightfield.
+//
+// Samples the grid the terrain mesh was built from instead of re-running the
+// noise chain, so a query costs four loads and a lerp. Coordinates are the tile's
+// local (0..1)^2 uv (clamped), results are in local space like TerrainGenerator's
+// (z = world-scaled height; multiply by the model matrix for world units).
+//
+// The grid is immutable and shared between copies: every method is const and
+// safe to call from several threads, and taking a copy is cheap.
+class HeightfieldQuery
+{
+public:
+    HeightfieldQuery() = default;
+    // takes its own copy of hf (move one in to avoid it); later buildHeightfield
+    // calls do not affect this query
+    explicit HeightfieldQuery(TerrainGenerator::Heightfield hf);
+
+    // false for a default-constructed query or one built from an empty grid;
+    // such a query reports flat ground at height 0
+    bool valid() const { return m_grid && m_grid->resolution > 0; }
+    int resolution() const { return valid() ? m_grid->resolution : 0; }
+
+    // bilinear height of the grid cell containing uv
+    float height(glm::vec2 uv) const;
+    // (dz/du, dz/dv) of that same bilinear patch
+    glm::vec2 gradient(glm::vec2 uv) const;
+    // unit local-space normal: normalize(-dz/du, -dz/dv, 1)
+    glm::vec3 normal(glm::vec2 uv) const;
+
+    // span variants: out[i] = f(uv[i]); out must be at least as long as uv
+    void heights(std::span<const glm::vec2> uv, std::span<float> out) const;
+    void gradients(std::span<const glm::vec2> uv, std::span<glm::vec2> out) const;
+    void normals(std::span<const glm::vec2> uv, std::span<glm::vec3> out) const;
+
+private:
+    // bilinear cell lookup shared by every query
+    struct Cell {
+        float h00, h10, h01, h11; // corners, first index = row (x)
+        float fx, fy;             // position inside the cell, 0..1
+    };
+    Cell cell(glm::vec2 uv) const;
+
+    std::shared_ptr<const TerrainGenerator::Heightfield> m_grid;
+};
@@ -0,0 +1,207 @@
+#include "horizon_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr float kNoBound = -std::numeric_limits<float>::infinity();
+constexpr float kTwoPi = 6.28318530718f;
+constexpr float kMaxRadius = 1.5f;   // past the tile's diagonal
+constexpr float kRadiusGrowth = 1.05f;
+
+} // namespace
+
+void HorizonCuller::clear()
+{
+    m_cells = 0;
+    m_levels.clear();
+    m_radii.clear();
+    m_horizon.clear();
+    m_valid = false;
+}
+
+void HorizonCuller::build(std::span<const TerrainGenerator::TerrainVertex> vertices,
+                          std::span<const uint32_t> indices, int cellsPerSide)
+{
+    clear();
+    const int n = cellsPerSide;
+    if (n <= 0 || indices.size() < 3)
+        return;
+    m_cells = n;
+
+    // level 0: the lowest vertex of every triangle overlapping the cell. A triangle
+    // never dips below its lowest vertex; its bounding box may claim a few cells it
+    // does not reach, which only lowers them.
+    std::vector<float> base(size_t(n) * n, std::numeric_limits<float>::infinity());
+    m_maxHeight = kNoBound;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const TerrainGenerator::TerrainVertex &a = vertices[indices[t]];
+        const TerrainGenerator::TerrainVertex &b = vertices[indices[t + 1]];
+        const TerrainGenerator::TerrainVertex &c = vertices[indices[t + 2]];
+        const float lo = std::min({a.z, b.z, c.z});
+        m_maxHeight = std::max({m_maxHeight, a.z, b.z, c.z});
+
+        // cells whose interior the triangle's bounding box reaches
+        auto cellRange = [&](float v0, float v1, int &c0, int &c1) {
+            c0 = std::clamp(int(std::floor(v0 * n)), 0, n - 1);
+            c1 = std::clamp(int(std::ceil(v1 * n)) - 1, c0, n - 1);
+        };
+        int x0, x1, y0, y1;
+        cellRange(std::min({a.x, b.x, c.x}), std::max({a.x, b.x, c.x}), x0, x1);
+        cellRange(std::min({a.y, b.y, c.y}), std::max({a.y, b.y, c.y}), y0, y1);
+        for (int x = x0; x <= x1; x++)
+            for (int y = y0; y <= y1; y++) {
+                float &cell = base[size_t(x) * n + y];
+                cell = std::min(cell, lo);
+            }
+    }
+    for (float &cell : base)
+        if (cell == std::numeric_limits<float>::infinity()) cell = kNoBound;
+    m_levels.push_back(std::move(base));
+
+    // coarser levels: 2x2 minimum, the last row/column alone when the side is odd
+    for (int side = n; side > 1;) {
+        const int next = (side + 1) / 2;
+        const std::vector<float> &fine = m_levels.back();
+        std::vector<float> coarse(size_t(next) * next);
+        for (int x = 0; x < next; x++)
+            for (int y = 0; y < next; y++) {
+                const int fx = 2 * x, fy = 2 * y;
+                const int gx = std::min(fx + 1, side - 1), gy = std::min(fy + 1, side - 1);
+                coarse[size_t(x) * next + y] = std::min({fine[size_t(fx) * side + fy], fine[size_t(fx) * side + gy],
+                                                         fine[size_t(gx) * side + fy], fine[size_t(gx) * side + gy]});
+            }
+        m_levels.push_back(std::move(coarse));
+        side = next;
+    }
+
+    // one cell wide near the eye, then growing by kRadiusGrowth per bin
+    const float cell = 1.f / float(n);
+    for (float r = cell; ; r = std::max(r * kRadiusGrowth, r + cell)) {
+        m_radii.push_back(r);
+        if (r >= kMaxRadius) break;
+    }
+    m_horizon.resize(size_t(kSectors) * (m_radii.size() - 1));
+}
+
+float HorizonCuller::minHeight(float x0, float y0, float x1, float y1) const
+{
+    if (x0 < 0.f || y0 < 0.f || x1 > 1.f || y1 > 1.f)
+        return kNoBound;
+    const int n = m_cells;
+    const int cx0 = std::min(int(x0 * n), n - 1), cx1 = std::min(int(x1 * n), n - 1);
+    const int cy0 = std::min(int(y0 * n), n - 1), cy1 = std::min(int(y1 * n), n - 1);
+
+    // the finest level on which the range spans at most 2x2 cells
+    int level = 0;
+    while (((cx1 >> level) - (cx0 >> level)) > 1 || ((cy1 >> level) - (cy0 >> level)) > 1)
+        level++;
+    const std::vector<float> &cells = m_levels[level];
+    const int side = ((n - 1) >> level) + 1;
+    float h = std::numeric_limits<float>::infinity();
+    for (int x = cx0 >> level; x <= (cx1 >> level); x++)
+        for (int y = cy0 >> level; y <= (cy1 >> level); y++)
+            h = std::min(h, cells[size_t(x) * side + y]);
+    return h;
+}
+
+void HorizonCuller::update(const glm::vec3 &eye)
+{
+    if (empty() || (m_valid && eye == m_eye))
+        return;
+    m_eye = eye;
+    m_valid = true;
+
+    const int bins = int(m_radii.size()) - 1;
+    const float step = kTwoPi / float(kSectors);
+    // how far an arc of the sector bulges past its chord, per unit radius
+    const float sagitta = 1.f - std::cos(0.5f * step);
+    // nothing to find past the farthest tile corner
+    const float reach = glm::length(glm::vec2(std::max(eye.x, 1.f - eye.x), std::max(eye.y, 1.f - eye.y)));
+
+    for (int s = 0; s < kSectors; s++) {
+        const glm::vec2 d0(std::cos(s * step), std::sin(s * step));
+        const glm::vec2 d1(std::cos((s + 1) * step), std::sin((s + 1) * step));
+        float *horizon = &m_horizon[size_t(s) * bins];
+        float running = kNoBound;
+        int k = 0;
+        for (; k < bins; k++) {
+            const float r0 = m_radii[k], r1 = m_radii[k + 1];
+            if (r0 > reach)
+                break;
+            // no ground past here can raise the horizon
+            if (m_maxHeight > eye.z && (m_maxHeight - eye.z) / r0 <= running)
+                break;
+
+            // bounding box of the annular piece [r0, r1] x [s, s + 1) of the sector
+            const glm::vec2 e(eye);
+            const glm::vec2 p[4] = {e + r0 * d0, e + r0 * d1, e + r1 * d0, e + r1 * d1};
+            glm::vec2 lo = glm::min(glm::min(p[0], p[1]), glm::min(p[2], p[3]));
+            glm::vec2 hi = glm::max(glm::max(p[0], p[1]), glm::max(p[2], p[3]));
+            const float pad = r1 * sagitta + 1e-6f;
+            lo -= pad;
+            hi += pad;
+
+            const float h = minHeight(lo.x, lo.y, hi.x, hi.y);
+            if (h != kNoBound) {
+                // a ray under slope (h - z) / r for some r in [r0, r1] passes below h
+                const float slope = (h - eye.z) / (h > eye.z ? r0 : r1);
+                running = std::max(running, slope);
+            }
+            horizon[k] = running;
+        }
+        std::fill(horizon + k, horizon + bins, running);
+    }
+}
+
+bool HorizonCuller::occluded(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    if (!m_valid)
+        return false;
+    const glm::vec2 e(m_eye);
+    if (e.x >= boxMin.x && e.x <= boxMax.x && e.y >= boxMin.y && e.y <= boxMax.y)
+        return false;
+
+    // nearest and farthest horizontal distance from the eye to the footprint
+    const glm::vec2 gap = glm::max(glm::vec2(0.f), glm::max(glm::vec2(boxMin) - e, e - glm::vec2(boxMax)));
+    const float nearest = glm::length(gap);
+    const glm::vec2 corners[4] = {glm::vec2(boxMin.x, boxMin.y), glm::vec2(boxMax.x, boxMin.y),
+                                  glm::vec2(boxMin.x, boxMax.y), glm::vec2(boxMax.x, boxMax.y)};
+    float farthest = 0.f;
+    for (const glm::vec2 &c : corners)
+        farthest = std::max(farthest, glm::length(c - e));
+
+    // only bins that end before the box are in front of all of it
+    const int bins = int(m_radii.size()) - 1;
+    const int k = int(std::upper_bound(m_radii.begin(), m_radii.end(), nearest) - m_radii.begin()) - 2;
+    if (k < 0)
+        return false;
+
+    // steepest ray from the eye to any point of the box
+    const float rise = boxMax.z - m_eye.z;
+    const float slope = rise / (rise >= 0.f ? nearest : farthest);
+
+    // sectors spanned by the footprint, which lies within half a turn of its centre
+    const glm::vec2 centre = 0.5f * (glm::vec2(boxMin) + glm::vec2(boxMax)) - e;
+    const float mid = std::atan2(centre.y, centre.x);
+    float lo = 0.f, hi = 0.f;
+    for (const glm::vec2 &c : corners) {
+        const glm::vec2 d = c - e;
+        float delta = std::atan2(d.y, d.x) - mid;
+        if (delta > 0.5f * kTwoPi) delta -= kTwoPi;
+        if (delta < -0.5f * kTwoPi) delta += kTwoPi;
+        lo = std::min(lo, delta);
+        hi = std::max(hi, delta);
+    }
+    const float step = kTwoPi / float(kSectors);
+    const int s0 = int(std::floor((mid + lo) / step));
+    const int s1 = int(std::floor((mid + hi) / step));
+    for (int s = s0; s <= s1; s++) {
+        const int sector = ((s % kSectors) + kSectors) % kSectors;
+        if (!(slope < m_horizon[size_t(sector) * bins + k]))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "glm/glm.hpp"
+#include "terraingenerator.h"
+
+// Terrain horizon occlusion for objects standing on a single terrain tile.
+//
+// build() keeps a min-height pyramid over the tile's (0..1)^2: each cell holds a
+// height the mesh never dips below inside it. update() marches outwards from the
+// eye in kSectors azimuth sectors over geometrically growing distance bins and
+// records, per sector, the steepest elevation angle (as a slope) the ground is
+// known to reach up to each distance. A box is occluded when every sector it spans
+// has a horizon above the steepest ray from the eye to the box. All in the tile's
+// local space (z up); every bound errs on the visible side, so nothing visible is
+// ever reported occluded.
+class HorizonCuller
+{
+public:
+    static constexpr int kSectors = 256;
+
+    // cellsPerSide: pyramid resolution, ideally the mesh's grid resolution. The
+    // mesh must cover the whole tile; cells no triangle touches never occlude.
+    void build(std::span<const TerrainGenerator::TerrainVertex> vertices,
+               std::span<const uint32_t> indices, int cellsPerSide);
+    void clear();
+    bool empty() const { return m_levels.empty(); }
+
+    // Rebuilds the horizon around eye (local space); cheap when eye did not move.
+    void update(const glm::vec3 &eye);
+
+    // true only when the box is certainly hidden behind the terrain from the
+    // eye of the last update()
+    bool occluded(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+private:
+    // lowest pyramid bound over [x0, x1] x [y0, y1]; -inf unless inside the tile
+    float minHeight(float x0, float y0, float x1, float y1) const;
+
+    int m_cells = 0;
+    std::vector<std::vector<float>> m_levels; // level L: ((m_cells - 1) >> L) + 1 cells per side, row = x
+    float m_maxHeight = 0.f;
+    std::vector<float> m_radii;   // distance bin edges, bin k is [m_radii[k], m_radii[k + 1]]
+    std::vector<float> m_horizon; // kSectors * bins, running max of the bins' slopes
+    glm::vec3 m_eye = glm::vec3(0.f);
+    bool m_valid = false;         // m_horizon belongs to m_eye
+};
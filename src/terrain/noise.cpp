@@ -0,0 +1,314 @@
+#include "noise.h"
+
+#include <cmath>
+#include <cstdlib>
+#include "glm/glm.hpp"
+
+#if !defined(NOISE_FORCE_SCALAR)
+#if defined(__AVX2__)
+#define NOISE_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define NOISE_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define NOISE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace Noise {
+
+// ===== tables ======================================================
+
+void fillRandomTable(GradientTable &t, unsigned seed)
+{
+    // keep the exact expression the lookup was originally built with: the order the
+    // two rand() calls are evaluated in is up to the compiler, and the terrain depends on it
+    std::srand(seed);
+    for (int i = 0; i < GradientTable::kSize; i++) {
+        glm::vec2 g(std::rand() * 2.0 / RAND_MAX - 1.0,
+                    std::rand() * 2.0 / RAND_MAX - 1.0);
+        t.gx[i] = g.x;
+        t.gy[i] = g.y;
+    }
+    t.offset = 0;
+}
+
+void fillAngularTable(GradientTable &t, unsigned offset)
+{
+    for (int i = 0; i < GradientTable::kSize; i++) {
+        float a = (i / 1024.f) * 6.2831853f; // [0,2pi)
+        t.gx[i] = std::cos(a);
+        t.gy[i] = std::sin(a);
+    }
+    t.offset = offset;
+}
+
+// ===== scalar kernel ===============================================
+
+static inline float fbmScalar(const GradientTable &t, float x, float y,
+                              int octaves, float baseFreq, float lacunarity, float gain)
+{
+    float f = baseFreq;
+    float a = 1.f;
+    float h = 0.f;
+    for (int i = 0; i < octaves; i++) {
+        h += a * perlin(t, x * f, y * f);
+        f *= lacunarity;
+        a *= gain;
+    }
+    return h;
+}
+
+// clamp(1 - |n|, 0, 1)^sharpness, with the square spelled out
+static inline float ridge(float n, float sharpness)
+{
+    float r = 1.f - std::fabs(n);
+    r = r < 0.f ? 0.f : (r > 1.f ? 1.f : r);
+    return sharpness == 2.f ? r * r : std::pow(r, sharpness);
+}
+
+static inline float ridgedScalar(const GradientTable &t, float x, float y, int octaves,
+                                 float baseFreq, float lacunarity, float gain, float sharpness)
+{
+    float f = baseFreq;
+    float a = 1.f;
+    float h = 0.f;
+    for (int i = 0; i < octaves; i++) {
+        h += a * ridge(perlin(t, x * f, y * f), sharpness);
+        f *= lacunarity;
+        a *= gain;
+    }
+    return h;
+}
+
+// ===== SIMD lanes ==================================================
+// Each backend provides the handful of ops perlinLanes needs; the kernel
+// itself is written once below.
+
+#if NOISE_SIMD_AVX2
+struct Lanes {
+    static constexpr int W = 8;
+    using F = __m256;
+    using I = __m256i;
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static F set1(float v) { return _mm256_set1_ps(v); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F abs(F v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+    static F clamp01(F v) {
+        return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+    }
+    static F floor(F v) { return _mm256_floor_ps(v); }
+    static I toInt(F v) { return _mm256_cvttps_epi32(v); }
+    static F toFloat(I v) { return _mm256_cvtepi32_ps(v); }
+    static I inc(I v) { return _mm256_add_epi32(v, _mm256_set1_epi32(1)); }
+    static I hash(I x, I y, uint32_t offset) {
+        I h = _mm256_add_epi32(_mm256_mullo_epi32(x, _mm256_set1_epi32(41)),
+                               _mm256_mullo_epi32(y, _mm256_set1_epi32(43)));
+        h = _mm256_add_epi32(h, _mm256_set1_epi32(int(offset)));
+        return _mm256_and_si256(h, _mm256_set1_epi32(GradientTable::kSize - 1));
+    }
+    static F gather(const float *table, I idx) { return _mm256_i32gather_ps(table, idx, 4); }
+};
+#elif NOISE_SIMD_SSE2
+struct Lanes {
+    static constexpr int W = 4;
+    using F = __m128;
+    using I = __m128i;
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static F set1(float v) { return _mm_set1_ps(v); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F abs(F v) { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+    static F clamp01(F v) {
+        return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    }
+    // SSE2 has no round instruction: truncate, then step down where that rounded up
+    static F floor(F v) {
+        F t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.f)));
+    }
+    static I toInt(F v) { return _mm_cvttps_epi32(v); }
+    static F toFloat(I v) { return _mm_cvtepi32_ps(v); }
+    static I inc(I v) { return _mm_add_epi32(v, _mm_set1_epi32(1)); }
+    // no 32-bit mullo before SSE4.1: 41 = 32+8+1, 43 = 32+8+2+1
+    static I hash(I x, I y, uint32_t offset) {
+        I x41 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x, 5), _mm_slli_epi32(x, 3)), x);
+        I y43 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(y, 5), _mm_slli_epi32(y, 3)),
+                              _mm_add_epi32(_mm_slli_epi32(y, 1), y));
+        I h = _mm_add_epi32(_mm_add_epi32(x41, y43), _mm_set1_epi32(int(offset)));
+        return _mm_and_si128(h, _mm_set1_epi32(GradientTable::kSize - 1));
+    }
+    static F gather(const float *table, I idx) {
+        alignas(16) int i[4];
+        _mm_store_si128(reinterpret_cast<I *>(i), idx);
+        return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+    }
+};
+#elif NOISE_SIMD_NEON
+struct Lanes {
+    static constexpr int W = 4;
+    using F = float32x4_t;
+    using I = int32x4_t;
+    static F load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, F v) { vst1q_f32(p, v); }
+    static F set1(float v) { return vdupq_n_f32(v); }
+    static F add(F a, F b) { return vaddq_f32(a, b); }
+    static F sub(F a, F b) { return vsubq_f32(a, b); }
+    static F mul(F a, F b) { return vmulq_f32(a, b); }
+    static F abs(F v) { return vabsq_f32(v); }
+    static F clamp01(F v) { return vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.f)), vdupq_n_f32(1.f)); }
+    static F floor(F v) { return vrndmq_f32(v); }
+    static I toInt(F v) { return vcvtq_s32_f32(v); }
+    static F toFloat(I v) { return vcvtq_f32_s32(v); }
+    static I inc(I v) { return vaddq_s32(v, vdupq_n_s32(1)); }
+    static I hash(I x, I y, uint32_t offset) {
+        I h = vaddq_s32(vmulq_n_s32(x, 41), vmulq_n_s32(y, 43));
+        h = vaddq_s32(h, vdupq_n_s32(int(offset)));
+        return vandq_s32(h, vdupq_n_s32(GradientTable::kSize - 1));
+    }
+    static F gather(const float *table, I idx) {
+        int i[4];
+        vst1q_s32(i, idx);
+        float v[4] = {table[i[0]], table[i[1]], table[i[2]], table[i[3]]};
+        return vld1q_f32(v);
+    }
+};
+#endif
+
+#if NOISE_SIMD_AVX2 || NOISE_SIMD_SSE2 || NOISE_SIMD_NEON
+#define NOISE_HAS_LANES 1
+
+// same operation order as the scalar perlin() above
+static inline Lanes::F perlinLanes(const GradientTable &t, Lanes::F x, Lanes::F y)
+{
+    using L = Lanes;
+    L::F fx = L::floor(x), fy = L::floor(y);
+    L::I x0 = L::toInt(fx), y0 = L::toInt(fy);
+    L::I x1 = L::inc(x0),   y1 = L::inc(y0);
+
+    L::F dx0 = L::sub(x, fx), dx1 = L::sub(x, L::toFloat(x1));
+    L::F dy0 = L::sub(y, fy), dy1 = L::sub(y, L::toFloat(y1));
+
+    L::I iTL = L::hash(x0, y1, t.offset);
+    L::I iTR = L::hash(x1, y1, t.offset);
+    L::I iBR = L::hash(x1, y0, t.offset);
+    L::I iBL = L::hash(x0, y0, t.offset);
+
+    auto dot = [&](L::I i, L::F dx, L::F dy) {
+        return L::add(L::mul(L::gather(t.gx, i), dx), L::mul(L::gather(t.gy, i), dy));
+    };
+    L::F A = dot(iTL, dx0, dy1);
+    L::F B = dot(iTR, dx1, dy1);
+    L::F C = dot(iBR, dx1, dy0);
+    L::F D = dot(iBL, dx0, dy0);
+
+    auto smooth = [&](L::F s) {
+        s = L::clamp01(s);
+        return L::mul(L::mul(s, s), L::sub(L::set1(3.f), L::mul(L::set1(2.f), s)));
+    };
+    L::F su = smooth(dx0), sv = smooth(dy0);
+
+    L::F bottom = L::add(D, L::mul(su, L::sub(C, D)));
+    L::F top    = L::add(A, L::mul(su, L::sub(B, A)));
+    return L::add(bottom, L::mul(sv, L::sub(top, bottom)));
+}
+#endif
+
+// ===== batch API ===================================================
+
+void perlinBatch(const GradientTable &t,
+                 const float *x, const float *y, float *out, int n)
+{
+    int i = 0;
+#if NOISE_HAS_LANES
+    for (; i + Lanes::W <= n; i += Lanes::W) {
+        Lanes::store(out + i, perlinLanes(t, Lanes::load(x + i), Lanes::load(y + i)));
+    }
+#endif
+    for (; i < n; i++) out[i] = perlin(t, x[i], y[i]);
+}
+
+void fbmBatch(const GradientTable &t,
+              const float *x, const float *y, float *out, int n,
+              int octaves, float baseFreq, float lacunarity, float gain)
+{
+    int i = 0;
+#if NOISE_HAS_LANES
+    for (; i + Lanes::W <= n; i += Lanes::W) {
+        Lanes::F px = Lanes::load(x + i), py = Lanes::load(y + i);
+        Lanes::F h = Lanes::set1(0.f);
+        float f = baseFreq;
+        float a = 1.f;
+        for (int k = 0; k < octaves; k++) {
+            Lanes::F nv = perlinLanes(t, Lanes::mul(px, Lanes::set1(f)),
+                                         Lanes::mul(py, Lanes::set1(f)));
+            h = Lanes::add(h, Lanes::mul(Lanes::set1(a), nv));
+            f *= lacunarity;
+            a *= gain;
+        }
+        Lanes::store(out + i, h);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = fbmScalar(t, x[i], y[i], octaves, baseFreq, lacunarity, gain);
+    }
+}
+
+void ridgedBatch(const GradientTable &t,
+                 const float *x, const float *y, float *out, int n,
+                 int octaves, float baseFreq, float lacunarity, float gain, float sharpness)
+{
+    int i = 0;
+#if NOISE_HAS_LANES
+    const bool square = sharpness == 2.f;
+    for (; i + Lanes::W <= n; i += Lanes::W) {
+        Lanes::F px = Lanes::load(x + i), py = Lanes::load(y + i);
+        Lanes::F h = Lanes::set1(0.f);
+        float f = baseFreq;
+        float a = 1.f;
+        for (int k = 0; k < octaves; k++) {
+            Lanes::F nv = perlinLanes(t, Lanes::mul(px, Lanes::set1(f)),
+                                         Lanes::mul(py, Lanes::set1(f)));
+            Lanes::F r = Lanes::clamp01(Lanes::sub(Lanes::set1(1.f), Lanes::abs(nv)));
+            if (square) {
+                r = Lanes::mul(r, r);
+            } else {
+                // no vector pow: the other exponents go through std::pow lane by lane
+                alignas(32) float lane[Lanes::W];
+                Lanes::store(lane, r);
+                for (float &v : lane) v = std::pow(v, sharpness);
+                r = Lanes::load(lane);
+            }
+            h = Lanes::add(h, Lanes::mul(Lanes::set1(a), r));
+            f *= lacunarity;
+            a *= gain;
+        }
+        Lanes::store(out + i, h);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = ridgedScalar(t, x[i], y[i], octaves, baseFreq, lacunarity, gain, sharpness);
+    }
+}
+
+const char *backendName()
+{
+#if NOISE_SIMD_AVX2
+    return "avx2";
+#elif NOISE_SIMD_SSE2
+    return "sse2";
+#elif NOISE_SIMD_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace Noise
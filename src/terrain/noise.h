@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Batch 2D gradient noise shared by TerrainGenerator and VoxelChunk.
+//
+// The SIMD backend is picked at build time from the target flags:
+//   AVX2 (8 lanes) > SSE2 (4 lanes) > NEON (4 lanes) > scalar.
+// Define NOISE_FORCE_SCALAR to force the scalar fallback.
+// All backends run the same float operations in the same order as the scalar
+// kernel, so batch and per-point results are bit-identical.
+namespace Noise {
+
+// Gradient lattice: 1024 unit-ish gradients stored SoA for gathers.
+// Lattice hash is branch-free: (x*41 + y*43 + offset) & 1023, which matches the
+// old std::hash<int>(...) % 1024 lookup of both generators.
+struct GradientTable {
+    static constexpr int kSize = 1024;
+
+    alignas(32) float gx[kSize];
+    alignas(32) float gy[kSize];
+    uint32_t offset = 0;
+
+    int index(int x, int y) const {
+        return int((uint32_t(x) * 41u + uint32_t(y) * 43u + offset) & uint32_t(kSize - 1));
+    }
+};
+
+// Gradients from std::srand(seed) / std::rand(), as TerrainGenerator always did.
+void fillRandomTable(GradientTable &t, unsigned seed);
+
+// Gradients on the unit circle at angle (i / 1024) * 2pi, as VoxelChunk::randGrad did.
+void fillAngularTable(GradientTable &t, unsigned offset);
+
+namespace detail {
+inline float smooth3(float t) {
+    t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+    return t * t * (3.f - 2.f * t);
+}
+inline float interp(float a, float b, float t) {
+    return a + smooth3(t) * (b - a);
+}
+} // namespace detail
+
+// single-point gradient noise, roughly in [-1, 1]
+// (inline so the compile-time fBm kernels in noise_kernels.h can unroll through it)
+inline float perlin(const GradientTable &t, float x, float y)
+{
+    int x0 = static_cast<int>(floorf(x));
+    int y0 = static_cast<int>(floorf(y));
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    float dx0 = x - x0, dx1 = x - x1;
+    float dy0 = y - y0, dy1 = y - y1;
+
+    int iTL = t.index(x0, y1);
+    int iTR = t.index(x1, y1);
+    int iBR = t.index(x1, y0);
+    int iBL = t.index(x0, y0);
+
+    float A = t.gx[iTL] * dx0 + t.gy[iTL] * dy1;
+    float B = t.gx[iTR] * dx1 + t.gy[iTR] * dy1;
+    float C = t.gx[iBR] * dx1 + t.gy[iBR] * dy0;
+    float D = t.gx[iBL] * dx0 + t.gy[iBL] * dy0;
+
+    float bottom = detail::interp(D, C, dx0);
+    float top    = detail::interp(A, B, dx0);
+    return detail::interp(bottom, top, dy0);
+}
+
+// value of a noise function together with its analytic partial derivatives
+struct NoiseD {
+    float v  = 0.f;
+    float dx = 0.f; // d/dx
+    float dy = 0.f; // d/dy
+};
+
+// perlin() plus its gradient; v is bit-identical to perlin(t, x, y)
+inline NoiseD perlinD(const GradientTable &t, float x, float y)
+{
+    int x0 = static_cast<int>(floorf(x));
+    int y0 = static_cast<int>(floorf(y));
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    float dx0 = x - x0, dx1 = x - x1;
+    float dy0 = y - y0, dy1 = y - y1;
+
+    int iTL = t.index(x0, y1);
+    int iTR = t.index(x1, y1);
+    int iBR = t.index(x1, y0);
+    int iBL = t.index(x0, y0);
+
+    float A = t.gx[iTL] * dx0 + t.gy[iTL] * dy1;
+    float B = t.gx[iTR] * dx1 + t.gy[iTR] * dy1;
+    float C = t.gx[iBR] * dx1 + t.gy[iBR] * dy0;
+    float D = t.gx[iBL] * dx0 + t.gy[iBL] * dy0;
+
+    float bottom = detail::interp(D, C, dx0);
+    float top    = detail::interp(A, B, dx0);
+
+    // corner terms are linear, so their derivatives are the gradients themselves;
+    // smooth3'(t) = 6t(1 - t)
+    float sx = detail::smooth3(dx0), sy = detail::smooth3(dy0);
+    float dsx = 6.f * dx0 * (1.f - dx0), dsy = 6.f * dy0 * (1.f - dy0);
+
+    float bottomDx = t.gx[iBL] + dsx * (C - D) + sx * (t.gx[iBR] - t.gx[iBL]);
+    float bottomDy = t.gy[iBL] + sx * (t.gy[iBR] - t.gy[iBL]);
+    float topDx    = t.gx[iTL] + dsx * (B - A) + sx * (t.gx[iTR] - t.gx[iTL]);
+    float topDy    = t.gy[iTL] + sx * (t.gy[iTR] - t.gy[iTL]);
+
+    NoiseD n;
+    n.v  = detail::interp(bottom, top, dy0);
+    n.dx = bottomDx + sy * (topDx - bottomDx);
+    n.dy = bottomDy + dsy * (top - bottom) + sy * (topDy - bottomDy);
+    return n;
+}
+
+// fBm of perlinD; v matches fbmBatch / fbmFixed<Perlin> bit for bit
+inline NoiseD fbmD(const GradientTable &t, float x, float y,
+                   int octaves, float baseFreq, float lacunarity, float gain)
+{
+    float f = baseFreq;
+    float a = 1.f;
+    NoiseD h;
+    for (int o = 0; o < octaves; o++) {
+        NoiseD n = perlinD(t, x * f, y * f);
+        h.v  += a * n.v;
+        h.dx += a * f * n.dx;
+        h.dy += a * f * n.dy;
+        f *= lacunarity;
+        a *= gain;
+    }
+    return h;
+}
+
+// out[i] = perlin(x[i], y[i])
+void perlinBatch(const GradientTable &t,
+                 const float *x, const float *y, float *out, int n);
+
+// out[i] = sum_k gain^k * perlin(x[i] * f_k, y[i] * f_k), f_k = baseFreq * lacunarity^k
+void fbmBatch(const GradientTable &t,
+              const float *x, const float *y, float *out, int n,
+              int octaves, float baseFreq, float lacunarity, float gain);
+
+// Ridged fBm: out[i] = sum_k gain^k * r_k^sharpness, r_k = clamp(1 - |perlin(x[i] * f_k,
+// y[i] * f_k)|, 0, 1). All octaves of a lane run in registers; sharpness == 2, the
+// common case, squares instead of calling std::pow.
+void ridgedBatch(const GradientTable &t,
+                 const float *x, const float *y, float *out, int n,
+                 int octaves, float baseFreq, float lacunarity, float gain, float sharpness);
+
+// "avx2" / "sse2" / "neon" / "scalar"
+const char *backendName();
+
+} // namespace Noise
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include "noise.h"
+
+// Compile-time specialized fBm kernels.
+//
+// fbmFixed<Type, Octaves> has the noise basis and the octave count baked in: the
+// octave loop is a fold over an index sequence, so it is fully unrolled, and every
+// basis is inline. For Type == Perlin the result is bit-identical to fbmBatch and
+// to the old runtime fbm loop.
+//
+// TerrainParams picks an instantiation per layer through fbmKernel(type, octaves).
+namespace Noise {
+
+enum class NoiseType : uint8_t {
+    Perlin,   // gradient noise on the GradientTable lattice (the original look)
+    Simplex,  // 2D simplex: fewer corners per sample, less axis-aligned
+    Value,    // interpolated lattice values: cheapest, blobby
+    Cellular, // Worley F1: rounded cells / pits
+    Count
+};
+
+constexpr int kMaxKernelOctaves = 8;
+
+namespace detail {
+
+// integer hash (lowbias32) used to build the constexpr tables below
+constexpr uint32_t mix32(uint32_t x) {
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// [-1, 1] lattice values for Value noise
+constexpr std::array<float, 256> makeValueTable() {
+    std::array<float, 256> v{};
+    for (uint32_t i = 0; i < 256; i++) {
+        v[i] = float(mix32(i + 0x9e37u) & 0xFFFFu) / 32767.5f - 1.f;
+    }
+    return v;
+}
+
+// [0, 1) feature-point jitter for Cellular noise, x and y interleaved
+constexpr std::array<float, 512> makeJitterTable() {
+    std::array<float, 512> v{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t h = mix32(i + 0x51edu);
+        v[2 * i + 0] = float(h & 0xFFFFu) / 65536.f;
+        v[2 * i + 1] = float(h >> 16) / 65536.f;
+    }
+    return v;
+}
+
+inline constexpr std::array<float, 256> kValueTable  = makeValueTable();
+inline constexpr std::array<float, 512> kJitterTable = makeJitterTable();
+
+// the 8 simplex gradients (axes and normalized diagonals)
+inline constexpr float kSimplexGrad[8][2] = {
+    { 1.f, 0.f}, {-1.f, 0.f}, {0.f,  1.f}, {0.f, -1.f},
+    { 0.70710678f,  0.70710678f}, {-0.70710678f,  0.70710678f},
+    { 0.70710678f, -0.70710678f}, {-0.70710678f, -0.70710678f},
+};
+
+} // namespace detail
+
+// ===== bases ======================================================
+// Basis<T>::eval(table, x, y) returns roughly [-1, 1]. All bases hash the lattice
+// through GradientTable::index, so the table offset seeds every type.
+
+template <NoiseType T> struct Basis;
+
+template <> struct Basis<NoiseType::Perlin> {
+    static float eval(const GradientTable &t, float x, float y) { return perlin(t, x, y); }
+};
+
+template <> struct Basis<NoiseType::Simplex> {
+    static float eval(const GradientTable &t, float x, float y) {
+        constexpr float F2 = 0.36602540f; // (sqrt(3) - 1) / 2
+        constexpr float G2 = 0.21132487f; // (3 - sqrt(3)) / 6
+
+        float s = (x + y) * F2;
+        int i = static_cast<int>(floorf(x + s));
+        int j = static_cast<int>(floorf(y + s));
+        float u = float(i + j) * G2;
+        float x0 = x - (float(i) - u);
+        float y0 = y - (float(j) - u);
+
+        int i1 = x0 > y0 ? 1 : 0;
+        int j1 = 1 - i1;
+
+        float x1 = x0 - float(i1) + G2,       y1 = y0 - float(j1) + G2;
+        float x2 = x0 - 1.f + 2.f * G2,       y2 = y0 - 1.f + 2.f * G2;
+
+        auto corner = [&](int ci, int cj, float dx, float dy) {
+            float a = 0.5f - dx * dx - dy * dy;
+            if (a <= 0.f) return 0.f;
+            const float *g = detail::kSimplexGrad[t.index(ci, cj) & 7];
+            a *= a;
+            return a * a * (g[0] * dx + g[1] * dy);
+        };
+        // 70 maps the sum to about [-1, 1]
+        return 70.f * (corner(i, j, x0, y0) +
+                       corner(i + i1, j + j1, x1, y1) +
+                       corner(i + 1, j + 1, x2, y2));
+    }
+};
+
+template <> struct Basis<NoiseType::Value> {
+    static float eval(const GradientTable &t, float x, float y) {
+        int x0 = static_cast<int>(floorf(x));
+        int y0 = static_cast<int>(floorf(y));
+        float fx = x - x0, fy = y - y0;
+
+        auto v = [&](int ix, int iy) { return detail::kValueTable[t.index(ix, iy) & 255]; };
+        float bottom = detail::interp(v(x0, y0),     v(x0 + 1, y0),     fx);
+        float top    = detail::interp(v(x0, y0 + 1), v(x0 + 1, y0 + 1), fx);
+        return detail::interp(bottom, top, fy);
+    }
+};
+
+template <> struct Basis<NoiseType::Cellular> {
+    static float eval(const GradientTable &t, float x, float y) {
+        int cx = static_cast<int>(floorf(x));
+        int cy = static_cast<int>(floorf(y));
+
+        float best = 4.f; // squared F1 distance
+        for (int dj = -1; dj <= 1; ++dj) {
+            for (int di = -1; di <= 1; ++di) {
+                int h = t.index(cx + di, cy + dj) & 255;
+                float px = float(cx + di) + detail::kJitterTable[2 * h + 0];
+                float py = float(cy + dj) + detail::kJitterTable[2 * h + 1];
+                float dx = px - x, dy = py - y;
+                float d2 = dx * dx + dy * dy;
+                best = d2 < best ? d2 : best;
+            }
+        }
+        // F1 is in [0, ~1.1]; cell centres high, borders low
+        float f1 = std::sqrt(best);
+        return 1.f - 2.f * (f1 < 1.f ? f1 : 1.f);
+    }
+};
+
+// ===== unrolled fBm ===============================================
+
+template <NoiseType T, int Octaves>
+inline float fbmFixed(const GradientTable &t, float x, float y,
+                      float baseFreq, float lacunarity, float gain)
+{
+    static_assert(Octaves >= 0 && Octaves <= kMaxKernelOctaves, "octave count out of range");
+    float f = baseFreq;
+    float a = 1.f;
+    float h = 0.f;
+    // one fold step per octave, evaluated left to right like the runtime loop
+    [&]<int... I>(std::integer_sequence<int, I...>) {
+        ((h += a * Basis<T>::eval(t, x * f, y * f), f *= lacunarity, a *= gain, (void)I), ...);
+    }(std::make_integer_sequence<int, Octaves>{});
+    return h;
+}
+
+using FbmKernel = float (*)(const GradientTable &, float, float, float, float, float);
+
+namespace detail {
+
+template <NoiseType T, int... O>
+constexpr std::array<FbmKernel, sizeof...(O)> kernelRow(std::integer_sequence<int, O...>) {
+    return {{ &fbmFixed<T, O>... }};
+}
+
+using KernelRow = std::array<FbmKernel, kMaxKernelOctaves + 1>;
+inline constexpr auto kOctaveSeq = std::make_integer_sequence<int, kMaxKernelOctaves + 1>{};
+
+// [type][octaves]
+inline constexpr KernelRow kKernels[int(NoiseType::Count)] = {
+    kernelRow<NoiseType::Perlin>(kOctaveSeq),
+    kernelRow<NoiseType::Simplex>(kOctaveSeq),
+    kernelRow<NoiseType::Value>(kOctaveSeq),
+    kernelRow<NoiseType::Cellular>(kOctaveSeq),
+};
+
+} // namespace detail
+
+// Runtime pick of a compiled instantiation; octaves are clamped to [0, kMaxKernelOctaves].
+inline FbmKernel fbmKernel(NoiseType type, int octaves)
+{
+    int o = octaves < 0 ? 0 : (octaves > kMaxKernelOctaves ? kMaxKernelOctaves : octaves);
+    return detail::kKernels[int(type)][o];
+}
+
+// Same as fbmKernel(type, Octaves)(...), but with the octave count fixed at compile
+// time so only the basis is a runtime choice (used for the 3-octave warp and
+// 4-octave river layers).
+template <int Octaves>
+inline float fbmTyped(NoiseType type, const GradientTable &t, float x, float y,
+                      float baseFreq, float lacunarity, float gain)
+{
+    switch (type) {
+    case NoiseType::Simplex:  return fbmFixed<NoiseType::Simplex,  Octaves>(t, x, y, baseFreq, lacunarity, gain);
+    case NoiseType::Value:    return fbmFixed<NoiseType::Value,    Octaves>(t, x, y, baseFreq, lacunarity, gain);
+    case NoiseType::Cellular: return fbmFixed<NoiseType::Cellular, Octaves>(t, x, y, baseFreq, lacunarity, gain);
+    default:                  return fbmFixed<NoiseType::Perlin,   Octaves>(t, x, y, baseFreq, lacunarity, gain);
+    }
+}
+
+} // namespace Noise
@@ -0,0 +1,72 @@
+#include "terrain_patches.h"
+
+#include <algorithm>
+
+namespace {
+
+using Vertex = TerrainGenerator::TerrainVertex;
+
+// cell of triangle t (centroid), row-major with x as the row
+int cellOf(std::span<const Vertex> v, std::span<const uint32_t> idx, size_t t, int n)
+{
+    const Vertex &a = v[idx[3 * t]], &b = v[idx[3 * t + 1]], &c = v[idx[3 * t + 2]];
+    const float cx = (a.x + b.x + c.x) * (1.f / 3.f);
+    const float cy = (a.y + b.y + c.y) * (1.f / 3.f);
+    const int ix = std::clamp(int(cx * float(n)), 0, n - 1);
+    const int iy = std::clamp(int(cy * float(n)), 0, n - 1);
+    return ix * n + iy;
+}
+
+} // namespace
+
+void TerrainPatches::sortByPatch(TerrainGenerator::TerrainMesh &mesh, int patchesPerSide)
+{
+    const int n = std::max(1, patchesPerSide);
+    const size_t triangles = mesh.indices.size() / 3;
+
+    // counting sort: stable, so triangles keep their order inside a patch
+    std::vector<int> cells(triangles);
+    std::vector<uint32_t> start(size_t(n) * n + 1, 0);
+    for (size_t t = 0; t < triangles; t++) {
+        cells[t] = cellOf(mesh.vertices, mesh.indices, t, n);
+        start[cells[t] + 1]++;
+    }
+    for (size_t i = 1; i < start.size(); i++) start[i] += start[i - 1];
+
+    std::vector<uint32_t> sorted(mesh.indices.size());
+    for (size_t t = 0; t < triangles; t++) {
+        const uint32_t dst = 3 * start[cells[t]]++;
+        std::copy_n(mesh.indices.begin() + 3 * t, 3, sorted.begin() + dst);
+    }
+    mesh.indices.swap(sorted);
+}
+
+std::vector<TerrainPatch> TerrainPatches::build(std::span<const TerrainGenerator::TerrainVertex> vertices,
+                                                std::span<const uint32_t> indices, int patchesPerSide)
+{
+    const int n = std::max(1, patchesPerSide);
+    const size_t triangles = indices.size() / 3;
+
+    std::vector<TerrainPatch> patches;
+    int current = -1;
+    for (size_t t = 0; t < triangles; t++) {
+        const int cell = cellOf(vertices, indices, t, n);
+        if (cell != current) {
+            TerrainPatch p;
+            p.min = glm::vec3(1e30f);
+            p.max = glm::vec3(-1e30f);
+            p.firstIndex = uint32_t(3 * t);
+            p.indexCount = 0;
+            patches.push_back(p);
+            current = cell;
+        }
+        TerrainPatch &p = patches.back();
+        for (int k = 0; k < 3; k++) {
+            const Vertex &v = vertices[indices[3 * t + k]];
+            p.min = glm::min(p.min, glm::vec3(v.x, v.y, v.z));
+            p.max = glm::max(p.max, glm::vec3(v.x, v.y, v.z));
+        }
+        p.indexCount += 3;
+    }
+    return patches;
+}
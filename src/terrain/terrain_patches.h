@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "glm/glm.hpp"
+#include "terraingenerator.h"
+
+// Square patches of a terrain mesh, for per-patch frustum culling.
+//
+// The tile's (0..1)^2 is cut into patchesPerSide^2 cells; each triangle belongs to
+// the cell holding its centroid. Once the indices are sorted by cell, every patch
+// is one contiguous index range, and neighbouring visible patches merge into
+// longer ranges when drawn.
+struct TerrainPatch
+{
+    glm::vec3 min, max;  // local-space bounds of the patch's triangles
+    uint32_t firstIndex; // into the mesh's index buffer
+    uint32_t indexCount;
+};
+
+namespace TerrainPatches {
+
+// Reorders mesh.indices so the triangles of each patch are contiguous, patch by
+// patch in row-major cell order. Triangles keep their winding and, within a
+// patch, their relative order.
+void sortByPatch(TerrainGenerator::TerrainMesh &mesh, int patchesPerSide);
+
+// Patch ranges of an index buffer, one per run of consecutive triangles in the
+// same cell. Sorted indices (sortByPatch) give exactly one range per patch; any
+// order is still correct, just split into more ranges.
+std::vector<TerrainPatch> build(std::span<const TerrainGenerator::TerrainVertex> vertices,
+                                std::span<const uint32_t> indices, int patchesPerSide);
+
+} // namespace TerrainPatches
@@ -0,0 +1,120 @@
+#include "terrain_tiles.h"
+
+#include <algorithm>
+#include "utils/parallel.h"
+
+TerrainTileStreamer::~TerrainTileStreamer()
+{
+    stop();
+}
+
+void TerrainTileStreamer::start(int threads)
+{
+    if (running()) return;
+    if (threads <= 0) threads = std::max(1, ParallelUtils::defaultWorkerCount() - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = false;
+    }
+    m_workers.reserve(threads);
+    for (int i = 0; i < threads; i++) {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+void TerrainTileStreamer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+    for (std::thread &t : m_workers) t.join();
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_busy.clear();
+    m_results.clear();
+}
+
+void TerrainTileStreamer::configure(const TerrainGenerator::TerrainParams &params, int resolution)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_params = params;
+    // droplets stop at the tile edge, so eroded neighbours would not line up
+    m_params.erosionDensity = 0.f;
+    m_resolution = resolution;
+    m_generation++;
+
+    // in-flight tiles notice the generation change and throw their result away
+    m_queue.clear();
+    m_results.clear();
+    m_busy.clear();
+}
+
+void TerrainTileStreamer::request(const std::vector<TileCoord> &wanted)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+        for (const TileCoord &c : wanted) {
+            if (!m_busy.count(c)) m_queue.push_back(c);
+        }
+    }
+    m_cv.notify_all();
+}
+
+bool TerrainTileStreamer::poll(Result &out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_results.empty()) return false;
+    out = std::move(m_results.front());
+    m_results.pop_front();
+    m_busy.erase(out.coord);
+    return true;
+}
+
+int TerrainTileStreamer::outstanding() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return int(m_queue.size() + m_busy.size());
+}
+
+void TerrainTileStreamer::workerLoop()
+{
+    // one generator per worker: tiles run in parallel, so each tile stays serial
+    TerrainGenerator gen;
+    gen.setWorkerCount(1);
+    uint64_t genGeneration = ~uint64_t(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_stop) return;
+
+        TileCoord c = m_queue.front();
+        m_queue.pop_front();
+        m_busy.insert(c);
+
+        const uint64_t generation = m_generation;
+        if (genGeneration != generation) {
+            gen.setParams(m_params);
+            gen.setResolution(m_resolution);
+            genGeneration = generation;
+        }
+
+        lock.unlock();
+        gen.setOrigin(glm::vec2(float(c.x), float(c.y)));
+        Result r;
+        r.coord = c;
+        r.mesh = gen.generateTerrainIndexed();
+        lock.lock();
+
+        // configure() already cleared m_busy for a stale tile
+        if (generation == m_generation && !m_stop) {
+            m_results.push_back(std::move(r));
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "terraingenerator.h"
+
+// Background generation of terrain tiles for an endless world.
+//
+// The world is a grid of unit tiles in noise space; tile (x, y) is what a
+// TerrainGenerator with origin (x, y) produces for its (0..1)^2 tile. Worker threads
+// each own a generator and turn requested coordinates into TerrainMesh data.
+// Nothing here touches OpenGL: the render thread polls finished tiles and uploads
+// them itself, so it decides how much upload work a frame can afford.
+class TerrainTileStreamer
+{
+public:
+    struct TileCoord {
+        int x = 0, y = 0;
+        bool operator==(const TileCoord &o) const { return x == o.x && y == o.y; }
+    };
+    struct TileCoordHash {
+        size_t operator()(const TileCoord &c) const {
+            return (size_t(uint32_t(c.x)) << 32) ^ size_t(uint32_t(c.y));
+        }
+    };
+
+    struct Result {
+        TileCoord coord;
+        TerrainGenerator::TerrainMesh mesh;
+    };
+
+    TerrainTileStreamer() = default;
+    ~TerrainTileStreamer();
+    TerrainTileStreamer(const TerrainTileStreamer &) = delete;
+    TerrainTileStreamer &operator=(const TerrainTileStreamer &) = delete;
+
+    // Starts the worker threads (0 = hardware concurrency - 1, at least one).
+    void start(int threads = 0);
+    // Joins the workers; queued and unfinished tiles are dropped.
+    void stop();
+    bool running() const { return !m_workers.empty(); }
+
+    // New terrain params / tile resolution. Work queued or in flight for the old
+    // configuration is discarded, so no stale tile is ever returned after this call.
+    void configure(const TerrainGenerator::TerrainParams &params, int resolution);
+
+    // Replaces the pending queue. Order is priority (put the nearest tiles first);
+    // tiles already being generated or waiting in the results are skipped.
+    void request(const std::vector<TileCoord> &wanted);
+
+    // Non-blocking: hands over one finished tile, if any.
+    bool poll(Result &out);
+
+    // queued + in flight + finished but not yet polled
+    int outstanding() const;
+
+private:
+    void workerLoop();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+
+    TerrainGenerator::TerrainParams m_params;
+    int m_resolution = 128;
+    uint64_t m_generation = 0; // bumped by configure()
+
+    std::deque<TileCoord> m_queue;
+    std::unordered_set<TileCoord, TileCoordHash> m_busy; // in flight or in m_results
+    std::deque<Result> m_results;
+};
@@ -1,26 +1,32 @@
 #include "terraingenerator.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include "glm/glm.hpp"
+#include "utils/parallel.h"
 
-// helpers: fbm & terrace
-inline float fbm(TerrainGenerator *self,
-                 glm::vec2 p,
-                 int oct,
-                 float baseFreq,
-                 float lac,
-                 float gain)
-{
-    float f = baseFreq;
-    float a = 1.f;
-    float h = 0.f;
-    for (int i = 0; i < oct; i++) {
-        h += a * self->computePerlin(p.x * f, p.y * f);
-        f *= lac;
-        a *= gain;
+// helpers: fBm layer & terrace
+
+// Batch one fBm layer. Perlin runs through the SIMD batch kernel; the other bases
+// go through their compiled instantiation point by point. Both match the scalar path.
+static void fbmLayer(const Noise::GradientTable &t, Noise::NoiseType type,
+                     const float *x, const float *y, float *out, int n,
+                     int oct, float baseFreq, float lac, float gain)
+{
+    if (type == Noise::NoiseType::Perlin) {
+        Noise::fbmBatch(t, x, y, out, n, oct, baseFreq, lac, gain);
+        return;
     }
-    return h;
+    Noise::FbmKernel kernel = Noise::fbmKernel(type, oct);
+    for (int i = 0; i < n; i++) out[i] = kernel(t, x[i], y[i], baseFreq, lac, gain);
+}
+
+// d/dx of glm::smoothstep(e0, e1, x); also valid for e0 > e1
+static inline float smoothstepD(float e0, float e1, float x) {
+    float u = (x - e0) / (e1 - e0);
+    if (u <= 0.f || u >= 1.f) return 0.f;
+    return 6.f * u * (1.f - u) / (e1 - e0);
 }
 
 inline float terrace01(float h01, int steps, float smooth) {
@@ -31,11 +37,44 @@ inline float terrace01(float h01, int steps, float smooth) {
     return (i + ramp) / steps;
 }
 
+// FNV-1a over the raw bytes of each value fed in; keys the heightfield stages
+struct StageKey {
+    uint64_t value = 14695981039346656037ull;
+
+    explicit StageKey(uint64_t upstream = 0) { (*this)(upstream); }
+
+    template <typename T>
+    StageKey &operator()(const T &v) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+        return *this;
+    }
+};
+
 //  public: params
 void TerrainGenerator::setParams(const TerrainParams &p) {
     m_params = p;
 }
 
+uint64_t TerrainGenerator::paramsKey(const TerrainParams &p)
+{
+    StageKey k;
+    k(p.baseNoise)(p.warpNoise)(p.riverNoise);
+    k(p.octaves)(p.baseFreq)(p.lacunarity)(p.gain)(p.heightScale);
+    k(p.warpStrength)(p.cliffSteps)(p.cliffSmooth);
+    k(p.enableRivers)(p.riverFreq)(p.riverSharp)(p.riverThresh)(p.riverDepth);
+    k(p.seaLevel)(p.oceanBias);
+    k(p.valleyWidth)(p.valleyDepth)(p.valleyMeander)(p.lakeRadius)(p.lakeDepth);
+    k(p.enableCraters)(p.craterDensity)(p.craterRadius)(p.craterDepth);
+    k(p.erosionDensity)(p.erosionLifetime)(p.erosionInertia)(p.erosionCapacity);
+    k(p.erosionErode)(p.erosionDeposit)(p.erosionEvaporate)(p.erosionRadius);
+    k(p.seed);
+    return k.value;
+}
+
 // ctor / dtor
 TerrainGenerator::TerrainGenerator()
 {
@@ -43,19 +82,11 @@ TerrainGenerator::TerrainGenerator()
 
     m_resolution = 256;
 
-    m_lookupSize = 1024;
-    m_randVecLookup.reserve(m_lookupSize);
-
-    std::srand(1230);
-    for (int i = 0; i < m_lookupSize; i++) {
-        m_randVecLookup.push_back(glm::vec2(std::rand() * 2.0 / RAND_MAX - 1.0,
-                                            std::rand() * 2.0 / RAND_MAX - 1.0));
-    }
+    Noise::fillRandomTable(m_gradients, 1230);
 }
 
 TerrainGenerator::~TerrainGenerator()
 {
-    m_randVecLookup.clear();
 }
 
 // helper for generateTerrain
@@ -77,14 +108,180 @@ static void addVertex(const glm::vec3 &pos,
     v.push_back(uv.x);  v.push_back(uv.y);  v.push_back(0.f);
 }
 
+// ===== heightfield stage ==========================================
+
+const TerrainGenerator::Heightfield& TerrainGenerator::buildHeightfield()
+{
+    const int res = m_resolution;
+    const int stride = res + 3;
+    const size_t count = size_t(stride) * size_t(stride);
+    const TerrainParams &P = m_params;
+
+    // Stage keys: each hashes the params that stage reads plus its upstream key, so
+    // changing e.g. the crater radius only re-runs the crater stage, and toggling
+    // rivers back on reuses the mask computed the last time they were enabled.
+    const bool warp    = P.warpStrength > 0.f;
+    const bool craters = P.enableCraters && P.craterDensity > 0.f;
+    const uint64_t gridKey = StageKey()(res)(m_origin.x)(m_origin.y).value;
+    const uint64_t warpKey = warp ? StageKey(gridKey)(P.warpStrength)(P.warpNoise).value
+                                  : StageKey(gridKey).value;
+    const uint64_t baseKey = StageKey(warpKey)(P.baseNoise)(P.octaves)(P.baseFreq)
+                                 (P.lacunarity)(P.gain).value;
+    const uint64_t terraceKey = P.cliffSteps > 1 ? StageKey(baseKey)(P.cliffSteps)(P.cliffSmooth).value
+                                                 : StageKey(baseKey).value;
+    const uint64_t riverKey  = StageKey(warpKey)(P.riverNoise)(P.riverFreq)(P.riverSharp)
+                                   (P.riverThresh).value;
+    const uint64_t craterKey = StageKey(warpKey)(P.craterDensity)(P.craterRadius).value;
+
+    auto stale = [count](const Stage &stage, uint64_t key) {
+        return stage.key != key || stage.a.size() != count;
+    };
+    const bool runWarp    = stale(m_warpStage, warpKey);
+    const bool runBase    = stale(m_baseStage, baseKey);
+    const bool runTerrace = stale(m_terraceStage, terraceKey);
+    const bool runRiver   = P.enableRivers && stale(m_riverStage, riverKey);
+    const bool runCrater  = craters && stale(m_craterStage, craterKey);
+
+    if (runWarp)    { m_warpStage.a.resize(count); m_warpStage.b.resize(count); }
+    if (runBase)    m_baseStage.a.resize(count);
+    if (runTerrace) m_terraceStage.a.resize(count);
+    if (runRiver)   m_riverStage.a.resize(count);
+    if (runCrater)  m_craterStage.a.resize(count);
+
+    m_heightfield.resolution = res;
+    m_heightfield.heights.resize(count);
+    float *heights = m_heightfield.heights.data();
+
+    std::vector<float> ys(stride);
+    for (int col = -1; col <= res + 1; col++) ys[col + 1] = m_origin.y + 1.0f * col / res;
+
+    // rows -1..res+1 (apron included) are independent: split them into bands, and
+    // run each stale stage over a whole row so the noise runs across SIMD lanes
+    ParallelUtils::forBands(-1, res + 2, m_workerCount, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; row++) {
+            const size_t o = size_t(row + 1) * stride;
+            float *px = m_warpStage.a.data() + o;
+            float *py = m_warpStage.b.data() + o;
+            if (runWarp) {
+                std::fill(px, px + stride, m_origin.x + 1.0f * row / res);
+                std::copy(ys.begin(), ys.end(), py);
+                warpBatch(px, py, stride);
+            }
+            if (runBase) baseBatch(px, py, m_baseStage.a.data() + o, stride);
+            if (runTerrace) {
+                const float *h = m_baseStage.a.data() + o;
+                float *t = m_terraceStage.a.data() + o;
+                for (int i = 0; i < stride; i++) t[i] = terraceHeight(h[i]);
+            }
+            if (runRiver) {
+                float *r = m_riverStage.a.data() + o;
+                riverBatch(px, py, r, stride);
+                for (int i = 0; i < stride; i++) r[i] = riverMask(r[i]);
+            }
+            if (runCrater) {
+                float *c = m_craterStage.a.data() + o;
+                for (int i = 0; i < stride; i++) c[i] = craterField(glm::vec2(px[i], py[i]));
+            }
+
+            // the remaining stages are a few flops per sample: always recombine
+            const float *t = m_terraceStage.a.data() + o;
+            for (int i = 0; i < stride; i++) {
+                float river  = P.enableRivers ? m_riverStage.a[o + i] : 0.f;
+                float crater = craters ? m_craterStage.a[o + i] : 0.f;
+                heights[o + i] = combineHeight(t[i], river, crater);
+            }
+        }
+    });
+
+    // erosion reads the combined heights of every row, so it runs after the bands.
+    // A fresh job starts whenever anything upstream changed; a finished or
+    // partly run one is reused as is.
+    const bool erode = P.erosionDensity > 0.f;
+    if (erode) {
+        const uint64_t key = erosionKey();
+        if (m_erosion.key() != key) {
+            HydraulicErosion::Params E;
+            E.density   = P.erosionDensity;
+            E.lifetime  = P.erosionLifetime;
+            E.inertia   = P.erosionInertia;
+            E.capacity  = P.erosionCapacity;
+            E.erode     = P.erosionErode;
+            E.deposit   = P.erosionDeposit;
+            E.evaporate = P.erosionEvaporate;
+            E.radius    = P.erosionRadius;
+            E.seed      = uint32_t(P.seed);
+            m_erosion.reset(m_heightfield.heights, res, E, key);
+        }
+        if (!m_incrementalErosion) m_erosion.run(m_workerCount);
+        m_heightfield.heights = m_erosion.heights();
+    }
+
+    // analytic normals for the mesh vertices: one full evaluation per vertex with
+    // derivatives, instead of the 8 cross products getNormal does on the ring.
+    // They describe the uneroded surface, so erosion falls back to the ring.
+    if (m_analyticNormals && analyticNormalsSupported() && !erode) {
+        m_heightfield.normals.resize(size_t(res + 1) * size_t(res + 1));
+        ParallelUtils::forBands(0, res + 1, m_workerCount, [&](int rowBegin, int rowEnd) {
+            for (int row = rowBegin; row < rowEnd; row++) {
+                float x = m_origin.x + 1.0f * row / res;
+                for (int col = 0; col <= res; col++) {
+                    glm::vec3 hd = getHeightD(x, ys[col + 1]);
+                    m_heightfield.normals[size_t(row) * (res + 1) + col] =
+                        glm::normalize(glm::vec3(-hd.y, -hd.z, 1.f));
+                }
+            }
+        });
+    } else {
+        m_heightfield.normals.clear();
+    }
+
+    if (runWarp)    m_warpStage.key = warpKey;
+    if (runBase)    m_baseStage.key = baseKey;
+    if (runTerrace) m_terraceStage.key = terraceKey;
+    if (runRiver)   m_riverStage.key = riverKey;
+    if (runCrater)  m_craterStage.key = craterKey;
+    return m_heightfield;
+}
+
+// every param and the grid: erosion depends on the whole combined heightfield
+uint64_t TerrainGenerator::erosionKey() const
+{
+    return StageKey(paramsKey(m_params))(m_resolution)(m_origin.x)(m_origin.y).value;
+}
+
+bool TerrainGenerator::erosionPending() const
+{
+    return m_params.erosionDensity > 0.f && m_erosion.key() == erosionKey() && !m_erosion.done();
+}
+
+bool TerrainGenerator::stepErosion(int maxDroplets, double budgetMs)
+{
+    if (!erosionPending()) return false;
+    return m_erosion.step(maxDroplets, budgetMs) > 0;
+}
+
 // ===== mesh generation =============================================
 
 std::vector<float> TerrainGenerator::generateTerrain()
 {
+    buildHeightfield();
+
+    // one normal per grid vertex, shared by the (up to) six triangles around it
+    const int n = m_resolution + 1;
+    std::vector<glm::vec3> normals(size_t(n) * n);
+    ParallelUtils::forBands(0, n, m_workerCount, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; row++) {
+            for (int col = 0; col < n; col++) {
+                normals[size_t(row) * n + col] = getNormal(row, col);
+            }
+        }
+    });
+    auto normalAt = [&](int row, int col) { return normals[size_t(row) * n + col]; };
+
     std::vector<float> verts;
     verts.reserve(m_resolution * m_resolution * 6 * 9); // 6 verts * 9 floats
 
-    const float uvScale = 30.0f; // Adjustible: number of times the texture tiled.
+    const float uvScale = kUVScale; // Adjustible: number of times the texture tiled.
 
     for (int x = 0; x < m_resolution; x++) {
         for (int y = 0; y < m_resolution; y++) {
@@ -98,10 +295,10 @@ std::vector<float> TerrainGenerator::generateTerrain()
             glm::vec3 p3 = getPosition(x2, y2);
             glm::vec3 p4 = getPosition(x1, y2);
 
-            glm::vec3 n1 = getNormal(x1, y1);
-            glm::vec3 n2 = getNormal(x2, y1);
-            glm::vec3 n3 = getNormal(x2, y2);
-            glm::vec3 n4 = getNormal(x1, y2);
+            glm::vec3 n1 = normalAt(x1, y1);
+            glm::vec3 n2 = normalAt(x2, y1);
+            glm::vec3 n3 = normalAt(x2, y2);
+            glm::vec3 n4 = normalAt(x1, y2);
 
             // apply uniform UV light over [0,1], then scale up the uvScale and repeat.
             glm::vec2 uv1 = glm::vec2(float(x1) / m_resolution,
@@ -127,23 +324,245 @@ std::vector<float> TerrainGenerator::generateTerrain()
     return verts;
 }
 
+// octahedral normal encoding: unit sphere -> [-1,1]^2 -> snorm16
+static void encodeOctahedral(glm::vec3 n, int16_t &ox, int16_t &oy) {
+    n /= (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.f) {
+        e = (1.f - glm::abs(glm::vec2(e.y, e.x))) *
+            glm::vec2(e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f);
+    }
+    ox = int16_t(lroundf(glm::clamp(e.x, -1.f, 1.f) * 32767.f));
+    oy = int16_t(lroundf(glm::clamp(e.y, -1.f, 1.f) * 32767.f));
+}
+
+TerrainGenerator::TerrainMesh TerrainGenerator::generateTerrainIndexed()
+{
+    buildHeightfield();
+
+    const int n = m_resolution + 1;
+    TerrainMesh mesh;
+    mesh.vertices.resize(size_t(n) * n);
+
+    ParallelUtils::forBands(0, n, m_workerCount, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; row++) {
+            for (int col = 0; col < n; col++) {
+                glm::vec3 p = getPosition(row, col);
+                TerrainVertex &v = mesh.vertices[size_t(row) * n + col];
+                v.x = p.x; v.y = p.y; v.z = p.z;
+                encodeOctahedral(getNormal(row, col), v.octX, v.octY);
+            }
+        }
+    });
+
+    fillGridIndices(m_resolution, mesh.indices);
+    return mesh;
+}
+
+// ===== adaptive mesh (RTIN) ========================================
+//
+// Every triangle of the hierarchy is right isosceles and splits at the midpoint m
+// of its hypotenuse. errors[m] is the largest height error of any triangle split
+// at m or below it, so a triangle is refined iff errors[m] > threshold. The
+// neighbour across the hypotenuse reads the same entry and splits with it, which
+// keeps the cut free of T-junctions. Point (x, y) is grid point (row, col).
+
+namespace {
+
+struct Rtin {
+    int tile;                  // quads per side, power of two
+    int size;                  // points per side
+    std::vector<float> errors; // size^2, indexed like the grid (no apron)
+
+    explicit Rtin(const TerrainGenerator::Heightfield &hf);
+
+    // visits the triangles of the cut at threshold; fn(ax, ay, bx, by, cx, cy),
+    // c being the right angle, returns false to stop the walk
+    template <typename Fn>
+    bool walk(float threshold, Fn &&fn) const {
+        return walk(threshold, 0, 0, tile, tile, tile, 0, fn)
+            && walk(threshold, tile, tile, 0, 0, 0, tile, fn);
+    }
+
+private:
+    template <typename Fn>
+    bool walk(float threshold, int ax, int ay, int bx, int by, int cx, int cy, Fn &fn) const {
+        const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+        if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[size_t(mx) * size + my] > threshold) {
+            return walk(threshold, cx, cy, ax, ay, mx, my, fn)
+                && walk(threshold, bx, by, cx, cy, mx, my, fn);
+        }
+        return fn(ax, ay, bx, by, cx, cy);
+    }
+};
+
+Rtin::Rtin(const TerrainGenerator::Heightfield &hf)
+    : tile(hf.resolution), size(hf.resolution + 1), errors(size_t(size) * size, 0.f)
+{
+    // triangles with a grid point on their hypotenuse, and those whose children have one too
+    const int numTriangles = tile * tile * 2 - 2;
+    const int numParents = numTriangles - tile * tile;
+
+    // heap order: id = i + 2, low bit picks the root, the rest the path down.
+    // Walking it backwards finishes every child before its parent.
+    for (int i = numTriangles - 1; i >= 0; i--) {
+        int id = i + 2;
+        int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+        if (id & 1) { bx = by = cx = tile; }
+        else        { ax = ay = cy = tile; }
+        while ((id >>= 1) > 1) {
+            const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+            if (id & 1) { bx = ax; by = ay; ax = cx; ay = cy; } // left half
+            else        { ax = bx; ay = by; bx = cx; by = cy; } // right half
+            cx = mx; cy = my;
+        }
+
+        const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+        float &e = errors[size_t(mx) * size + my];
+        const float interpolated = 0.5f * (hf.at(ax, ay) + hf.at(bx, by));
+        e = std::max(e, fabsf(interpolated - hf.at(mx, my)));
+        if (i < numParents) {
+            const int lx = (ax + cx) >> 1, ly = (ay + cy) >> 1;
+            const int rx = (bx + cx) >> 1, ry = (by + cy) >> 1;
+            e = std::max({e, errors[size_t(lx) * size + ly], errors[size_t(rx) * size + ry]});
+        }
+    }
+}
+
+} // namespace
+
+TerrainGenerator::TerrainMesh TerrainGenerator::generateTerrainAdaptive(int maxTriangles, float maxError)
+{
+    const int res = m_resolution;
+    if (res < 2 || (res & (res - 1)) != 0) return generateTerrainIndexed();
+
+    buildHeightfield();
+    const Rtin rtin(m_heightfield);
+
+    auto fits = [&](float threshold) {
+        int count = 0;
+        return rtin.walk(threshold, [&](int, int, int, int, int, int) { return ++count <= maxTriangles; });
+    };
+
+    // smallest threshold >= maxError whose cut fits the budget; at the largest
+    // error only the two root triangles are left
+    float threshold = std::max(maxError, 0.f);
+    if (!fits(threshold)) {
+        float lo = threshold;
+        float hi = *std::max_element(rtin.errors.begin(), rtin.errors.end());
+        for (int i = 0; i < 32 && hi - lo > 1e-6f * hi; i++) {
+            const float mid = 0.5f * (lo + hi);
+            (fits(mid) ? hi : lo) = mid;
+        }
+        threshold = hi;
+    }
+
+    TerrainMesh mesh;
+    std::vector<uint32_t> remap(rtin.errors.size(), UINT32_MAX);
+    auto vertex = [&](int row, int col) {
+        uint32_t &slot = remap[size_t(row) * rtin.size + col];
+        if (slot == UINT32_MAX) {
+            slot = uint32_t(mesh.vertices.size());
+            const glm::vec3 p = getPosition(row, col);
+            TerrainVertex v;
+            v.x = p.x; v.y = p.y; v.z = p.z;
+            encodeOctahedral(getNormal(row, col), v.octX, v.octY);
+            mesh.vertices.push_back(v);
+        }
+        return slot;
+    };
+
+    rtin.walk(threshold, [&](int ax, int ay, int bx, int by, int cx, int cy) {
+        // counter-clockwise seen from +z, like the grid's triangles
+        if ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax) < 0) {
+            std::swap(bx, cx);
+            std::swap(by, cy);
+        }
+        mesh.indices.push_back(vertex(ax, ay));
+        mesh.indices.push_back(vertex(bx, by));
+        mesh.indices.push_back(vertex(cx, cy));
+        return true;
+    });
+    return mesh;
+}
+
+TerrainGenerator::TerrainMaps TerrainGenerator::generateTerrainMaps()
+{
+    buildHeightfield();
+
+    const int n = m_resolution + 1;
+    TerrainMaps maps;
+    maps.size = n;
+    maps.heights.resize(size_t(n) * n);
+    maps.normals.resize(size_t(n) * n * 2);
+
+    // texel (s, t) = (col, row): each heightfield row is one texture row
+    ParallelUtils::forBands(0, n, m_workerCount, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; row++) {
+            for (int col = 0; col < n; col++) {
+                size_t i = size_t(row) * n + col;
+                maps.heights[i] = m_heightfield.at(row, col);
+                encodeOctahedral(getNormal(row, col), maps.normals[2 * i], maps.normals[2 * i + 1]);
+            }
+        }
+    });
+    return maps;
+}
+
+TerrainGenerator::TerrainMesh TerrainGenerator::flatGrid(int resolution)
+{
+    const int n = resolution + 1;
+    TerrainMesh mesh;
+    mesh.vertices.resize(size_t(n) * n);
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            TerrainVertex &v = mesh.vertices[size_t(row) * n + col];
+            v.x = 1.0f * row / resolution;
+            v.y = 1.0f * col / resolution;
+            v.z = 0.f;
+            v.octX = v.octY = 0;
+        }
+    }
+    fillGridIndices(resolution, mesh.indices);
+    return mesh;
+}
+
+// 6 indices per quad over a row-major (res + 1)^2 vertex grid
+void TerrainGenerator::fillGridIndices(int res, std::vector<uint32_t> &indices)
+{
+    const int n = res + 1;
+    indices.resize(size_t(res) * res * 6);
+    for (int x = 0; x < res; x++) {
+        uint32_t *dst = indices.data() + size_t(x) * res * 6;
+        for (int y = 0; y < res; y++) {
+            uint32_t i1 = uint32_t(x * n + y);       // (x,   y)
+            uint32_t i2 = uint32_t((x + 1) * n + y); // (x+1, y)
+            uint32_t i3 = i2 + 1;                    // (x+1, y+1)
+            uint32_t i4 = i1 + 1;                    // (x,   y+1)
+
+            // tri 1: p1 p2 p3, tri 2: p1 p3 p4
+            *dst++ = i1; *dst++ = i2; *dst++ = i3;
+            *dst++ = i1; *dst++ = i3; *dst++ = i4;
+        }
+    }
+}
+
 // ===== random gradient lookup =====================================
 
-glm::vec2 TerrainGenerator::sampleRandomVector(int row, int col)
+glm::vec2 TerrainGenerator::sampleRandomVector(int row, int col) const
 {
-    std::hash<int> intHash;
-    int index = intHash(row * 41 + col * 43) % m_lookupSize;
-    return m_randVecLookup.at(index);
+    int index = m_gradients.index(row, col);
+    return glm::vec2(m_gradients.gx[index], m_gradients.gy[index]);
 }
 
 // ===== position / height / normal / color ==========================
 
-glm::vec3 TerrainGenerator::getPosition(int row, int col)
+glm::vec3 TerrainGenerator::getPosition(int row, int col) const
 {
     float x = 1.0f * row / m_resolution;
     float y = 1.0f * col / m_resolution;
 
-    float z = getHeight(x, y);     // world-space height
+    float z = m_heightfield.at(row, col); // world-space height
     // float sea = m_params.seaLevel * m_params.heightScale;
 
     // // flatten water
@@ -152,16 +571,7 @@ glm::vec3 TerrainGenerator::getPosition(int row, int col)
     return glm::vec3(x, y, z);
 }
 
-static inline float smoothstep3(float t) {
-    t = glm::clamp(t, 0.f, 1.f);
-    return t * t * (3.f - 2.f * t); // 3t^2 - 2t^3
-}
-
-static inline float interp(float A, float B, float alpha) {
-    return A + smoothstep3(alpha) * (B - A);
-}
-
-float TerrainGenerator::getHeight(float x, float y)
+float TerrainGenerator::getHeight(float x, float y) const
 {
     // sample noise on [0,1]^2
     glm::vec2 p(x, y);
@@ -169,47 +579,94 @@ float TerrainGenerator::getHeight(float x, float y)
     // 1) domain warping
     if (m_params.warpStrength > 0.f) {
         glm::vec2 w;
-        w.x = fbm(this, p * 2.0f + glm::vec2(13.2f, 7.1f), 3, 1.0f, 2.0f, 0.5f);
-        w.y = fbm(this, p * 2.0f + glm::vec2(-9.7f, 5.4f), 3, 1.0f, 2.0f, 0.5f);
+        glm::vec2 qx = p * 2.0f + glm::vec2(13.2f, 7.1f);
+        glm::vec2 qy = p * 2.0f + glm::vec2(-9.7f, 5.4f);
+        w.x = Noise::fbmTyped<3>(m_params.warpNoise, m_gradients, qx.x, qx.y, 1.0f, 2.0f, 0.5f);
+        w.y = Noise::fbmTyped<3>(m_params.warpNoise, m_gradients, qy.x, qy.y, 1.0f, 2.0f, 0.5f);
         p  += m_params.warpStrength * w;
     }
 
     // 2) basic fBm mountain
-    float h = fbm(this, p,
-                  m_params.octaves,
-                  m_params.baseFreq,
-                  m_params.lacunarity,
-                  m_params.gain);
+    float h = Noise::fbmKernel(m_params.baseNoise, m_params.octaves)(
+        m_gradients, p.x, p.y, m_params.baseFreq, m_params.lacunarity, m_params.gain);
+
+    // ridged river noise is sampled at the warped point too
+    float r = 0.f;
+    if (m_params.enableRivers) {
+        glm::vec2 q = p * m_params.riverFreq;
+        r = Noise::fbmTyped<4>(m_params.riverNoise, m_gradients, q.x, q.y, 1.0f, 2.0f, 0.5f);
+    }
+
+    return finishHeight(p, h, r);
+}
+
+bool TerrainGenerator::analyticNormalsSupported() const
+{
+    return m_params.baseNoise == Noise::NoiseType::Perlin &&
+           m_params.warpNoise == Noise::NoiseType::Perlin &&
+           m_params.riverNoise == Noise::NoiseType::Perlin;
+}
+
+// getHeight with the chain rule carried through every stage. Values are computed
+// with the same expressions as getHeight, so the height part is identical.
+glm::vec3 TerrainGenerator::getHeightD(float x, float y) const
+{
+    glm::vec2 p(x, y);
+
+    // 1) domain warping; J = d(warped p) / d(x, y), column k = d/d(x, y)[k]
+    glm::mat2 J(1.f);
+    if (m_params.warpStrength > 0.f) {
+        const float s = m_params.warpStrength;
+        glm::vec2 qx = p * 2.0f + glm::vec2(13.2f, 7.1f);
+        glm::vec2 qy = p * 2.0f + glm::vec2(-9.7f, 5.4f);
+        Noise::NoiseD wx = Noise::fbmD(m_gradients, qx.x, qx.y, 3, 1.0f, 2.0f, 0.5f);
+        Noise::NoiseD wy = Noise::fbmD(m_gradients, qy.x, qy.y, 3, 1.0f, 2.0f, 0.5f);
+        p += s * glm::vec2(wx.v, wy.v);
+        // dq/dp = 2 for both warp lookups
+        J = glm::mat2(1.f + 2.f * s * wx.dx, 2.f * s * wy.dx,
+                      2.f * s * wx.dy,       1.f + 2.f * s * wy.dy);
+    }
+    // gradient w.r.t. the warped point -> gradient w.r.t. (x, y)
+    const glm::mat2 Jt = glm::transpose(J);
+
+    // 2) basic fBm mountain
+    Noise::NoiseD b = Noise::fbmD(m_gradients, p.x, p.y,
+                                  std::min(m_params.octaves, Noise::kMaxKernelOctaves),
+                                  m_params.baseFreq, m_params.lacunarity, m_params.gain);
+    glm::vec2 grad = Jt * glm::vec2(b.dx, b.dy);
 
-    // 3) cliff (stairs)
+    // 3) terrace: h01 and back are affine with slopes 0.5 and 2, so only the ramp remains
+    float h = terraceHeight(b.v);
     if (m_params.cliffSteps > 1) {
-        float h01 = 0.5f * (h + 1.0f);
-        h01 = terrace01(h01, m_params.cliffSteps, m_params.cliffSmooth);
-        h   = h01 * 2.0f - 1.0f;
+        float x01 = 0.5f * (b.v + 1.0f) * m_params.cliffSteps;
+        float f = x01 - floorf(x01);
+        grad *= smoothstepD(0.5f - m_params.cliffSmooth, 0.5f + m_params.cliffSmooth, f);
     }
 
-    // 4) rivers: ridged noise for "bottom valley"
+    // 4) rivers
+    float river = 0.f;
+    glm::vec2 riverGrad(0.f);
     if (m_params.enableRivers) {
-        // ridged noise: the closer to 0, the higher the ridge value.
-        float r = fbm(this, p * m_params.riverFreq, 4, 1.0f, 2.0f, 0.5f);
-        float ridged = powf(1.f - fabsf(r), m_params.riverSharp);
+        glm::vec2 q = p * m_params.riverFreq;
+        Noise::NoiseD r = Noise::fbmD(m_gradients, q.x, q.y, 4, 1.0f, 2.0f, 0.5f);
+        river = riverMask(r.v);
 
-        // width half-width of the river channel;
         const float width = 0.02f;
-
-        float t0 = m_params.riverThresh + width;   // upper threshold: begins to turn into a river
-        float t1 = m_params.riverThresh;           // lower threshold: River center
-        float mask = glm::smoothstep(t0, t1, ridged);
-
-        h -= m_params.riverDepth * mask;          // digging valley
+        float a = 1.f - fabsf(r.v);
+        float ridged = powf(a, m_params.riverSharp);
+        float dRidged = -m_params.riverSharp * powf(a, m_params.riverSharp - 1.f) * (r.v < 0.f ? -1.f : 1.f);
+        float dMask = smoothstepD(m_params.riverThresh + width, m_params.riverThresh, ridged) * dRidged;
+        riverGrad = Jt * (dMask * m_params.riverFreq * glm::vec2(r.dx, r.dy));
     }
 
-    // 5) craters
+    // 5) craters: gradient of the deepest bowl
+    float crater = 0.f;
+    glm::vec2 craterGrad(0.f);
     if (m_params.enableCraters && m_params.craterDensity > 0.f) {
-        glm::vec2 g = p * m_params.craterDensity;
-        glm::ivec2 cell = glm::floor(g);
-        float crater = 0.f;
+        crater = craterField(p);
 
+        glm::ivec2 cell = glm::floor(p * m_params.craterDensity);
+        float best = 0.f;
         for (int dj = -1; dj <= 1; ++dj) {
             for (int di = -1; di <= 1; ++di) {
                 glm::ivec2 C = cell + glm::ivec2(di, dj);
@@ -222,9 +679,163 @@ float TerrainGenerator::getHeight(float x, float y)
                 float dist = glm::length(d);
                 float fall = glm::smoothstep(R, 0.0f, dist);
                 float bowl = fall * (1.0f - dist / (R + 1e-6f));
-                crater = std::max(crater, bowl);
+                if (bowl > best && dist > 0.f) {
+                    best = bowl;
+                    float dBowl = smoothstepD(R, 0.0f, dist) * (1.0f - dist / (R + 1e-6f)) -
+                                  fall / (R + 1e-6f);
+                    craterGrad = Jt * (dBowl * d / dist);
+                }
             }
         }
+    }
+
+    // 6-7) same combination as combineHeight
+    glm::vec2 total = grad;
+    if (m_params.enableRivers) total -= m_params.riverDepth * riverGrad;
+    if (m_params.enableCraters && m_params.craterDensity > 0.f) total -= m_params.craterDepth * craterGrad;
+    total *= m_params.heightScale;
+
+    return glm::vec3(combineHeight(h, river, crater), total);
+}
+
+void TerrainGenerator::heightBatch(const float *xs, const float *ys, float *out, int n) const
+{
+    // same stages as getHeight, but the three fBm evaluations run over whole
+    // chunks at a time; the per-point tail is shared through finishHeight
+    constexpr int kChunk = 64;
+    alignas(32) float px[kChunk], py[kChunk];
+    alignas(32) float h[kChunk], r[kChunk];
+
+    for (int base = 0; base < n; base += kChunk) {
+        const int m = std::min(kChunk, n - base);
+        for (int i = 0; i < m; i++) { px[i] = xs[base + i]; py[i] = ys[base + i]; }
+
+        warpBatch(px, py, m);
+        baseBatch(px, py, h, m);
+        if (m_params.enableRivers) riverBatch(px, py, r, m);
+
+        for (int i = 0; i < m; i++) {
+            const bool rivers = m_params.enableRivers;
+            out[base + i] = finishHeight(glm::vec2(px[i], py[i]), h[i], rivers ? r[i] : 0.f);
+        }
+    }
+}
+
+// ===== height stages ================================================
+// heightBatch and the cached buildHeightfield run the same stage functions, so
+// both stay bit-identical to getHeight.
+
+// 1) domain warping, in place
+void TerrainGenerator::warpBatch(float *px, float *py, int n) const
+{
+    if (m_params.warpStrength <= 0.f) return;
+
+    constexpr int kChunk = 64;
+    alignas(32) float qx[kChunk], qy[kChunk];
+    alignas(32) float wx[kChunk], wy[kChunk];
+
+    for (int base = 0; base < n; base += kChunk) {
+        const int m = std::min(kChunk, n - base);
+        float *x = px + base, *y = py + base;
+
+        for (int i = 0; i < m; i++) {
+            glm::vec2 q = glm::vec2(x[i], y[i]) * 2.0f + glm::vec2(13.2f, 7.1f);
+            qx[i] = q.x; qy[i] = q.y;
+        }
+        fbmLayer(m_gradients, m_params.warpNoise, qx, qy, wx, m, 3, 1.0f, 2.0f, 0.5f);
+        for (int i = 0; i < m; i++) {
+            glm::vec2 q = glm::vec2(x[i], y[i]) * 2.0f + glm::vec2(-9.7f, 5.4f);
+            qx[i] = q.x; qy[i] = q.y;
+        }
+        fbmLayer(m_gradients, m_params.warpNoise, qx, qy, wy, m, 3, 1.0f, 2.0f, 0.5f);
+        for (int i = 0; i < m; i++) {
+            glm::vec2 p = glm::vec2(x[i], y[i]) + m_params.warpStrength * glm::vec2(wx[i], wy[i]);
+            x[i] = p.x; y[i] = p.y;
+        }
+    }
+}
+
+// 2) basic fBm mountain at the warped points
+void TerrainGenerator::baseBatch(const float *px, const float *py, float *h, int n) const
+{
+    fbmLayer(m_gradients, m_params.baseNoise, px, py, h, n,
+             std::min(m_params.octaves, Noise::kMaxKernelOctaves), m_params.baseFreq,
+             m_params.lacunarity, m_params.gain);
+}
+
+// ridged river noise at the warped points
+void TerrainGenerator::riverBatch(const float *px, const float *py, float *r, int n) const
+{
+    constexpr int kChunk = 64;
+    alignas(32) float qx[kChunk], qy[kChunk];
+
+    for (int base = 0; base < n; base += kChunk) {
+        const int m = std::min(kChunk, n - base);
+        for (int i = 0; i < m; i++) {
+            qx[i] = px[base + i] * m_params.riverFreq;
+            qy[i] = py[base + i] * m_params.riverFreq;
+        }
+        fbmLayer(m_gradients, m_params.riverNoise, qx, qy, r + base, m, 4, 1.0f, 2.0f, 0.5f);
+    }
+}
+
+// 3) cliff (stairs)
+float TerrainGenerator::terraceHeight(float h) const
+{
+    if (m_params.cliffSteps > 1) {
+        float h01 = 0.5f * (h + 1.0f);
+        h01 = terrace01(h01, m_params.cliffSteps, m_params.cliffSmooth);
+        h   = h01 * 2.0f - 1.0f;
+    }
+    return h;
+}
+
+// 4) rivers: ridged noise for "bottom valley", 1 at the river centre
+float TerrainGenerator::riverMask(float r) const
+{
+    // ridged noise: the closer to 0, the higher the ridge value.
+    float ridged = powf(1.f - fabsf(r), m_params.riverSharp);
+
+    // width half-width of the river channel;
+    const float width = 0.02f;
+
+    float t0 = m_params.riverThresh + width;   // upper threshold: begins to turn into a river
+    float t1 = m_params.riverThresh;           // lower threshold: River center
+    return glm::smoothstep(t0, t1, ridged);
+}
+
+// 5) craters: deepest bowl around p, 0..1
+float TerrainGenerator::craterField(glm::vec2 p) const
+{
+    glm::vec2 g = p * m_params.craterDensity;
+    glm::ivec2 cell = glm::floor(g);
+    float crater = 0.f;
+
+    for (int dj = -1; dj <= 1; ++dj) {
+        for (int di = -1; di <= 1; ++di) {
+            glm::ivec2 C = cell + glm::ivec2(di, dj);
+            glm::vec2 rnd = 0.5f + 0.5f * sampleRandomVector(C.x, C.y);
+            glm::vec2 center = (glm::vec2(C) + rnd) / m_params.craterDensity;
+
+            glm::vec2 d = p - center;
+            float R = m_params.craterRadius * (0.6f + 0.8f *
+                                                          (0.5f + 0.5f * sampleRandomVector(C.x + 73, C.y - 41).x));
+            float dist = glm::length(d);
+            float fall = glm::smoothstep(R, 0.0f, dist);
+            float bowl = fall * (1.0f - dist / (R + 1e-6f));
+            crater = std::max(crater, bowl);
+        }
+    }
+    return crater;
+}
+
+// stages 4..7 applied to the terraced height; river/crater are ignored when disabled
+float TerrainGenerator::combineHeight(float h, float river, float crater) const
+{
+    if (m_params.enableRivers) {
+        h -= m_params.riverDepth * river;         // digging valley
+    }
+    if (m_params.enableCraters && m_params.craterDensity > 0.f) {
         h -= m_params.craterDepth * crater;
     }
 
@@ -235,10 +846,19 @@ float TerrainGenerator::getHeight(float x, float y)
     return h * m_params.heightScale;
 }
 
+// stages 3..7 of getHeight: p is the warped point, h the base fBm, r the river fBm
+float TerrainGenerator::finishHeight(glm::vec2 p, float h, float r) const
+{
+    const bool craters = m_params.enableCraters && m_params.craterDensity > 0.f;
+    return combineHeight(terraceHeight(h),
+                         m_params.enableRivers ? riverMask(r) : 0.f,
+                         craters ? craterField(p) : 0.f);
+}
+
 // returns a height approximately in the [0,1] range, used for logic such as planting trees/sea level.
 float TerrainGenerator::sampleHeight01(float x, float y) const {
     // note: getHeight is multiplied by heightScale
-    float z = const_cast<TerrainGenerator*>(this)->getHeight(x, y);
+    float z = getHeight(m_origin.x + x, m_origin.y + y);
 
     // raises the area below sea level to seaLevel.
     float sea = m_params.seaLevel * m_params.heightScale;
@@ -249,7 +869,7 @@ float TerrainGenerator::sampleHeight01(float x, float y) const {
 
 // return a surface point on the local (0..1)^2, z will be clamped by the sea level.
 glm::vec3 TerrainGenerator::sampleSurfacePos(float x, float y) const {
-    float h = const_cast<TerrainGenerator*>(this)->getHeight(x, y);
+    float h = getHeight(m_origin.x + x, m_origin.y + y);
 
     float sea = m_params.seaLevel * m_params.heightScale;
     if (h < sea) h = sea;
@@ -257,9 +877,11 @@ glm::vec3 TerrainGenerator::sampleSurfacePos(float x, float y) const {
     return glm::vec3(x, y, h);
 }
 
-// normal from neighbor ring
-glm::vec3 TerrainGenerator::getNormal(int row, int col)
+// normal from neighbor ring (rows/cols -1 and res+1 come from the apron)
+glm::vec3 TerrainGenerator::getNormal(int row, int col) const
 {
+    if (!m_heightfield.normals.empty()) return m_heightfield.normalAt(row, col);
+
     glm::vec3 normal(0.f);
 
     static const int OFF[8][2] = {
@@ -331,32 +953,7 @@ glm::vec3 TerrainGenerator::getColor(glm::vec3 normal, glm::vec3 position)
 
 // ===== Perlin =====================================================
 
-float TerrainGenerator::computePerlin(float x, float y)
+float TerrainGenerator::computePerlin(float x, float y) const
 {
-    int x0 = static_cast<int>(floorf(x));
-    int y0 = static_cast<int>(floorf(y));
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
-
-    glm::vec2 dTL(x - x0, y - y1);
-    glm::vec2 dTR(x - x1, y - y1);
-    glm::vec2 dBR(x - x1, y - y0);
-    glm::vec2 dBL(x - x0, y - y0);
-
-    glm::vec2 gTL = sampleRandomVector(x0, y1);
-    glm::vec2 gTR = sampleRandomVector(x1, y1);
-    glm::vec2 gBR = sampleRandomVector(x1, y0);
-    glm::vec2 gBL = sampleRandomVector(x0, y0);
-
-    float A = glm::dot(gTL, dTL);
-    float B = glm::dot(gTR, dTR);
-    float C = glm::dot(gBR, dBR);
-    float D = glm::dot(gBL, dBL);
-
-    float u = x - static_cast<float>(x0);
-    float v = y - static_cast<float>(y0);
-
-    float bottom = interp(D, C, u);
-    float top    = interp(A, B, u);
-    return interp(bottom, top, v);
+    return Noise::perlin(m_gradients, x, y);
 }
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include "glm/glm.hpp"
+#include "noise.h"
+#include "noise_kernels.h"
+#include "erosion.h"
 
 class TerrainGenerator
 {
@@ -11,12 +15,114 @@ public:
     TerrainGenerator();
     ~TerrainGenerator();
 
+    // number of times the ground textures repeat across the [0,1]^2 tile
+    static constexpr float kUVScale = 30.0f;
+
     int getResolution() { return m_resolution; }
+    void setResolution(int res) { m_resolution = res; }
+
+    // Noise-space offset of this generator's (0..1)^2 tile. Tile (i, j) of an endless
+    // world uses origin (i, j); neighbouring tiles then sample identical edge heights.
+    void setOrigin(glm::vec2 origin) { m_origin = origin; }
+    glm::vec2 origin() const { return m_origin; }
+
+    // Row-band parallelism for the heightfield/mesh stages.
+    // 0 = hardware concurrency, 1 = serial. Output is bit-identical for any count.
+    void setWorkerCount(int workers) { m_workerCount = workers; }
+    int  workerCount() const { return m_workerCount; }
     std::vector<float> generateTerrain();
 
+    // Packed vertex of the indexed terrain path (16 bytes).
+    // UVs are not stored: terrain.vert derives them from x/y * kUVScale.
+    struct TerrainVertex {
+        float   x, y, z;    // local position on the (0..1)^2 tile
+        int16_t octX, octY; // octahedral-encoded normal, snorm16
+    };
+
+    // One vertex per grid point, 6 indices per quad (same winding as generateTerrain).
+    struct TerrainMesh {
+        std::vector<TerrainVertex> vertices; // (resolution + 1)^2, row-major
+        std::vector<uint32_t>      indices;  // narrowed to 16 bit on upload when possible
+    };
+    TerrainMesh generateTerrainIndexed();
+
+    // Adaptive version of generateTerrainIndexed (right-triangulated irregular
+    // network over the same heightfield): flat ground collapses into large
+    // triangles while cliffs, crater rims and river banks keep full detail.
+    // Refines until no triangle deviates more than maxError (local z units) from
+    // the grid, raising that bound as far as needed to stay at or under
+    // maxTriangles. Vertices and normals are the grid's; the result is crack-free.
+    // Needs a power-of-two resolution, otherwise returns the full grid.
+    TerrainMesh generateTerrainAdaptive(int maxTriangles, float maxError = 0.f);
+
+    // GPU displacement path: the same per-vertex heights and normals as
+    // generateTerrainIndexed, laid out as texture data for a static grid.
+    struct TerrainMaps {
+        int size = 0;                 // texels per side (resolution + 1)
+        std::vector<float>   heights; // size^2, texel (s, t) = (col, row)
+        std::vector<int16_t> normals; // size^2 * 2, octahedral snorm16 like TerrainVertex
+    };
+    TerrainMaps generateTerrainMaps();
+
+    // Flat (z = 0, no normal) grid with generateTerrainIndexed's layout and winding;
+    // terrain.vert displaces it from TerrainMaps.
+    static TerrainMesh flatGrid(int resolution);
+
+    // Cached heightfield: getHeight evaluated once per grid vertex.
+    // Stored row-major (row = x index) with a one-sample apron on every side,
+    // so the normal ring of a border vertex never falls back to getHeight.
+    struct Heightfield {
+        int resolution = 0;         // quads per side
+        std::vector<float> heights; // (resolution + 3)^2 samples
+        // analytic normals, (resolution + 1)^2 row-major, no apron; empty unless
+        // analytic normals are enabled (see setAnalyticNormals)
+        std::vector<glm::vec3> normals;
+
+        int stride() const { return resolution + 3; }
+        float at(int row, int col) const {
+            return heights[size_t(row + 1) * stride() + size_t(col + 1)];
+        }
+        const glm::vec3 &normalAt(int row, int col) const {
+            return normals[size_t(row) * (resolution + 1) + size_t(col)];
+        }
+    };
+
+    // Normals from analytic noise derivatives, chained through the warp, terrace,
+    // river and crater stages, instead of the cross products over the neighbour
+    // ring. Exact (no grid smoothing), and independent of neighbouring samples.
+    // Only available when every layer uses Perlin noise; otherwise, or when off
+    // (the default), normals come from the heightfield ring.
+    void setAnalyticNormals(bool on) { m_analyticNormals = on; }
+    bool analyticNormals() const { return m_analyticNormals; }
+    bool analyticNormalsSupported() const;
+
+    // Re-evaluates the height stage for the current params. The warp, base fBm,
+    // terrace, river and crater fields are cached per stage, so only the stages
+    // whose params (or upstream stages) changed since the last call are recomputed.
+    // Erosion (erosionDensity > 0) runs last and is cached the same way.
+    const Heightfield& buildHeightfield();
+
+    // Incremental erosion: buildHeightfield starts the erosion job instead of
+    // finishing it, and returns its current state (uneroded at first). Advance the
+    // job with stepErosion and rebuild to pick up its progress; the end result is
+    // identical to the blocking run. Off by default.
+    void setIncrementalErosion(bool on) { m_incrementalErosion = on; }
+    // the job for the current params is started but not finished
+    bool erosionPending() const;
+    float erosionProgress() const { return m_erosion.progress(); }
+    // runs up to maxDroplets on the calling thread, or until budgetMs is spent;
+    // returns whether any ran
+    bool stepErosion(int maxDroplets, double budgetMs);
+    const Heightfield& heightfield() const { return m_heightfield; }
+
     struct TerrainParams {
+        // noise basis per layer (see noise_kernels.h); Perlin everywhere is the original look
+        Noise::NoiseType baseNoise  = Noise::NoiseType::Perlin;
+        Noise::NoiseType warpNoise  = Noise::NoiseType::Perlin;
+        Noise::NoiseType riverNoise = Noise::NoiseType::Perlin;
+
         // base fBm
-        int   octaves      = 4;
+        int   octaves      = 4;      // 0..Noise::kMaxKernelOctaves
         float baseFreq     = 1.0f;
         float lacunarity   = 2.0f;
         float gain         = 0.5f;
@@ -57,28 +163,81 @@ public:
         float craterRadius  = 0.06f; // normalized radius
         float craterDepth   = 0.25f;
 
+        // hydraulic erosion: droplets run over the finished heightfield (see erosion.h).
+        // Grid only: sampleHeight01 / sampleSurfacePos still follow the uneroded noise.
+        float erosionDensity   = 0.0f;  // droplets per grid cell, 0 = off
+        int   erosionLifetime  = 48;    // max steps (cells) per droplet
+        float erosionInertia   = 0.05f; // 0..1
+        float erosionCapacity  = 4.0f;
+        float erosionErode     = 0.3f;
+        float erosionDeposit   = 0.3f;
+        float erosionEvaporate = 0.02f;
+        int   erosionRadius    = 2;     // brush radius in cells
+
         int   seed = 1230;
     };
 
     void setParams(const TerrainParams& p);
 
+    // Hash over every field of p; equal keys generate identical terrain.
+    static uint64_t paramsKey(const TerrainParams& p);
+
+    // The sampling API below is const and touches no mutable state, so it may be
+    // called from several threads at once (as long as setParams is not running).
+
     float sampleHeight01(float x, float y) const;
 
     glm::vec3 sampleSurfacePos(float x, float y) const;
 
+    // Batched height stage: out[i] = height at (xs[i], ys[i]), world-scaled like
+    // getHeight. Bit-identical to calling getHeight per point.
+    void heightBatch(const float *xs, const float *ys, float *out, int n) const;
+
     // Perlin noise
-    float computePerlin(float x, float y);
+    float computePerlin(float x, float y) const;
 
 private:
-    std::vector<glm::vec2> m_randVecLookup;
+    Noise::GradientTable m_gradients;
     int m_resolution;
-    int m_lookupSize;
+    int m_workerCount = 0;
+    bool m_analyticNormals = false;
+    glm::vec2 m_origin = glm::vec2(0.f);
 
     TerrainParams m_params;
+    Heightfield   m_heightfield;
 
-    glm::vec2 sampleRandomVector(int row, int col);
-    glm::vec3 getPosition(int row, int col);
-    float     getHeight(float x, float y);
-    glm::vec3 getNormal(int row, int col);
+    // buildHeightfield stage caches, laid out like Heightfield (apron included).
+    // key hashes the params the stage read plus its upstream stage's key.
+    struct Stage {
+        uint64_t key = 0;
+        std::vector<float> a, b; // b is only used by the warp stage (warped y)
+    };
+    Stage m_warpStage;    // warped sample points
+    Stage m_baseStage;    // base fBm
+    Stage m_terraceStage; // terraced base fBm
+    Stage m_riverStage;   // river mask, before riverDepth
+    Stage m_craterStage;  // crater bowls, before craterDepth
+    HydraulicErosion m_erosion; // erosion job on the combined heights; its key works like a stage's
+    bool m_incrementalErosion = false;
+
+    uint64_t  erosionKey() const;
+    glm::vec2 sampleRandomVector(int row, int col) const;
+    static void fillGridIndices(int res, std::vector<uint32_t> &indices);
+    float     getHeight(float x, float y) const;
+    // (height, dh/dx, dh/dy) in one evaluation; height matches getHeight.
+    // Requires analyticNormalsSupported().
+    glm::vec3 getHeightD(float x, float y) const;
+    float     finishHeight(glm::vec2 p, float h, float r) const;
+    // individual height stages (see getHeight for the order)
+    void      warpBatch(float *px, float *py, int n) const;
+    void      baseBatch(const float *px, const float *py, float *h, int n) const;
+    void      riverBatch(const float *px, const float *py, float *r, int n) const;
+    float     terraceHeight(float h) const;
+    float     riverMask(float r) const;
+    float     craterField(glm::vec2 p) const;
+    float     combineHeight(float h, float river, float crater) const;
+    // grid lookups below read m_heightfield, call buildHeightfield() first
+    glm::vec3 getPosition(int row, int col) const;
+    glm::vec3 getNormal(int row, int col) const;
     glm::vec3 getColor(glm::vec3 normal, glm::vec3 position);
 };
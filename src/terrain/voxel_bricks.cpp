@@ -0,0 +1,196 @@
+#include "voxel_bricks.h"
+#include <algorithm>
+
+void VoxelBricks::reset(int sx, int sy, int sz){
+    m_sx = sx; m_sy = sy; m_sz = sz;
+    m_gx = (sx + kNode - 1) / kNode;
+    m_gy = (sy + kNode - 1) / kNode;
+    m_gz = (sz + kNode - 1) / kNode;
+    m_nodes.assign(size_t(m_gx) * m_gy * m_gz, kUniform);
+    m_bricks.clear();
+    m_cells.clear();
+    m_freeBricks.clear();
+    m_freeCells.clear();
+    m_touched.clear();
+}
+
+void VoxelBricks::clip(glm::ivec3 o, int n, glm::ivec3& lo, glm::ivec3& hi) const{
+    lo = o;
+    hi = glm::min(o + (n - 1), glm::ivec3(m_sx, m_sy, m_sz) - 1);
+}
+
+uint32_t VoxelBricks::allocBricks(uint8_t material){
+    uint32_t block;
+    if (!m_freeBricks.empty()) { block = m_freeBricks.back(); m_freeBricks.pop_back(); }
+    else { block = uint32_t(m_bricks.size() / kPer); m_bricks.resize(m_bricks.size() + kPer); }
+    std::fill_n(m_bricks.begin() + size_t(block) * kPer, kPer, kUniform | material);
+    return block;
+}
+
+uint32_t VoxelBricks::allocCells(uint8_t material){
+    uint32_t block;
+    if (!m_freeCells.empty()) { block = m_freeCells.back(); m_freeCells.pop_back(); }
+    else { block = uint32_t(m_cells.size() / kPer); m_cells.resize(m_cells.size() + kPer); }
+    std::fill_n(m_cells.begin() + size_t(block) * kPer, kPer, material);
+    return block;
+}
+
+void VoxelBricks::freeBricks(uint32_t block){
+    for (int k=0;k<kPer;k++){
+        const uint32_t ref = m_bricks[size_t(block) * kPer + k];
+        if (!uniform(ref)) m_freeCells.push_back(ref);
+    }
+    m_freeBricks.push_back(block);
+}
+
+void VoxelBricks::fill(glm::ivec3 lo, glm::ivec3 hi, uint8_t material){
+    const glm::ivec3 n0 = lo / kNode, n1 = hi / kNode;
+    for (int nx=n0.x;nx<=n1.x;nx++) for (int ny=n0.y;ny<=n1.y;ny++) for (int nz=n0.z;nz<=n1.z;nz++){
+        const glm::ivec3 o = glm::ivec3(nx, ny, nz) * kNode;
+        glm::ivec3 clo, chi;
+        clip(o, kNode, clo, chi);
+        uint32_t& ref = m_nodes[node(nx, ny, nz)];
+        if (glm::all(glm::lessThanEqual(lo, clo)) && glm::all(glm::greaterThanEqual(hi, chi))) {
+            if (!uniform(ref)) freeBricks(ref);
+            ref = kUniform | material;
+            continue;
+        }
+        if (uniform(ref)) {
+            if (materialOf(ref) == material) continue;
+            ref = allocBricks(materialOf(ref));
+        }
+
+        const glm::ivec3 a = glm::max(lo, clo), b = glm::min(hi, chi);
+        const glm::ivec3 b0 = (a - o) / kBrick, b1 = (b - o) / kBrick;
+        for (int bx=b0.x;bx<=b1.x;bx++) for (int by=b0.y;by<=b1.y;by++) for (int bz=b0.z;bz<=b1.z;bz++){
+            const int c = child(bx, by, bz);
+            if (fillBrick(m_bricks[size_t(ref) * kPer + c], o + glm::ivec3(bx, by, bz) * kBrick, a, b, material))
+                m_touched.push_back(uint32_t(node(nx, ny, nz) * kPer + c));
+        }
+    }
+}
+
+bool VoxelBricks::fillBrick(uint32_t& ref, glm::ivec3 o, glm::ivec3 lo, glm::ivec3 hi, uint8_t material){
+    glm::ivec3 clo, chi;
+    clip(o, kBrick, clo, chi);
+    if (glm::all(glm::lessThanEqual(lo, clo)) && glm::all(glm::greaterThanEqual(hi, chi))) {
+        if (!uniform(ref)) m_freeCells.push_back(ref);
+        ref = kUniform | material;
+        return true; // its node may have turned uniform
+    }
+    if (uniform(ref)) {
+        if (materialOf(ref) == material) return false;
+        ref = allocCells(materialOf(ref));
+    }
+    const glm::ivec3 a = glm::max(lo, clo) - o, b = glm::min(hi, chi) - o;
+    uint8_t* cells = m_cells.data() + size_t(ref) * kPer;
+    for (int x=a.x;x<=b.x;x++) for (int z=a.z;z<=b.z;z++)
+        std::fill(cells + child(x, a.y, z), cells + child(x, b.y, z) + 1, material);
+    return true;
+}
+
+bool VoxelBricks::sameCells(uint32_t block, glm::ivec3 o, uint8_t& material) const{
+    glm::ivec3 lo, hi;
+    clip(o, kBrick, lo, hi);
+    const uint8_t* cells = m_cells.data() + size_t(block) * kPer;
+    material = cells[0];
+    const glm::ivec3 b = hi - o;
+    for (int x=0;x<=b.x;x++) for (int z=0;z<=b.z;z++) for (int y=0;y<=b.y;y++)
+        if (cells[child(x, y, z)] != material) return false;
+    return true;
+}
+
+void VoxelBricks::compact(){
+    std::sort(m_touched.begin(), m_touched.end());
+    m_touched.erase(std::unique(m_touched.begin(), m_touched.end()), m_touched.end());
+    auto originOf = [&](int k) { return glm::ivec3(k / (m_gy * m_gz), (k / m_gz) % m_gy, k % m_gz) * kNode; };
+
+    // the bricks first
+    for (uint32_t t : m_touched){
+        const int k = int(t / kPer), c = int(t % kPer);
+        const uint32_t ref = m_nodes[k];
+        if (uniform(ref)) continue; // covered by a later fill
+        uint32_t& brick = m_bricks[size_t(ref) * kPer + c];
+        const glm::ivec3 b(c / (kBrick * kBrick), c % kBrick, c / kBrick % kBrick);
+        uint8_t material;
+        if (!uniform(brick) && sameCells(brick, originOf(k) + b * kBrick, material)) {
+            m_freeCells.push_back(brick);
+            brick = kUniform | material;
+        }
+    }
+
+    // then their nodes, once each (the list is sorted by node)
+    for (size_t i = 0; i < m_touched.size(); i++){
+        const int k = int(m_touched[i] / kPer);
+        if (i + 1 < m_touched.size() && int(m_touched[i + 1] / kPer) == k) continue;
+        uint32_t& ref = m_nodes[k];
+        if (uniform(ref)) continue;
+        const glm::ivec3 o = originOf(k);
+        glm::ivec3 lo, hi;
+        clip(o, kNode, lo, hi);
+        const glm::ivec3 b1 = (hi - o) / kBrick;
+        const uint32_t first = m_bricks[size_t(ref) * kPer];
+        bool same = uniform(first);
+        for (int bx=0;bx<=b1.x && same;bx++) for (int by=0;by<=b1.y && same;by++) for (int bz=0;bz<=b1.z && same;bz++)
+            same = m_bricks[size_t(ref) * kPer + child(bx, by, bz)] == first;
+        if (same) {
+            freeBricks(ref);
+            ref = first;
+        }
+    }
+    m_touched.clear();
+}
+
+uint8_t VoxelBricks::at(int x, int y, int z) const{
+    const uint32_t ref = m_nodes[node(x / kNode, y / kNode, z / kNode)];
+    if (uniform(ref)) return materialOf(ref);
+    const uint32_t brick = m_bricks[size_t(ref) * kPer +
+                                    child(x % kNode / kBrick, y % kNode / kBrick, z % kNode / kBrick)];
+    if (uniform(brick)) return materialOf(brick);
+    return m_cells[size_t(brick) * kPer + child(x % kBrick, y % kBrick, z % kBrick)];
+}
+
+void VoxelBricks::getColumn(int x, int z, uint8_t* cells) const{
+    const int nx = x / kNode, nz = z / kNode;
+    const int bx = x % kNode / kBrick, bz = z % kNode / kBrick;
+    for (int ny=0;ny<m_gy;ny++){
+        const int y0 = ny * kNode, y1 = std::min(y0 + kNode, m_sy);
+        const uint32_t ref = m_nodes[node(nx, ny, nz)];
+        if (uniform(ref)) { std::fill(cells + y0, cells + y1, materialOf(ref)); continue; }
+        for (int y=y0;y<y1;y+=kBrick){
+            const int n = std::min(kBrick, y1 - y);
+            const uint32_t brick = m_bricks[size_t(ref) * kPer + child(bx, (y - y0) / kBrick, bz)];
+            if (uniform(brick)) std::fill_n(cells + y, n, materialOf(brick));
+            else std::copy_n(m_cells.data() + size_t(brick) * kPer + child(x % kBrick, 0, z % kBrick), n, cells + y);
+        }
+    }
+}
+
+void VoxelBricks::occupancy(int x, int z, uint64_t* words) const{
+    std::fill(words, words + wordsPerColumn(), 0);
+    // bits [y, y + n), within one word since kNode divides 64
+    auto setBits = [&](int y, int n) {
+        words[y >> 6] |= (n == 64 ? ~0ull : (1ull << n) - 1) << (y & 63);
+    };
+    const int nx = x / kNode, nz = z / kNode;
+    const int bx = x % kNode / kBrick, bz = z % kNode / kBrick;
+    for (int ny=0;ny<m_gy;ny++){
+        const int y0 = ny * kNode, y1 = std::min(y0 + kNode, m_sy);
+        const uint32_t ref = m_nodes[node(nx, ny, nz)];
+        if (uniform(ref)) { if (materialOf(ref)) setBits(y0, y1 - y0); continue; }
+        for (int y=y0;y<y1;y+=kBrick){
+            const int n = std::min(kBrick, y1 - y);
+            const uint32_t brick = m_bricks[size_t(ref) * kPer + child(bx, (y - y0) / kBrick, bz)];
+            if (uniform(brick)) { if (materialOf(brick)) setBits(y, n); continue; }
+            const uint8_t* cells = m_cells.data() + size_t(brick) * kPer + child(x % kBrick, 0, z % kBrick);
+            for (int k=0;k<n;k++)
+                if (cells[k]) words[(y + k) >> 6] |= 1ull << ((y + k) & 63);
+        }
+    }
+}
+
+size_t VoxelBricks::memoryBytes() const{
+    return m_nodes.capacity() * sizeof(uint32_t) + m_bricks.capacity() * sizeof(uint32_t) +
+           m_cells.capacity() + (m_freeBricks.capacity() + m_freeCells.capacity()) * sizeof(uint32_t) +
+           m_touched.capacity() * sizeof(uint32_t);
+}
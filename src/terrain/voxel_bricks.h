@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Sparse voxel storage: a grid of kNode^3 nodes, each either one material or split
+// into kBrick^3 bricks, each again either one material or kBrick^3 cells. Air and
+// solid ground collapse to a single node, so memory follows the surface and tall
+// chunks cost little more than flat ones. Readers walk the hierarchy and handle a
+// uniform node or brick as a whole.
+//
+// Nodes line up with VoxelChunk sections: node n = (nx * gy + ny) * gz + nz.
+class VoxelBricks
+{
+public:
+    static constexpr int kNode  = 16;
+    static constexpr int kBrick = 4;
+
+    // all air
+    void reset(int sx, int sy, int sz);
+
+    int sizeX() const { return m_sx; }
+    int sizeY() const { return m_sy; }
+    int sizeZ() const { return m_sz; }
+
+    // Cells in [lo, hi], which must lie inside. Nodes and bricks the box covers
+    // become uniform; the others are split as needed and collapse again in compact().
+    void fill(glm::ivec3 lo, glm::ivec3 hi, uint8_t material);
+    void set(int x, int y, int z, uint8_t material) { fill({x, y, z}, {x, y, z}, material); }
+    // merges the bricks written since the last compact() that turned uniform, and
+    // then their nodes
+    void compact();
+
+    // material at (x, y, z); the position must lie inside
+    uint8_t at(int x, int y, int z) const;
+    // cells[0..sizeY()) of column (x, z), bottom to top
+    void getColumn(int x, int z, uint8_t *cells) const;
+
+    // Occupancy of column (x, z) as in VoxelColumns::occupancy
+    int wordsPerColumn() const { return (m_sy + 63) / 64; }
+    void occupancy(int x, int z, uint64_t *words) const;
+
+    // Whether node (nx, ny, nz) is all air. Once compacted, any other node holds a
+    // solid cell.
+    bool nodeAir(int nx, int ny, int nz) const {
+        const uint32_t ref = m_nodes[node(nx, ny, nz)];
+        return uniform(ref) && materialOf(ref) == 0;
+    }
+
+    // resident bytes (node and brick references, cells)
+    size_t memoryBytes() const;
+
+private:
+    // A node or brick reference: a material when kUniform is set, otherwise the
+    // index of its brick block (64 references) or cell block (64 cells).
+    static constexpr uint32_t kUniform = 0x80000000u;
+    static constexpr int kPer = kBrick * kBrick * kBrick; // bricks per node = cells per brick
+
+    static bool uniform(uint32_t ref) { return (ref & kUniform) != 0; }
+    static uint8_t materialOf(uint32_t ref) { return uint8_t(ref); }
+    // child k of a block at (a, b, c), y innermost so a column is contiguous
+    static int child(int a, int b, int c) { return (a * kBrick + c) * kBrick + b; }
+
+    int node(int nx, int ny, int nz) const { return (nx * m_gy + ny) * m_gz + nz; }
+    // cells [lo, hi] of a node or brick at origin o of size n, cut to the storage
+    void clip(glm::ivec3 o, int n, glm::ivec3 &lo, glm::ivec3 &hi) const;
+
+    uint32_t allocBricks(uint8_t material); // a block of uniform bricks
+    uint32_t allocCells(uint8_t material);
+    void freeBricks(uint32_t block);        // and the cells of its bricks
+    // fill() on one brick of a split node; false if nothing changed
+    bool fillBrick(uint32_t &ref, glm::ivec3 o, glm::ivec3 lo, glm::ivec3 hi, uint8_t material);
+    // whether the cells of the brick at o (those inside the storage) all hold one material
+    bool sameCells(uint32_t block, glm::ivec3 o, uint8_t &material) const;
+
+    int m_sx = 0, m_sy = 0, m_sz = 0;
+    int m_gx = 0, m_gy = 0, m_gz = 0;   // node grid
+    std::vector<uint32_t> m_nodes;       // per node
+    std::vector<uint32_t> m_bricks;      // kPer references per block of a split node
+    std::vector<uint8_t>  m_cells;       // kPer cells per split brick
+    std::vector<uint32_t> m_freeBricks, m_freeCells; // unused blocks
+    std::vector<uint32_t> m_touched;     // node * kPer + brick of the cells written since compact()
+};
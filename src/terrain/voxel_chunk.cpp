@@ -1,30 +1,18 @@
 #include "voxel_chunk.h"
 #include <cmath>
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
 
 glm::vec2 VoxelChunk::randGrad(int gx, int gy) const {
-    std::hash<int> H;
-    int h = H(gx * 41 + gy * 43 + int(seed)) & 1023; // 1024
-    float t = (h / 1024.f) * 6.2831853f; // [0,2pi)
-    return {std::cos(t), std::sin(t)};
+    int h = grad.index(gx, gy); // (gx*41 + gy*43 + seed) & 1023
+    return {grad.gx[h], grad.gy[h]};
 }
-static inline float smooth3(float t){ t=glm::clamp(t,0.f,1.f); return t*t*(3.f-2.f*t); }
 
 float VoxelChunk::perlin(float x, float y) const {
-    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
-    int x1 = x0 + 1, y1 = y0 + 1;
-    glm::vec2 dTL(x - x0, y - y1);
-    glm::vec2 dTR(x - x1, y - y1);
-    glm::vec2 dBR(x - x1, y - y0);
-    glm::vec2 dBL(x - x0, y - y0);
-    float A = glm::dot(randGrad(x0,y1), dTL);
-    float B = glm::dot(randGrad(x1,y1), dTR);
-    float C = glm::dot(randGrad(x1,y0), dBR);
-    float D = glm::dot(randGrad(x0,y0), dBL);
-    float u = x - x0, v = y - y0;
-    float bottom = D + smooth3(u) * (C - D);
-    float top    = A + smooth3(u) * (B - A);
-    return bottom + smooth3(v) * (top - bottom);
+    return Noise::perlin(grad, x, y);
 }
 
 float VoxelChunk::heightRidged(float x, float z) const {
@@ -40,100 +28,714 @@ float VoxelChunk::heightRidged(float x, float z) const {
     return float(baseHeight) + float(heightAmp) * h;
 }
 
-void VoxelChunk::emitFace(std::vector<float>& out,
-                          glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d,
-                          glm::vec3 n, glm::vec3 col){
+void VoxelChunk::heightRidgedRow(const float* x, const float* z, float* out, int n) const {
+    Noise::ridgedBatch(grad, x, z, out, n, octaves, baseFreq, lacunarity, gain, ridgeExp);
+    for (int k=0;k<n;k++) out[k] = float(baseHeight) + float(heightAmp) * out[k];
+}
+
+float* VoxelChunk::writeFace(float* dst,
+                             glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d,
+                             glm::vec3 n, glm::vec3 col){
     auto put=[&](glm::vec3 p){
-        out.insert(out.end(), {p.x,p.y,p.z, n.x,n.y,n.z, col.r,col.g,col.b});
+        const float v[9] = {p.x,p.y,p.z, n.x,n.y,n.z, col.r,col.g,col.b};
+        dst = std::copy(v, v + 9, dst);
     };
     put(a); put(b); put(c);
     put(a); put(c); put(d);
+    return dst;
 }
 
-std::vector<float> VoxelChunk::build(){
-    vox.assign(size_t(sx)*sy*sz, 0);
+namespace {
+
+const glm::vec3 GRASS(0.21f, 0.85f, 0.21f);
+const glm::vec3 DIRT (0.55f, 0.36f, 0.16f);
+
+// The six face directions. corner[i] picks, per axis, the low (0) or high (1) side
+// of the face's voxel (or merged rectangle) for corners a, b, c, d of writeFace.
+struct FaceDir {
+    int axis, sign;
+    std::array<glm::ivec3, 4> corner;
+};
+const std::array<FaceDir, 6> kFaceDirs = {{
+    {1, +1, {{{0,1,0}, {1,1,0}, {1,1,1}, {0,1,1}}}}, // +Y
+    {1, -1, {{{0,0,1}, {1,0,1}, {1,0,0}, {0,0,0}}}}, // -Y
+    {0, -1, {{{0,1,1}, {0,1,0}, {0,0,0}, {0,0,1}}}}, // -X
+    {0, +1, {{{1,1,0}, {1,1,1}, {1,0,1}, {1,0,0}}}}, // +X
+    {2, -1, {{{1,1,0}, {0,1,0}, {0,0,0}, {1,0,0}}}}, // -Z
+    {2, +1, {{{0,1,1}, {1,1,1}, {1,0,1}, {0,0,1}}}}, // +Z
+}};
+
+// the axes spanning a face of axis d; u runs along x (contiguous in vox) where it can
+void axesOf(int d, int& u, int& v) { u = d == 0 ? 2 : 0; v = 3 - d - u; }
+
+} // namespace
+
+glm::vec3 VoxelChunk::materialColor(uint8_t material){
+    return material == 2 ? GRASS : DIRT;
+}
 
-    // 1) AIR=0, DIRT=1, GRASS=2
+void VoxelChunk::fillVoxels(){
+    Noise::fillAngularTable(grad, seed);
+
+    // 1) column heights, a row of z at a time
+    std::vector<int> heights(size_t(sx) * sz); // heights[x * sz + z]
+    std::vector<float> wx(sz), wz(sz), colH(sz);
+    for (int z=0;z<sz;z++) wz[z] = float(origin.z + z);
     for (int x=0;x<sx;x++){
+        std::fill(wx.begin(), wx.end(), float(origin.x + x));
+        heightRidgedRow(wx.data(), wz.data(), colH.data(), sz);
         for (int z=0;z<sz;z++){
-            float wx = float(origin.x + x);
-            float wz = float(origin.z + z);
-            int h = int(std::floor(heightRidged(wx, wz)));
-            h = std::max(0, std::min(h, sy-1));
-            for (int y=0; y<=h; ++y){
-                vox[idx(x,y,z)] = (y==h) ? 2 : 1;
+            int h = int(std::floor(colH[z]));
+            heights[size_t(x) * sz + z] = std::max(0, std::min(h, sy-1));
+        }
+    }
+
+    // 2) AIR=0, DIRT=1, GRASS=2
+    if (storage != Storage::Dense) { vox.clear(); vox.shrink_to_fit(); }
+    if (storage == Storage::Columns) {
+        columns.reset(sx, sy, sz);
+        std::vector<uint8_t> column(sy);
+        // columns are appended in (x, z) order
+        for (int x=0;x<sx;x++) for (int z=0;z<sz;z++){
+            const int h = heights[size_t(x) * sz + z];
+            std::fill(column.begin(), column.begin() + h, uint8_t(1));
+            column[h] = 2;
+            std::fill(column.begin() + h + 1, column.end(), uint8_t(0));
+            columns.setColumn(x, z, column.data());
+        }
+        return;
+    }
+    if (storage == Storage::Bricks) {
+        bricks.reset(sx, sy, sz);
+        // per brick-wide block of columns, the ground under its lowest column as
+        // one box (whole bricks and nodes stay uniform), then the rest column by
+        // column; compacting each block keeps the split bricks down to the surface
+        const int B = VoxelBricks::kBrick;
+        for (int x0=0;x0<sx;x0+=B) for (int z0=0;z0<sz;z0+=B){
+            const int x1 = std::min(x0 + B, sx), z1 = std::min(z0 + B, sz);
+            int floorH = sy;
+            for (int x=x0;x<x1;x++) for (int z=z0;z<z1;z++)
+                floorH = std::min(floorH, heights[size_t(x) * sz + z]);
+            if (floorH > 0) bricks.fill({x0, 0, z0}, {x1 - 1, floorH - 1, z1 - 1}, 1);
+            for (int x=x0;x<x1;x++) for (int z=z0;z<z1;z++){
+                const int h = heights[size_t(x) * sz + z];
+                if (h > floorH) bricks.fill({x, floorH, z}, {x, h - 1, z}, 1);
+                bricks.set(x, h, z, 2);
+            }
+            bricks.compact();
+        }
+        return;
+    }
+    // in vox order, so every cell is written once and in sequence
+    vox.resize(size_t(sx)*sy*sz);
+    uint8_t* cell = vox.data();
+    for (int y=0;y<sy;y++) for (int z=0;z<sz;z++) for (int x=0;x<sx;x++){
+        const int h = heights[size_t(x) * sz + z];
+        *cell++ = y < h ? 1 : y == h ? 2 : 0;
+    }
+}
+
+void VoxelChunk::occupancy(ColumnRect& occ, const Neighbours* n) const{
+    const int W = (sy + 63) / 64;
+    const int nz = occ.z1 - occ.z0;
+    occ.W = W;
+    occ.words.assign(size_t(occ.x1 - occ.x0) * nz * W, 0);
+    auto column = [&](int x, int z) { return occ.words.data() + (size_t(x - occ.x0) * nz + (z - occ.z0)) * W; };
+
+    // the part inside the chunk
+    const int cx0 = std::max(occ.x0, 0), cx1 = std::min(occ.x1, sx);
+    const int cz0 = std::max(occ.z0, 0), cz1 = std::min(occ.z1, sz);
+    if (storage != Storage::Dense) {
+        for (int x=cx0;x<cx1;x++) for (int z=cz0;z<cz1;z++)
+            columnOccupancy(x, z, column(x, z));
+    } else if (cx0 < cx1) {
+        // vox order; a slab of y shares one word per column
+        for (int y=0;y<sy;y++){
+            const uint64_t bit = 1ull << (y & 63);
+            for (int z=cz0;z<cz1;z++){
+                const uint8_t* cell = vox.data() + idx(cx0,y,z);
+                uint64_t* word = column(cx0, z) + (y >> 6);
+                for (int x=0;x<cx1-cx0;x++)
+                    if (cell[x]) word[size_t(x) * nz * W] |= bit;
             }
         }
     }
 
-    std::vector<float> interl; interl.reserve(size_t(sx)*sy*sz * 6 * 6 * 9 / 4);
-    const glm::vec3 GRASS(0.21f, 0.85f, 0.21f);
-    const glm::vec3 DIRT (0.55f, 0.36f, 0.16f);
+    // one column past each side
+    if (!n) return;
+    for (int side=0;side<4;side++){
+        const std::vector<uint64_t>& line = n->side[side];
+        if (line.empty()) continue;
+        if (side < 2) {
+            const int x = side == 0 ? -1 : sx;
+            if (x < occ.x0 || x >= occ.x1) continue;
+            for (int z=cz0;z<cz1;z++)
+                std::copy_n(line.data() + size_t(z) * W, W, column(x, z));
+        } else {
+            const int z = side == 2 ? -1 : sz;
+            if (z < occ.z0 || z >= occ.z1) continue;
+            for (int x=cx0;x<cx1;x++)
+                std::copy_n(line.data() + size_t(x) * W, W, column(x, z));
+        }
+    }
+}
+
+VoxelChunk::ColumnRect VoxelChunk::occupancyAround(glm::ivec3 lo, glm::ivec3 hi, const Neighbours* n) const{
+    ColumnRect occ;
+    occ.x0 = lo.x - 1; occ.x1 = hi.x + 1;
+    occ.z0 = lo.z - 1; occ.z1 = hi.z + 1;
+    occupancy(occ, n);
+    return occ;
+}
+
+void VoxelChunk::columnOccupancy(int x, int z, uint64_t* words) const{
+    if (storage == Storage::Columns) {
+        columns.occupancy(x, z, words);
+        return;
+    }
+    if (storage == Storage::Bricks) {
+        bricks.occupancy(x, z, words);
+        return;
+    }
+    std::fill(words, words + (sy + 63) / 64, 0);
+    for (int y=0;y<sy;y++)
+        if (vox[idx(x,y,z)]) words[y >> 6] |= 1ull << (y & 63);
+}
+
+void VoxelChunk::edgeOccupancy(int side, std::vector<uint64_t>& out) const{
+    const int W = (sy + 63) / 64;
+    const bool alongZ = side < 2; // an x side is a line of sz columns
+    const int n = alongZ ? sz : sx;
+    const int fixed = (side & 1) ? (alongZ ? sx : sz) - 1 : 0;
+    out.resize(size_t(n) * W);
+    for (int k=0;k<n;k++)
+        columnOccupancy(alongZ ? fixed : k, alongZ ? k : fixed, &out[size_t(k) * W]);
+}
+
+void VoxelChunk::generate(){
+    fillVoxels();
+    dirty.assign(sectionCount(), 0);
+    sectionSolid.assign(sectionCount(), 0);
+    summarize(glm::ivec3(0), glm::ivec3(sx, sy, sz) - 1);
+}
 
-    auto blockColor=[&](int x,int y,int z){
-        return (vox[idx(x,y,z)]==2)? GRASS : DIRT;
+std::vector<float> VoxelChunk::mesh(const Neighbours* neighbours) const{
+    const glm::ivec3 lo(0), hi(sx, sy, sz);
+    std::vector<Quad> quads;
+    meshBox(occupancyAround(lo, hi, neighbours), lo, hi, quads);
+    std::vector<float> out;
+    writeQuads(quads, out);
+    return out;
+}
+
+std::vector<float> VoxelChunk::build(){
+    generate();
+    return mesh();
+}
+
+void VoxelChunk::sectionBox(int section, glm::ivec3& lo, glm::ivec3& hi) const{
+    const glm::ivec3 g = sectionGrid();
+    const glm::ivec3 cell(section / (g.y * g.z), (section / g.z) % g.y, section % g.z);
+    lo = cell * kSection;
+    hi = glm::min(lo + kSection, glm::ivec3(sx, sy, sz));
+}
+
+template <class Vertex>
+void VoxelChunk::meshSectionsInto(const Neighbours* neighbours, std::vector<Vertex>& out,
+                                  std::vector<uint32_t>& sectionEnds) const{
+    // one occupancy for all sections
+    const ColumnRect occ = occupancyAround(glm::ivec3(0), glm::ivec3(sx, sy, sz), neighbours);
+    out.clear();
+    sectionEnds.clear();
+    std::vector<Quad> quads;
+    uint32_t vertices = 0;
+    for (int s=0;s<sectionCount();s++){
+        glm::ivec3 lo, hi;
+        sectionBox(s, lo, hi);
+        quads.clear();
+        meshBox(occ, lo, hi, quads);
+        writeQuads(quads, out);
+        vertices += uint32_t(quads.size() * 6);
+        sectionEnds.push_back(vertices);
+    }
+}
+
+void VoxelChunk::meshSections(const Neighbours* neighbours, std::vector<float>& out,
+                              std::vector<uint32_t>& sectionEnds) const{
+    meshSectionsInto(neighbours, out, sectionEnds);
+}
+
+void VoxelChunk::meshSections(const Neighbours* neighbours, std::vector<PackedVertex>& out,
+                              std::vector<uint32_t>& sectionEnds) const{
+    meshSectionsInto(neighbours, out, sectionEnds);
+}
+
+std::vector<float> VoxelChunk::meshSection(int section, const Neighbours* neighbours) const{
+    glm::ivec3 lo, hi;
+    sectionBox(section, lo, hi);
+    std::vector<Quad> quads;
+    meshBox(occupancyAround(lo, hi, neighbours), lo, hi, quads);
+    std::vector<float> out;
+    writeQuads(quads, out);
+    return out;
+}
+
+void VoxelChunk::meshSection(int section, const Neighbours* neighbours, std::vector<PackedVertex>& out) const{
+    glm::ivec3 lo, hi;
+    sectionBox(section, lo, hi);
+    std::vector<Quad> quads;
+    meshBox(occupancyAround(lo, hi, neighbours), lo, hi, quads);
+    out.clear();
+    writeQuads(quads, out);
+}
+
+// ----- edits
+
+void VoxelChunk::fillColumn(int x, int z, int y0, int y1, uint8_t m){
+    if (storage == Storage::Dense) {
+        for (int y=y0;y<=y1;y++) vox[idx(x,y,z)] = m;
+        return;
+    }
+    if (storage == Storage::Bricks) {
+        bricks.fill({x, y0, z}, {x, y1, z}, m);
+        return;
+    }
+    std::vector<uint8_t> cells(sy);
+    columns.getColumn(x, z, cells.data());
+    std::fill(cells.begin() + y0, cells.begin() + y1 + 1, m);
+    if (columns.setColumn(x, z, cells.data())) return;
+    // the runs cannot index another material: fall back to one byte per cell
+    convertToDense();
+    for (int y=y0;y<=y1;y++) vox[idx(x,y,z)] = m;
+}
+
+void VoxelChunk::convertToDense(){
+    vox.assign(size_t(sx) * sy * sz, 0);
+    std::vector<uint8_t> cells(sy);
+    for (int x=0;x<sx;x++) for (int z=0;z<sz;z++){
+        columns.getColumn(x, z, cells.data());
+        for (int y=0;y<sy;y++) vox[idx(x,y,z)] = cells[y];
+    }
+    columns = VoxelColumns();
+    storage = Storage::Dense;
+}
+
+void VoxelChunk::markDirty(glm::ivec3 lo, glm::ivec3 hi){
+    // a cell's faces belong to it and to its six neighbours
+    lo = glm::max(lo - 1, glm::ivec3(0));
+    hi = glm::min(hi + 1, glm::ivec3(sx, sy, sz) - 1);
+    if (glm::any(glm::greaterThan(lo, hi))) return;
+    const glm::ivec3 g = sectionGrid();
+    lo /= kSection; hi /= kSection;
+    for (int x=lo.x;x<=hi.x;x++) for (int y=lo.y;y<=hi.y;y++) for (int z=lo.z;z<=hi.z;z++)
+        dirty[(x * g.y + y) * g.z + z] = 1;
+}
+
+void VoxelChunk::setVoxel(int x, int y, int z, uint8_t m){
+    fillBox(glm::ivec3(x, y, z), glm::ivec3(x, y, z), m);
+}
+
+void VoxelChunk::fillBox(glm::ivec3 lo, glm::ivec3 hi, uint8_t m){
+    markDirty(lo, hi);
+    lo = glm::max(lo, glm::ivec3(0));
+    hi = glm::min(hi, glm::ivec3(sx, sy, sz) - 1);
+    if (glm::any(glm::greaterThan(lo, hi))) return;
+    if (storage == Storage::Bricks) {
+        bricks.fill(lo, hi, m);
+        bricks.compact();
+    } else {
+        for (int x=lo.x;x<=hi.x;x++) for (int z=lo.z;z<=hi.z;z++)
+            fillColumn(x, z, lo.y, hi.y, m);
+    }
+    summarize(lo, hi);
+}
+
+void VoxelChunk::fillSphere(glm::vec3 centre, float radius, uint8_t m){
+    const glm::ivec3 lo(glm::floor(centre - radius)), hi(glm::ceil(centre + radius));
+    markDirty(lo, hi);
+    const float r2 = radius * radius;
+    for (int x=std::max(lo.x,0);x<=std::min(hi.x,sx-1);x++){
+        for (int z=std::max(lo.z,0);z<=std::min(hi.z,sz-1);z++){
+            // the column's cells inside form one run around the centre's height
+            const float dx = float(x) + 0.5f - centre.x, dz = float(z) + 0.5f - centre.z;
+            const float rest = r2 - dx*dx - dz*dz;
+            if (rest < 0.f) continue;
+            const float t = std::sqrt(rest);
+            const int y0 = std::max(int(std::ceil(centre.y - t - 0.5f)), 0);
+            const int y1 = std::min(int(std::floor(centre.y + t - 0.5f)), sy-1);
+            if (y0 <= y1) fillColumn(x, z, y0, y1, m);
+        }
+    }
+    if (storage == Storage::Bricks) bricks.compact();
+    const glm::ivec3 cellLo = glm::max(lo, glm::ivec3(0)), cellHi = glm::min(hi, glm::ivec3(sx, sy, sz) - 1);
+    if (glm::all(glm::lessThanEqual(cellLo, cellHi))) summarize(cellLo, cellHi);
+}
+
+std::vector<int> VoxelChunk::takeDirtySections(){
+    std::vector<int> out;
+    for (int s=0;s<int(dirty.size());s++)
+        if (dirty[s]) { out.push_back(s); dirty[s] = 0; }
+    return out;
+}
+
+void VoxelChunk::summarize(glm::ivec3 lo, glm::ivec3 hi){
+    static_assert(VoxelBricks::kNode == kSection, "a bricks node is a section");
+    const glm::ivec3 g = sectionGrid();
+    const glm::ivec3 s0 = lo / kSection, s1 = hi / kSection;
+    std::vector<uint64_t> words((sy + 63) / 64), any(words.size());
+    for (int ix=s0.x;ix<=s1.x;ix++) for (int iz=s0.z;iz<=s1.z;iz++){
+        uint8_t* solid = sectionSolid.data() + size_t(ix * g.y) * g.z + iz; // solid[iy * g.z]
+        if (storage == Storage::Bricks) {
+            for (int iy=s0.y;iy<=s1.y;iy++) solid[iy * g.z] = !bricks.nodeAir(ix, iy, iz);
+            continue;
+        }
+        if (storage == Storage::Dense) {
+            // rows of x in memory order, up to the first solid cell
+            for (int iy=s0.y;iy<=s1.y;iy++){
+                glm::ivec3 sLo, sHi;
+                sectionBox((ix * g.y + iy) * g.z + iz, sLo, sHi);
+                const int n = sHi.x - sLo.x;
+                bool found = false;
+                for (int y=sLo.y;y<sHi.y && !found;y++) for (int z=sLo.z;z<sHi.z && !found;z++){
+                    const uint8_t* row = vox.data() + idx(sLo.x, y, z);
+                    found = std::find_if(row, row + n, [](uint8_t m) { return m != 0; }) != row + n;
+                }
+                solid[iy * g.z] = found;
+            }
+            continue;
+        }
+
+        // the occupancy of every column of the section column, ORed; a section's
+        // kSection cells lie in one word
+        std::fill(any.begin(), any.end(), 0);
+        for (int x=ix*kSection;x<std::min((ix+1)*kSection,sx);x++)
+            for (int z=iz*kSection;z<std::min((iz+1)*kSection,sz);z++){
+                columnOccupancy(x, z, words.data());
+                for (size_t w=0;w<words.size();w++) any[w] |= words[w];
+            }
+        for (int iy=s0.y;iy<=s1.y;iy++){
+            const int y0 = iy * kSection, n = std::min(kSection, sy - y0);
+            solid[iy * g.z] = (any[y0 >> 6] & (((1ull << n) - 1) << (y0 & 63))) != 0;
+        }
+    }
+
+    solidTop = 0;
+    for (int s=0;s<int(sectionSolid.size());s++){
+        glm::ivec3 sLo, sHi;
+        if (sectionSolid[s]) { sectionBox(s, sLo, sHi); solidTop = std::max(solidTop, sHi.y); }
+    }
+}
+
+// ----- ray queries
+
+bool VoxelChunk::raycast(glm::vec3 o, glm::vec3 d, float maxDistance, RayHit& hit) const{
+    // the part of the ray inside the chunk, cut at solidTop: above it is air
+    const glm::ivec3 size(sx, solidTop, sz);
+    float t0 = 0.f, t1 = maxDistance;
+    int entry = -1; // axis of the side the ray comes in through
+    for (int i=0;i<3;i++){
+        if (d[i] == 0.f) {
+            if (o[i] < 0.f || o[i] >= float(size[i])) return false;
+            continue;
+        }
+        float a = -o[i] / d[i], b = (float(size[i]) - o[i]) / d[i];
+        if (a > b) std::swap(a, b);
+        // an origin on the far side's plane lies in the next cell out, so the
+        // ray still comes in through that side
+        if (a > t0 || (a == t0 && o[i] >= float(size[i]))) { t0 = a; entry = i; }
+        t1 = std::min(t1, b);
+    }
+    if (t0 > t1 || solidTop == 0) return false;
+
+    const glm::ivec3 step(glm::sign(d));
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(o + d * t0)), glm::ivec3(0), size - 1);
+    glm::vec3 tMax, tDelta;
+    // next crossing of a cell boundary along each axis
+    auto aim = [&] {
+        for (int i=0;i<3;i++)
+            tMax[i] = step[i] ? (float(cell[i] + (step[i] > 0)) - o[i]) / d[i] : INFINITY;
+    };
+    aim();
+    for (int i=0;i<3;i++) tDelta[i] = step[i] ? 1.f / std::abs(d[i]) : INFINITY;
+    glm::ivec3 normal(0);
+    if (entry >= 0) normal[entry] = -step[entry];
+    float t = t0;
+
+    const glm::ivec3 g = sectionGrid();
+    for (;;) {
+        const glm::ivec3 sc = cell / kSection;
+        if (!sectionSolid[(sc.x * g.y + sc.y) * g.z + sc.z]) {
+            // all air: on to where the ray leaves the section
+            const glm::ivec3 lo = sc * kSection, hi = glm::min(lo + kSection, size);
+            int a = 0;
+            float exit = INFINITY;
+            for (int i=0;i<3;i++){
+                if (!step[i]) continue;
+                const float ti = (float(step[i] > 0 ? hi[i] : lo[i]) - o[i]) / d[i];
+                if (ti < exit) { exit = ti; a = i; }
+            }
+            if (exit > t1) return false;
+            for (int i=0;i<3;i++)
+                cell[i] = i == a ? (step[i] > 0 ? hi[i] : lo[i] - 1)
+                                 : glm::clamp(int(std::floor(o[i] + d[i] * exit)), lo[i], hi[i] - 1);
+            if (cell[a] < 0 || cell[a] >= size[a]) return false;
+            aim();
+            t = std::max(t, exit);
+            normal = glm::ivec3(0);
+            normal[a] = -step[a];
+            continue;
+        }
+
+        if (const uint8_t m = material(cell.x, cell.y, cell.z)) {
+            hit.cell = cell;
+            hit.normal = normal;
+            hit.distance = t;
+            hit.material = m;
+            return true;
+        }
+        const int a = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        if (tMax[a] > t1) return false;
+        t = std::max(t, tMax[a]);
+        cell[a] += step[a];
+        tMax[a] += tDelta[a];
+        if (cell[a] < 0 || cell[a] >= size[a]) return false;
+        normal = glm::ivec3(0);
+        normal[a] = -step[a];
+    }
+}
+
+// ----- meshing
+
+bool VoxelChunk::hidden(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi) const {
+    // below and above the chunk is air
+    const bool closedY = lo.y > 0 && hi.y < sy;
+    // the bits of [y0, y1) in word w
+    auto bits = [](int w, int y0, int y1) {
+        const int a = std::max(y0 - w * 64, 0), b = std::min(y1 - w * 64, 64);
+        if (a >= b) return 0ull;
+        const uint64_t upper = b == 64 ? ~0ull : (1ull << b) - 1;
+        return upper & ~((1ull << a) - 1);
+    };
+    const int w0 = std::max(lo.y - 1, 0) >> 6, w1 = std::min(hi.y, sy - 1) >> 6;
+
+    // the box itself: no solid cell is hidden air, any air cell rules solid out
+    bool anySolid = false, allSolid = true;
+    for (int x=lo.x;x<hi.x;x++) for (int z=lo.z;z<hi.z;z++){
+        const uint64_t* col = occ.at(x, z);
+        for (int w=w0;w<=w1;w++){
+            const uint64_t box = bits(w, lo.y, hi.y);
+            anySolid = anySolid || (col[w] & box);
+            allSolid = allSolid && (col[w] & box) == box;
+        }
+        if (anySolid && !allSolid) return false;
+    }
+    if (!anySolid) return true;
+    if (!closedY) return false;
+
+    // solid: the cells just above and below, and the columns around
+    for (int x=lo.x;x<hi.x;x++) for (int z=lo.z;z<hi.z;z++){
+        const uint64_t* col = occ.at(x, z);
+        const int below = lo.y - 1, above = hi.y;
+        if (!((col[below >> 6] >> (below & 63)) & (col[above >> 6] >> (above & 63)) & 1)) return false;
+    }
+    auto sideSolid = [&](int x, int z) {
+        const uint64_t* col = occ.at(x, z);
+        for (int w=w0;w<=w1;w++){
+            const uint64_t box = bits(w, lo.y, hi.y);
+            if ((col[w] & box) != box) return false;
+        }
+        return true;
+    };
+    for (int z=lo.z;z<hi.z;z++)
+        if (!sideSolid(lo.x - 1, z) || !sideSolid(hi.x, z)) return false;
+    for (int x=lo.x;x<hi.x;x++)
+        if (!sideSolid(x, lo.z - 1) || !sideSolid(x, hi.z)) return false;
+    return true;
+}
+
+void VoxelChunk::meshBox(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const {
+    if (hidden(occ, lo, hi)) return;
+    if (greedy) meshGreedy(occ, lo, hi, quads);
+    else        meshNaive(occ, lo, hi, quads);
+}
+
+uint8_t VoxelChunk::cornerOcclusion(const ColumnRect& occ, glm::ivec3 cell, int f) const {
+    const FaceDir& dir = kFaceDirs[f];
+    int u, v;
+    axesOf(dir.axis, u, v);
+    glm::ivec3 front = cell;
+    front[dir.axis] += dir.sign;
+    uint8_t ao = 0;
+    for (int k=0;k<4;k++){
+        // the two cells along the corner's edges and the one across it
+        glm::ivec3 du(0), dv(0);
+        du[u] = dir.corner[k][u] ? 1 : -1;
+        dv[v] = dir.corner[k][v] ? 1 : -1;
+        const bool side1 = solid(occ, front + du), side2 = solid(occ, front + dv);
+        const int level = side1 && side2 ? 0 : 3 - int(side1) - int(side2) - int(solid(occ, front + du + dv));
+        ao |= uint8_t(level << (2 * k));
+    }
+    return ao;
+}
+
+// The +Y face takes the voxel's own material, every other face is dirt.
+void VoxelChunk::meshNaive(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const {
+    for (int x=lo.x;x<hi.x;x++)for(int y=lo.y;y<hi.y;y++)for(int z=lo.z;z<hi.z;z++){
+        const glm::ivec3 cell(x, y, z);
+        if (!solid(occ, cell)) continue;
+        for (int f=0;f<int(kFaceDirs.size());f++){
+            glm::ivec3 front = cell;
+            front[kFaceDirs[f].axis] += kFaceDirs[f].sign;
+            if (solid(occ, front)) continue;
+            quads.push_back({cell, uint8_t(f), f == 0 ? material(x, y, z) : uint8_t(1),
+                             occlusion ? cornerOcclusion(occ, cell, f) : kOpen, 1, 1});
+        }
+    }
+}
+
+// Per direction, the exposed faces of every slice form a 2D mask of materials (and
+// corner occlusion, with occlusion on), as in meshNaive. Each mask is covered by
+// maximal rectangles: grow along u while the entry matches, then along v while the
+// whole row does.
+void VoxelChunk::meshGreedy(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const {
+    const glm::ivec3 dims = hi - lo;
+    // masks of all slices of one direction, mask[(slice * nv + j) * nu + i], box-relative,
+    // material | occlusion << 8; cleared as rectangles take their faces
+    std::vector<uint16_t> mask(size_t(dims.x) * dims.y * dims.z, 0);
+    const int W = occ.W;
+    // the words holding y in [lo.y, hi.y), and which of their bits do
+    const int w0 = lo.y >> 6, w1 = (hi.y - 1) >> 6;
+    auto boxBits = [&](int w) {
+        const int a = std::max(lo.y - w * 64, 0), b = std::min(hi.y - w * 64, 64);
+        const uint64_t upper = b == 64 ? ~0ull : (1ull << b) - 1;
+        return upper & ~((1ull << a) - 1);
     };
 
-    for (int x=0;x<sx;x++)for(int y=0;y<sy;y++)for(int z=0;z<sz;z++){
-        if (!solid(x,y,z)) continue;
-        glm::vec3 col = blockColor(x,y,z);
-        float cx = float(origin.x + x) + 0.5f;
-        float cy = float(origin.y + y) + 0.5f;
-        float cz = float(origin.z + z) + 0.5f;
-        // (+Y)
-        if (!solid(x, y+1, z)) {
-            glm::vec3 n(0,1,0);
-            glm::vec3 a(cx-0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 b(cx+0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 c(cx+0.5f, cy+0.5f, cz+0.5f);
-            glm::vec3 d(cx-0.5f, cy+0.5f, cz+0.5f);
-            emitFace(interl,a,b,c,d,n, col);
-        }
-        // (-Y)
-        if (!solid(x, y-1, z)) {
-            glm::vec3 n(0,-1,0);
-            glm::vec3 a(cx-0.5f, cy-0.5f, cz+0.5f);
-            glm::vec3 b(cx+0.5f, cy-0.5f, cz+0.5f);
-            glm::vec3 c(cx+0.5f, cy-0.5f, cz-0.5f);
-            glm::vec3 d(cx-0.5f, cy-0.5f, cz-0.5f);
-            emitFace(interl,a,b,c,d,n, DIRT);
-        }
-        // -X
-        if (!solid(x-1, y, z)) {
-            glm::vec3 n(-1,0,0);
-            glm::vec3 a(cx-0.5f, cy+0.5f, cz+0.5f);
-            glm::vec3 b(cx-0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 c(cx-0.5f, cy-0.5f, cz-0.5f);
-            glm::vec3 d(cx-0.5f, cy-0.5f, cz+0.5f);
-            emitFace(interl,a,b,c,d,n, DIRT);
-        }
-        // +X
-        if (!solid(x+1, y, z)) {
-            glm::vec3 n(1,0,0);
-            glm::vec3 a(cx+0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 b(cx+0.5f, cy+0.5f, cz+0.5f);
-            glm::vec3 c(cx+0.5f, cy-0.5f, cz+0.5f);
-            glm::vec3 d(cx+0.5f, cy-0.5f, cz-0.5f);
-            emitFace(interl,a,b,c,d,n, DIRT);
-        }
-        // -Z
-        if (!solid(x, y, z-1)) {
-            glm::vec3 n(0,0,-1);
-            glm::vec3 a(cx+0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 b(cx-0.5f, cy+0.5f, cz-0.5f);
-            glm::vec3 c(cx-0.5f, cy-0.5f, cz-0.5f);
-            glm::vec3 d(cx+0.5f, cy-0.5f, cz-0.5f);
-            emitFace(interl,a,b,c,d,n, DIRT);
-        }
-        // +Z
-        if (!solid(x, y, z+1)) {
-            glm::vec3 n(0,0,1);
-            glm::vec3 a(cx-0.5f, cy+0.5f, cz+0.5f);
-            glm::vec3 b(cx+0.5f, cy+0.5f, cz+0.5f);
-            glm::vec3 c(cx+0.5f, cy-0.5f, cz+0.5f);
-            glm::vec3 d(cx-0.5f, cy-0.5f, cz+0.5f);
-            emitFace(interl,a,b,c,d,n, DIRT);
-        }
-    }
-    return interl;
+    for (int f = 0; f < int(kFaceDirs.size()); f++) {
+        const FaceDir& dir = kFaceDirs[f];
+        const int d = dir.axis;
+        int u, v;
+        axesOf(d, u, v);
+        const int nu = dims[u], nv = dims[v];
+        const bool topFaces = d == 1 && dir.sign > 0;
+
+        // 1) exposed faces, a column word at a time: solid here and not solid at the
+        // neighbour (outside the chunk: the neighbouring chunk's edge, else air).
+        // Only set entries are written: the mask starts out empty and step 2 empties it again.
+        const size_t strideSlice = size_t(nv) * nu;
+        for (int x = lo.x; x < hi.x; x++) {
+            for (int z = lo.z; z < hi.z; z++) {
+                const uint64_t* here = occ.at(x, z);
+                const uint64_t* side = d == 0 ? occ.at(x + dir.sign, z)
+                                     : d == 2 ? occ.at(x, z + dir.sign) : nullptr;
+                for (int w = w0; w <= w1; w++) {
+                    uint64_t neighbour;
+                    if (side) neighbour = side[w];
+                    else if (dir.sign > 0) neighbour = (here[w] >> 1) | (w + 1 < W ? here[w + 1] << 63 : 0);
+                    else neighbour = (here[w] << 1) | (w > 0 ? here[w - 1] >> 63 : 0);
+                    for (uint64_t bits = here[w] & ~neighbour & boxBits(w); bits; bits &= bits - 1) {
+                        const int y = w * 64 + std::countr_zero(bits);
+                        const int at[3] = {x - lo.x, y - lo.y, z - lo.z};
+                        uint16_t entry = topFaces ? material(x, y, z) : uint8_t(1);
+                        if (occlusion) entry |= uint16_t(cornerOcclusion(occ, {x, y, z}, f)) << 8;
+                        mask[at[d] * strideSlice + size_t(at[v]) * nu + at[u]] = entry;
+                    }
+                }
+            }
+        }
+
+        // 2) cover each slice with rectangles
+        for (int slice = 0; slice < dims[d]; slice++) {
+            uint16_t* plane = mask.data() + size_t(slice) * nv * nu;
+            for (int j = 0; j < nv; j++) {
+                uint16_t* line = plane + size_t(j) * nu;
+                for (int i = 0; i < nu;) {
+                    // most of a row is empty: skip it a word at a time
+                    uint64_t word;
+                    if (i + 4 <= nu && (std::memcpy(&word, line + i, 8), word == 0)) { i += 4; continue; }
+                    const uint16_t m = line[i];
+                    if (!m) { i++; continue; }
+                    int w = 1;
+                    while (i + w < nu && line[i + w] == m) w++;
+                    int h = 1;
+                    for (; j + h < nv; h++) {
+                        const uint16_t* next = line + size_t(h) * nu + i;
+                        if (std::any_of(next, next + w, [&](uint16_t o) { return o != m; })) break;
+                    }
+                    for (int r = 0; r < h; r++)
+                        std::fill_n(line + size_t(r) * nu + i, w, uint16_t(0));
+
+                    glm::ivec3 cell = lo;
+                    cell[d] += slice; cell[u] += i; cell[v] += j;
+                    quads.push_back({cell, uint8_t(f), uint8_t(m), occlusion ? uint8_t(m >> 8) : kOpen,
+                                     uint16_t(w), uint16_t(h)});
+                    i += w;
+                }
+            }
+        }
+    }
+}
+
+namespace {
+
+// the corners a, b, c, d of a quad, chunk-local
+template <class Quad>
+void quadCorners(const Quad& q, glm::ivec3 c[4]) {
+    const FaceDir& dir = kFaceDirs[q.dir];
+    int u, v;
+    axesOf(dir.axis, u, v);
+    glm::ivec3 extent(1);
+    extent[u] = q.w;
+    extent[v] = q.h;
+    for (int k = 0; k < 4; k++)
+        c[k] = q.cell + dir.corner[k] * extent;
+}
+
+// Two triangles as corners (a, b, c) (a, c, d), or, where a and c are darker than b and
+// d, along the other diagonal, so occlusion shades evenly across the quad.
+const int kTriangles[2][6] = {{0, 1, 2, 0, 2, 3}, {1, 2, 3, 1, 3, 0}};
+int diagonal(uint8_t ao) {
+    const int a = ao & 3, b = (ao >> 2) & 3, c = (ao >> 4) & 3, d = (ao >> 6) & 3;
+    return a + c < b + d ? 1 : 0;
+}
+
+} // namespace
+
+void VoxelChunk::writeQuads(const std::vector<Quad>& quads, std::vector<float>& out) const {
+    const size_t at = out.size();
+    out.resize(at + quads.size() * 6 * 9);
+    float* dst = out.data() + at;
+    for (const Quad& q : quads) {
+        glm::ivec3 c[4];
+        quadCorners(q, c);
+        glm::vec3 p[4];
+        for (int k = 0; k < 4; k++) p[k] = glm::vec3(origin + c[k]);
+        const FaceDir& dir = kFaceDirs[q.dir];
+        glm::vec3 normal(0.f);
+        normal[dir.axis] = float(dir.sign);
+        const glm::vec3 col = materialColor(q.material);
+        if (q.ao == kOpen) {
+            dst = writeFace(dst, p[0], p[1], p[2], p[3], normal, col);
+            continue;
+        }
+        for (int k : kTriangles[diagonal(q.ao)]) {
+            const glm::vec3 shaded = col * occlusionShade((q.ao >> (2 * k)) & 3);
+            const float v[9] = {p[k].x, p[k].y, p[k].z, normal.x, normal.y, normal.z, shaded.r, shaded.g, shaded.b};
+            dst = std::copy(v, v + 9, dst);
+        }
+    }
+}
+
+void VoxelChunk::writeQuads(const std::vector<Quad>& quads, std::vector<PackedVertex>& out) const {
+    const size_t at = out.size();
+    out.resize(at + quads.size() * 6);
+    PackedVertex* dst = out.data() + at;
+    for (const Quad& q : quads) {
+        glm::ivec3 c[4];
+        quadCorners(q, c);
+        for (int k : kTriangles[diagonal(q.ao)]) {
+            *dst++ = {uint32_t(c[k].x) | uint32_t(c[k].z) << 12 | uint32_t(q.dir) << 24,
+                      uint32_t(c[k].y) | uint32_t(q.material) << 16 | uint32_t((q.ao >> (2 * k)) & 3) << 24};
+        }
+    }
 }
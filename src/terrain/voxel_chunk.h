@@ -3,6 +3,9 @@
 #include <glm/glm.hpp>
 #include <cstdint>
 #include <functional>
+#include "noise.h"
+#include "voxel_bricks.h"
+#include "voxel_columns.h"
 
 struct VoxelChunk {
     // size
@@ -18,21 +21,187 @@ struct VoxelChunk {
     int   baseHeight = 16;
     int   heightAmp  = 24;
 
-    std::vector<uint8_t> vox; // sx * sy * sz
+    // false: two triangles per exposed voxel face; true: coplanar faces of the same
+    // material merged into maximal rectangles per slice (same surface, far fewer vertices)
+    bool greedy = false;
 
+    // Ambient occlusion per face corner from the three cells around it in front of
+    // the face (0..3, 3 = open); the greedy mesher then only merges faces whose
+    // corners match. The float layout darkens the color by occlusionShade().
+    bool occlusion = false;
+
+    // Dense: vox, one byte per cell. Columns: run-length columns, sized by the
+    // surface instead of the volume; an edit that brings in more materials than
+    // VoxelColumns::kMaxPalette turns the chunk Dense. Bricks: a sparse node/brick
+    // hierarchy, also sized by the surface, with constant-time cell access and edits.
+    enum class Storage { Dense, Columns, Bricks };
+    Storage storage = Storage::Dense;
+
+    std::vector<uint8_t> vox; // sx * sy * sz, Dense only
+    VoxelColumns columns;     // Columns only
+    VoxelBricks bricks;       // Bricks only
+
+    // Solid cells of the neighbouring chunks along this chunk's sides, so faces
+    // against a solid neighbour are culled: side[0] is the -X neighbour's x = sx-1
+    // column line (sz columns), side[1] the +X neighbour's x = 0 line, side[2] the
+    // -Z neighbour's z = sz-1 line (sx columns), side[3] the +Z neighbour's z = 0
+    // line. Each column is (sy + 63) / 64 occupancy words, bit (y & 63) of word
+    // y >> 6 set where the cell is solid; an empty side is air. Neighbours must share sx, sy and sz.
+    struct Neighbours {
+        std::vector<uint64_t> side[4];
+    };
+
+    // Packed vertex, 8 bytes against 36 for the float layout: chunk-local corner
+    // position, face direction (0..5: +Y, -Y, -X, +X, -Z, +Z), material and
+    // occlusion level. a = x | z << 12 | face << 24, b = y | material << 16 | level << 24.
+    // Decoded by voxel.vert.
+    struct PackedVertex {
+        uint32_t a = 0, b = 0;
+    };
+    static glm::vec3 materialColor(uint8_t material);
+    static float occlusionShade(int level) { return 0.55f + 0.15f * float(level); }
+
+    // Fills the storage and returns the surface as interleaved [pos, normal, color]
+    // floats, 9 per vertex, 3 vertices per triangle (GLMesh::uploadinterleavedPNC).
     std::vector<float> build();
+    // build() in two steps: generate() fills the storage, mesh() reads it only, so
+    // one generated chunk can be meshed (and read as a neighbour) from any thread
+    void generate();
+    std::vector<float> mesh(const Neighbours* neighbours = nullptr) const;
+
+    // The chunk is also split into kSection^3 sections (the last ones cut short)
+    // that can be meshed on their own, for edits. Section s = (ix * ny + iy) * nz + iz
+    // with (nx, ny, nz) = sectionGrid(). Faces never cross sections, so the greedy
+    // mesher merges a little less than mesh() does. Sections that are all air, or
+    // solid and closed in by solid cells, are skipped a column word at a time.
+    static constexpr int kSection = 16;
+    glm::ivec3 sectionGrid() const {
+        return {(sx + kSection - 1) / kSection, (sy + kSection - 1) / kSection, (sz + kSection - 1) / kSection};
+    }
+    int sectionCount() const { glm::ivec3 g = sectionGrid(); return g.x * g.y * g.z; }
+    // every section, back to back into out; sectionEnds[s] = vertices up to the end of s
+    void meshSections(const Neighbours* neighbours, std::vector<float>& out,
+                      std::vector<uint32_t>& sectionEnds) const;
+    void meshSections(const Neighbours* neighbours, std::vector<PackedVertex>& out,
+                      std::vector<uint32_t>& sectionEnds) const;
+    std::vector<float> meshSection(int section, const Neighbours* neighbours = nullptr) const;
+    void meshSection(int section, const Neighbours* neighbours, std::vector<PackedVertex>& out) const;
+
+    // Edits, in chunk-local cells after generate(); cells outside the chunk are
+    // skipped. Each marks the sections holding a changed cell or a cell next to
+    // one dirty, so an edit just past a side still dirties this chunk's border.
+    void setVoxel(int x,int y,int z, uint8_t material);
+    void fillBox(glm::ivec3 lo, glm::ivec3 hi, uint8_t material);      // cells in [lo, hi]
+    void fillSphere(glm::vec3 centre, float radius, uint8_t material); // cell centres within radius
+    // indices of the dirty sections; they are clean afterwards
+    std::vector<int> takeDirtySections();
+
+    // Occupancy of the column line on one of this chunk's own sides (0: x = 0,
+    // 1: x = sx-1, 2: z = 0, 3: z = sz-1), as a neighbour on that side needs it
+    // in its Neighbours (the chunk at -X takes side 0 of this one as its side[1]).
+    void edgeOccupancy(int side, std::vector<uint64_t>& out) const;
+
+    // material at a position inside the chunk, from either storage
+    uint8_t material(int x,int y,int z) const {
+        switch (storage) {
+        case Storage::Columns: return columns.at(x,y,z);
+        case Storage::Bricks:  return bricks.at(x,y,z);
+        default:               return vox[idx(x,y,z)];
+        }
+    }
+    // resident bytes of the voxel storage
+    size_t storageBytes() const {
+        switch (storage) {
+        case Storage::Columns: return columns.memoryBytes();
+        case Storage::Bricks:  return bricks.memoryBytes();
+        default:               return vox.capacity();
+        }
+    }
+
+    // First solid cell along a ray, by Amanatides-Woo DDA over the cells. Sections
+    // with no solid cell, and everything above the highest solid section, are
+    // crossed in one step; generate() and the edits keep that summary current.
+    struct RayHit {
+        glm::ivec3 cell{0};   // chunk-local here; VoxelWorld returns world cells
+        glm::ivec3 normal{0}; // of the face the ray entered through; zero if it starts inside
+        float distance = 0.f; // along dir
+        uint8_t material = 0; // 0: no hit
+    };
+    // origin in chunk-local voxel units, possibly outside the chunk; dir non-zero.
+    // Hits within maxDistance (in lengths of dir) only.
+    bool raycast(glm::vec3 origin, glm::vec3 dir, float maxDistance, RayHit& hit) const;
 
 private:
     inline int idx(int x,int y,int z) const { return x + sx*(z + sz*y); }
-    bool solid(int x,int y,int z) const {
-        if (x<0||x>=sx||y<0||y>=sy||z<0||z>=sz) return false;
-        return vox[idx(x,y,z)] != 0;
-    }
+    // Occupancy words (see Neighbours) of the columns [x0, x1) x [z0, z1), which may
+    // reach one column past the chunk's sides; those come from the neighbours, or
+    // are air. The meshers read solidity from here only.
+    struct ColumnRect {
+        int x0 = 0, z0 = 0, x1 = 0, z1 = 0, W = 1;
+        std::vector<uint64_t> words;
+        const uint64_t* at(int x, int z) const {
+            return words.data() + (size_t(x - x0) * (z1 - z0) + (z - z0)) * W;
+        }
+    };
+    void occupancy(ColumnRect& occ, const Neighbours* n) const;
+    // occupancy words of one column, either storage
+    void columnOccupancy(int x, int z, uint64_t* words) const;
+    // the cells of box [lo, hi) with the columns around it
+    ColumnRect occupancyAround(glm::ivec3 lo, glm::ivec3 hi, const Neighbours* n) const;
+    void sectionBox(int section, glm::ivec3& lo, glm::ivec3& hi) const;
+
+    std::vector<uint8_t> dirty; // per section
+    // cells [y0, y1] of column (x, z), both inside
+    void fillColumn(int x, int z, int y0, int y1, uint8_t material);
+    // Columns -> Dense, same cells; for a material the columns palette has no room for
+    void convertToDense();
+    // cells [lo, hi] changed: dirty their sections and their neighbours'
+    void markDirty(glm::ivec3 lo, glm::ivec3 hi);
+
+    std::vector<uint8_t> sectionSolid; // per section: whether any cell is solid
+    int solidTop = 0;                  // top of the highest section with a solid cell
+    // recomputes sectionSolid for the sections holding cells [lo, hi], then solidTop
+    void summarize(glm::ivec3 lo, glm::ivec3 hi);
+
+    Noise::GradientTable grad; // filled from seed at the start of build()
+
     glm::vec2 randGrad(int gx,int gy) const;
     float perlin(float x,float y) const;
     float heightRidged(float x,float z) const;
+    // heightRidged for n columns at (x[k], z[k]), all octaves in one Noise::ridgedBatch
+    void  heightRidgedRow(const float* x, const float* z, float* out, int n) const;
+
+    void fillVoxels();
+    // whether the cells in [lo, hi) have no faces: all air, or all solid with solid
+    // cells all around
+    bool hidden(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi) const;
+    // A rectangle of w x h faces of direction dir (+Y, -Y, -X, +X, -Z, +Z), along the
+    // direction's u and v axes from cell (chunk-local). ao holds the occlusion level
+    // of corner k (a, b, c, d) in bits 2k..2k+1.
+    struct Quad {
+        glm::ivec3 cell;
+        uint8_t dir, material, ao;
+        uint16_t w, h;
+    };
+    static constexpr uint8_t kOpen = 0xFF; // every corner at level 3
+    bool solid(const ColumnRect& occ, glm::ivec3 p) const {
+        return p.y >= 0 && p.y < sy && ((occ.at(p.x, p.z)[p.y >> 6] >> (p.y & 63)) & 1) != 0;
+    }
+    uint8_t cornerOcclusion(const ColumnRect& occ, glm::ivec3 cell, int dir) const;
+
+    // append the faces of the cells in [lo, hi) to quads
+    void meshBox(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const;
+    void meshNaive(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const;
+    void meshGreedy(const ColumnRect& occ, glm::ivec3 lo, glm::ivec3 hi, std::vector<Quad>& quads) const;
+    template <class Vertex>
+    void meshSectionsInto(const Neighbours* neighbours, std::vector<Vertex>& out,
+                          std::vector<uint32_t>& sectionEnds) const;
+    // append two triangles per quad
+    void writeQuads(const std::vector<Quad>& quads, std::vector<float>& out) const;
+    void writeQuads(const std::vector<Quad>& quads, std::vector<PackedVertex>& out) const;
 
-    void emitFace(std::vector<float>& out,
-                  glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d,
-                  glm::vec3 n, glm::vec3 col);
+    // one face in the float layout into preallocated memory; returns the end of the written floats
+    static float* writeFace(float* dst,
+                            glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d,
+                            glm::vec3 n, glm::vec3 col);
 };
@@ -0,0 +1,123 @@
+#include "voxel_columns.h"
+#include <algorithm>
+#include <cassert>
+
+void VoxelColumns::reset(int sx, int sy, int sz){
+    assert(sy <= kMaxHeight);
+    m_sx = sx; m_sy = sy; m_sz = sz;
+    m_palette.assign(1, 0);
+    m_start.assign(size_t(sx) * sz + 1, 0);
+    m_runs.clear();
+    m_appended = 0;
+}
+
+int VoxelColumns::paletteIndex(uint8_t material){
+    auto it = std::find(m_palette.begin(), m_palette.end(), material);
+    if (it != m_palette.end()) return int(it - m_palette.begin());
+    // the index has 4 bits in a run
+    if (int(m_palette.size()) >= kMaxPalette) return -1;
+    m_palette.push_back(material);
+    return int(m_palette.size()) - 1;
+}
+
+bool VoxelColumns::encode(const uint8_t* cells, std::vector<uint16_t>& runs){
+    runs.clear();
+    int top = m_sy - 1;
+    while (top >= 0 && cells[top] == 0) top--; // air on top stays implicit
+    for (int y = 0; y <= top; y++) {
+        if (y == top || cells[y + 1] != cells[y]) {
+            const int index = paletteIndex(cells[y]);
+            if (index < 0) return false;
+            runs.push_back(pack(y, index));
+        }
+    }
+    return true;
+}
+
+bool VoxelColumns::setColumn(int x, int z, const uint8_t* cells){
+    const int c = column(x, z);
+    const size_t paletteSize = m_palette.size();
+    if (!encode(cells, m_scratch)) {
+        m_palette.resize(paletteSize); // drop what this column added
+        return false;
+    }
+
+    // m_start is only valid up to m_appended; the columns after it are empty
+    if (c == m_appended && m_appended < int(m_start.size()) - 1) {
+        m_runs.insert(m_runs.end(), m_scratch.begin(), m_scratch.end());
+        m_appended++;
+        m_start[m_appended] = uint32_t(m_runs.size());
+        return true;
+    }
+    for (size_t k = size_t(m_appended) + 1; k < m_start.size(); k++)
+        m_start[k] = uint32_t(m_runs.size());
+    m_appended = int(m_start.size()) - 1;
+
+    const uint32_t begin = m_start[c], end = m_start[c + 1];
+    const std::ptrdiff_t delta = std::ptrdiff_t(m_scratch.size()) - std::ptrdiff_t(end - begin);
+    if (delta > 0)
+        m_runs.insert(m_runs.begin() + end, size_t(delta), 0);
+    else if (delta < 0)
+        m_runs.erase(m_runs.begin() + end + delta, m_runs.begin() + end);
+    std::copy(m_scratch.begin(), m_scratch.end(), m_runs.begin() + begin);
+    if (delta != 0)
+        for (size_t k = size_t(c) + 1; k < m_start.size(); k++)
+            m_start[k] = uint32_t(std::ptrdiff_t(m_start[k]) + delta);
+    return true;
+}
+
+bool VoxelColumns::set(int x, int y, int z, uint8_t material){
+    std::vector<uint8_t> cells(m_sy);
+    getColumn(x, z, cells.data());
+    cells[y] = material;
+    return setColumn(x, z, cells.data());
+}
+
+uint8_t VoxelColumns::at(int x, int y, int z) const{
+    const int c = column(x, z);
+    if (c >= m_appended) return 0;
+    const uint16_t* first = m_runs.data() + m_start[c];
+    const uint16_t* last  = m_runs.data() + m_start[c + 1];
+    // first run reaching up to y
+    const uint16_t* run = std::lower_bound(first, last, y,
+                                           [](uint16_t r, int v) { return topOf(r) < v; });
+    return run == last ? 0 : m_palette[indexOf(*run)];
+}
+
+void VoxelColumns::getColumn(int x, int z, uint8_t* cells) const{
+    std::fill(cells, cells + m_sy, 0);
+    const int c = column(x, z);
+    if (c >= m_appended) return;
+    int y = 0;
+    for (uint32_t r = m_start[c]; r < m_start[c + 1]; r++) {
+        const int top = topOf(m_runs[r]);
+        std::fill(cells + y, cells + top + 1, m_palette[indexOf(m_runs[r])]);
+        y = top + 1;
+    }
+}
+
+void VoxelColumns::occupancy(int x, int z, uint64_t* words) const{
+    const int n = wordsPerColumn();
+    std::fill(words, words + n, 0);
+    const int c = column(x, z);
+    if (c >= m_appended) return;
+    int y = 0;
+    for (uint32_t r = m_start[c]; r < m_start[c + 1]; r++) {
+        const int top = topOf(m_runs[r]);
+        if (indexOf(m_runs[r]) != 0) {
+            // bits [y, top]
+            for (int w = y >> 6; w <= top >> 6; w++) {
+                const int lo = std::max(y, w * 64) - w * 64;
+                const int hi = std::min(top, w * 64 + 63) - w * 64;
+                const uint64_t upper = hi == 63 ? ~0ull : (1ull << (hi + 1)) - 1;
+                words[w] |= upper & ~((1ull << lo) - 1);
+            }
+        }
+        y = top + 1;
+    }
+}
+
+size_t VoxelColumns::memoryBytes() const{
+    return m_runs.capacity() * sizeof(uint16_t) + m_start.capacity() * sizeof(uint32_t) +
+           m_palette.capacity();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Run-length voxel storage: each (x, z) column is a list of runs from the bottom
+// up, 16 bits per run (top y, palette index), and the air above the last run is
+// implicit. A heightmap column is one or two runs, so memory grows with the
+// number of material changes along y rather than with the volume.
+//
+// Materials go through a palette of at most kMaxPalette entries, entry 0 being
+// air (material 0); entries are never released. A write that needs one more
+// material than that fails and leaves the column as it was. Columns are at most
+// kMaxHeight cells tall.
+class VoxelColumns
+{
+public:
+    static constexpr int kMaxPalette = 16;
+    static constexpr int kMaxHeight  = 4096;
+
+    // all air
+    void reset(int sx, int sy, int sz);
+
+    int sizeX() const { return m_sx; }
+    int sizeY() const { return m_sy; }
+    int sizeZ() const { return m_sz; }
+
+    // Replaces column (x, z) with cells[0..sizeY()), bottom to top. Columns written
+    // in order (x outer, z inner) are appended; others are spliced in place.
+    // Returns false, changing nothing, when the palette has no room for a material.
+    bool setColumn(int x, int z, const uint8_t *cells);
+    // single cell edit (re-encodes the column); false as for setColumn
+    bool set(int x, int y, int z, uint8_t material);
+
+    // material at (x, y, z); the position must lie inside
+    uint8_t at(int x, int y, int z) const;
+    // setColumn's inverse: cells[0..sizeY()) of column (x, z), bottom to top
+    void getColumn(int x, int z, uint8_t *cells) const;
+
+    // Occupancy of column (x, z): bit (y & 63) of words[y >> 6] is set where the
+    // cell is solid. words holds wordsPerColumn() entries.
+    int wordsPerColumn() const { return (m_sy + 63) / 64; }
+    void occupancy(int x, int z, uint64_t *words) const;
+
+    // resident bytes (runs, column offsets and palette)
+    size_t memoryBytes() const;
+
+private:
+    static uint16_t pack(int top, int index) { return uint16_t((top << 4) | index); }
+    static int topOf(uint16_t run) { return run >> 4; }
+    static int indexOf(uint16_t run) { return run & 15; }
+
+    int column(int x, int z) const { return x * m_sz + z; }
+    // -1 when material is new and the palette is full
+    int paletteIndex(uint8_t material);
+    bool encode(const uint8_t *cells, std::vector<uint16_t> &runs);
+
+    int m_sx = 0, m_sy = 0, m_sz = 0;
+    std::vector<uint8_t>  m_palette = {0}; // palette index -> material
+    std::vector<uint32_t> m_start;         // runs of column c: [m_start[c], m_start[c + 1])
+    std::vector<uint16_t> m_runs;
+    int m_appended = 0;                    // columns written so far in append order
+    std::vector<uint16_t> m_scratch;
+};
@@ -0,0 +1,362 @@
+#include "voxel_world.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "utils/parallel.h"
+
+namespace {
+
+// the neighbour on side s of a chunk (VoxelChunk::Neighbours order), and the side
+// of that neighbour which faces back
+constexpr int kSideDx[4] = {-1, 1, 0, 0};
+constexpr int kSideDz[4] = {0, 0, -1, 1};
+constexpr int kFacingSide[4] = {1, 0, 3, 2};
+
+int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+} // namespace
+
+VoxelWorld::~VoxelWorld()
+{
+    stop();
+}
+
+void VoxelWorld::start(int threads)
+{
+    if (running()) return;
+    if (threads <= 0) threads = std::max(1, ParallelUtils::defaultWorkerCount() - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = false;
+    }
+    m_workers.reserve(threads);
+    for (int i = 0; i < threads; i++) {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+void VoxelWorld::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+    for (std::thread &t : m_workers) t.join();
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_busy.clear();
+    m_generated.clear();
+    m_meshes.clear();
+}
+
+void VoxelWorld::configure(const VoxelChunk &params, int radius)
+{
+    m_params = params;
+    m_params.origin = glm::ivec3(0);
+    m_radius = std::max(0, radius);
+    m_chunks.clear();
+    m_sections.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workerParams = m_params;
+    m_generation++;
+
+    // in-flight work notices the generation change and throws its result away
+    m_queue.clear();
+    m_busy.clear();
+    m_generated.clear();
+    m_meshes.clear();
+}
+
+void VoxelWorld::update(const glm::vec3 &eye)
+{
+    // 1) take over the chunks generated since the last frame
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Generated &g : m_generated) {
+            m_chunks[g.coord].chunk = std::move(g.chunk);
+            m_busy.erase(g.coord);
+        }
+        m_generated.clear();
+    }
+
+    const ChunkCoord centre{int(std::floor(eye.x / float(m_params.sx))),
+                            int(std::floor(eye.z / float(m_params.sz)))};
+    auto ring = [&](ChunkCoord c) { return std::max(std::abs(c.x - centre.x), std::abs(c.z - centre.z)); };
+
+    // 2) forget chunks past the generated ring, with one ring of slack so moving
+    //    back and forth across a chunk border does not regenerate anything
+    for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+        if (ring(it->first) > m_radius + 2) it = m_chunks.erase(it);
+        else ++it;
+    }
+
+    // 3) generate out to one ring past the meshing radius, so every chunk inside it
+    //    has its neighbours; mesh the ones that have them. At equal distance a
+    //    chunk's generation goes before meshes.
+    m_scratch.clear();
+    const int reach = m_radius + 1;
+    for (int dz = -reach; dz <= reach; dz++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+            const ChunkCoord c{centre.x + dx, centre.z + dz};
+            const int priority = 2 * (dx * dx + dz * dz);
+            auto it = m_chunks.find(c);
+            if (it == m_chunks.end()) {
+                m_scratch.push_back({priority, Job{c, nullptr, {}, 0}});
+                continue;
+            }
+            if (it->second.meshed || ring(c) > m_radius) continue;
+
+            Job job{c, it->second.chunk, {}, it->second.version};
+            bool ready = true;
+            for (int s = 0; s < 4 && ready; s++) {
+                auto n = m_chunks.find(ChunkCoord{c.x + kSideDx[s], c.z + kSideDz[s]});
+                ready = n != m_chunks.end();
+                if (ready) job.neighbours[s] = n->second.chunk;
+            }
+            if (ready) m_scratch.push_back({priority + 1, std::move(job)});
+        }
+    }
+    std::sort(m_scratch.begin(), m_scratch.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+        for (auto &[priority, job] : m_scratch) {
+            if (!m_busy.count(job.coord)) m_queue.push_back(std::move(job));
+        }
+    }
+    m_scratch.clear();
+    m_cv.notify_all();
+}
+
+bool VoxelWorld::poll(MeshResult &out)
+{
+    for (;;) {
+        uint32_t version;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_meshes.empty()) return false;
+            out = std::move(m_meshes.front().mesh);
+            version = m_meshes.front().version;
+            m_meshes.pop_front();
+            m_busy.erase(out.coord);
+        }
+        // chunks forgotten while they were being meshed are dropped here, and meshes
+        // of chunks edited since; the next update() meshes the edited chunk again
+        auto it = m_chunks.find(out.coord);
+        if (it == m_chunks.end() || it->second.version != version) continue;
+        it->second.meshed = true;
+        return true;
+    }
+}
+
+bool VoxelWorld::pollSection(SectionMesh &out)
+{
+    if (m_sections.empty()) return false;
+    out = std::move(m_sections.front());
+    m_sections.pop_front();
+    return true;
+}
+
+void VoxelWorld::setVoxel(const glm::ivec3 &p, uint8_t material)
+{
+    fillBox(p, p, material);
+}
+
+void VoxelWorld::fillBox(const glm::ivec3 &lo, const glm::ivec3 &hi, uint8_t material)
+{
+    edit(lo, hi, [&](VoxelChunk &c) { c.fillBox(lo - c.origin, hi - c.origin, material); });
+}
+
+void VoxelWorld::fillSphere(const glm::vec3 &centre, float radius, uint8_t material)
+{
+    const glm::ivec3 lo(glm::floor(centre - radius)), hi(glm::ceil(centre + radius));
+    edit(lo, hi, [&](VoxelChunk &c) { c.fillSphere(centre - glm::vec3(c.origin), radius, material); });
+}
+
+template <class Edit>
+void VoxelWorld::edit(const glm::ivec3 &lo, const glm::ivec3 &hi, Edit &&edit)
+{
+    // a chunk's faces also depend on the cells one past its sides
+    const int cx0 = floorDiv(lo.x - 1, m_params.sx), cx1 = floorDiv(hi.x + 1, m_params.sx);
+    const int cz0 = floorDiv(lo.z - 1, m_params.sz), cz1 = floorDiv(hi.z + 1, m_params.sz);
+
+    std::vector<std::pair<ChunkCoord, std::vector<int>>> edited;
+    for (int cz = cz0; cz <= cz1; cz++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            auto it = m_chunks.find(ChunkCoord{cx, cz});
+            if (it == m_chunks.end()) continue;
+            // the workers may still be reading the old chunk
+            auto chunk = std::make_shared<VoxelChunk>(*it->second.chunk);
+            edit(*chunk);
+            std::vector<int> dirty = chunk->takeDirtySections();
+            if (dirty.empty()) continue;
+            it->second.chunk = std::move(chunk);
+            it->second.version++;
+            edited.push_back({it->first, std::move(dirty)});
+        }
+    }
+
+    // remesh once every copy is in, so the sides see the edited neighbours
+    VoxelChunk::Neighbours neighbours;
+    for (auto &[c, dirty] : edited) {
+        Entry &e = m_chunks[c];
+        if (!e.meshed) continue;
+        bool complete = true;
+        for (int s = 0; s < 4 && complete; s++) {
+            auto n = m_chunks.find(ChunkCoord{c.x + kSideDx[s], c.z + kSideDz[s]});
+            complete = n != m_chunks.end();
+            if (complete) n->second.chunk->edgeOccupancy(kFacingSide[s], neighbours.side[s]);
+        }
+        if (!complete) {
+            // only past the meshing radius, where the mesh is on its way out anyway
+            e.meshed = false;
+            continue;
+        }
+        for (int s : dirty) {
+            m_sections.push_back({c, s, {}});
+            e.chunk->meshSection(s, &neighbours, m_sections.back().vertices);
+        }
+    }
+}
+
+bool VoxelWorld::hasMesh(ChunkCoord c) const
+{
+    auto it = m_chunks.find(c);
+    return it != m_chunks.end() && it->second.meshed;
+}
+
+bool VoxelWorld::raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxDistance,
+                         VoxelChunk::RayHit &hit) const
+{
+    ChunkLookup last;
+    return castRay(Ray{origin, dir, maxDistance}, hit, last);
+}
+
+int VoxelWorld::raycast(const Ray *rays, int n, VoxelChunk::RayHit *hits) const
+{
+    // nearby rays mostly start and end in the same chunk
+    ChunkLookup last;
+    int count = 0;
+    for (int k = 0; k < n; k++) {
+        hits[k] = VoxelChunk::RayHit{};
+        if (castRay(rays[k], hits[k], last)) count++;
+    }
+    return count;
+}
+
+const VoxelChunk *VoxelWorld::chunkAt(ChunkCoord c, ChunkLookup &last) const
+{
+    if (!last.valid || !(last.coord == c)) {
+        auto it = m_chunks.find(c);
+        last = {c, it == m_chunks.end() ? nullptr : it->second.chunk.get(), true};
+    }
+    return last.chunk;
+}
+
+bool VoxelWorld::castRay(const Ray &ray, VoxelChunk::RayHit &hit, ChunkLookup &last) const
+{
+    const float length = glm::length(ray.dir);
+    if (!(length > 0.f)) return false;
+    const glm::vec3 o = ray.origin, d = ray.dir / length;
+    const int sx = m_params.sx, sy = m_params.sy, sz = m_params.sz;
+
+    // the world is one chunk tall: a ray passing over or under it is done here
+    float t0 = 0.f, t1 = ray.maxDistance;
+    if (d.y == 0.f) {
+        if (o.y < 0.f || o.y >= float(sy)) return false;
+    } else {
+        float a = -o.y / d.y, b = (float(sy) - o.y) / d.y;
+        if (a > b) std::swap(a, b);
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+    }
+    if (t0 > t1) return false;
+
+    // the chunk columns along the ray, by DDA over the chunk grid; each chunk
+    // clips the ray to itself
+    const glm::vec3 p = o + d * t0;
+    ChunkCoord c{floorDiv(int(std::floor(p.x)), sx), floorDiv(int(std::floor(p.z)), sz)};
+    const int stepX = d.x > 0.f ? 1 : (d.x < 0.f ? -1 : 0);
+    const int stepZ = d.z > 0.f ? 1 : (d.z < 0.f ? -1 : 0);
+    float tMaxX = stepX ? (float((c.x + (stepX > 0)) * sx) - o.x) / d.x : INFINITY;
+    float tMaxZ = stepZ ? (float((c.z + (stepZ > 0)) * sz) - o.z) / d.z : INFINITY;
+    const float tDeltaX = stepX ? float(sx) / std::abs(d.x) : INFINITY;
+    const float tDeltaZ = stepZ ? float(sz) / std::abs(d.z) : INFINITY;
+    for (;;) {
+        if (const VoxelChunk *chunk = chunkAt(c, last)) {
+            const glm::ivec3 at = origin(c);
+            if (chunk->raycast(o - glm::vec3(at), d, t1, hit)) {
+                hit.cell += at;
+                return true;
+            }
+        }
+        if (std::min(tMaxX, tMaxZ) > t1) return false;
+        if (tMaxX < tMaxZ) {
+            c.x += stepX;
+            tMaxX += tDeltaX;
+        } else {
+            c.z += stepZ;
+            tMaxZ += tDeltaZ;
+        }
+    }
+}
+
+int VoxelWorld::outstanding() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return int(m_queue.size() + m_busy.size());
+}
+
+void VoxelWorld::workerLoop()
+{
+    VoxelChunk params;
+    uint64_t paramsGeneration = ~uint64_t(0);
+    VoxelChunk::Neighbours neighbours;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_stop) return;
+
+        Job job = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_busy.insert(job.coord);
+
+        const uint64_t generation = m_generation;
+        if (paramsGeneration != generation) {
+            params = m_workerParams;
+            paramsGeneration = generation;
+        }
+        lock.unlock();
+
+        if (!job.chunk) {
+            auto chunk = std::make_shared<VoxelChunk>(params);
+            chunk->origin = glm::ivec3(job.coord.x * params.sx, 0, job.coord.z * params.sz);
+            chunk->generate();
+
+            lock.lock();
+            // configure() already cleared m_busy for stale work
+            if (generation == m_generation && !m_stop) m_generated.push_back({job.coord, std::move(chunk)});
+            continue;
+        }
+
+        for (int s = 0; s < 4; s++) job.neighbours[s]->edgeOccupancy(kFacingSide[s], neighbours.side[s]);
+        PendingMesh r;
+        r.mesh.coord = job.coord;
+        r.version = job.version;
+        job.chunk->meshSections(&neighbours, r.mesh.vertices, r.mesh.sectionEnds);
+        // the last references to forgotten chunks may be dropped here, outside the lock
+        job = Job{};
+
+        lock.lock();
+        if (generation == m_generation && !m_stop) m_meshes.push_back(std::move(r));
+    }
+}
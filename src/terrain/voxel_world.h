@@ -0,0 +1,162 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+#include "voxel_chunk.h"
+
+// A voxel landscape of chunks streamed in around the camera.
+//
+// Chunks tile the xz plane (chunk (x, z) has origin (x * sx, 0, z * sz), one chunk
+// tall) and are generated, then meshed, by worker threads, nearest first. A chunk is
+// only meshed once its four neighbours exist, so faces between two solid chunks are
+// culled like faces inside one. Generated chunks are immutable and shared with the
+// workers (an edit replaces a chunk with an edited copy); everything but the workers
+// runs on the caller's thread. Nothing here touches OpenGL: the render thread polls
+// finished meshes and uploads them itself.
+class VoxelWorld
+{
+public:
+    struct ChunkCoord {
+        int x = 0, z = 0;
+        bool operator==(const ChunkCoord &o) const { return x == o.x && z == o.z; }
+    };
+    struct ChunkCoordHash {
+        size_t operator()(const ChunkCoord &c) const {
+            return (size_t(uint32_t(c.x)) << 32) ^ size_t(uint32_t(c.z));
+        }
+    };
+
+    // vertices are VoxelChunk::PackedVertex, relative to the chunk's origin
+    struct MeshResult {
+        ChunkCoord coord;
+        std::vector<VoxelChunk::PackedVertex> vertices;
+        std::vector<uint32_t> sectionEnds; // VoxelChunk::meshSections()
+    };
+    // the new vertices of one section of a chunk whose mesh was handed out
+    struct SectionMesh {
+        ChunkCoord coord;
+        int section = 0;
+        std::vector<VoxelChunk::PackedVertex> vertices;
+    };
+
+    VoxelWorld() = default;
+    ~VoxelWorld();
+    VoxelWorld(const VoxelWorld &) = delete;
+    VoxelWorld &operator=(const VoxelWorld &) = delete;
+
+    // Starts the worker threads (0 = hardware concurrency - 1, at least one).
+    void start(int threads = 0);
+    // Joins the workers; queued and unfinished work is dropped, chunks are kept.
+    void stop();
+    bool running() const { return !m_workers.empty(); }
+
+    // New chunk parameters (size, noise, mesher and storage; origin is ignored) and
+    // meshing radius in chunks around the camera. Drops every chunk and all work
+    // for the old configuration.
+    void configure(const VoxelChunk &params, int radius);
+    const VoxelChunk &params() const { return m_params; }
+    glm::ivec3 origin(ChunkCoord c) const { return {c.x * m_params.sx, 0, c.z * m_params.sz}; }
+
+    // Once per frame, eye in voxel units: takes over generated chunks, forgets far
+    // ones and reschedules the work around the eye, nearest first.
+    void update(const glm::vec3 &eye);
+
+    // Non-blocking: hands over one finished mesh of a chunk still in the world.
+    bool poll(MeshResult &out);
+    // Whether the chunk is in the world and its mesh was handed out by poll();
+    // a renderer drops its copy once this turns false.
+    bool hasMesh(ChunkCoord c) const;
+
+    // Edits in voxel units, on the chunks in the world (cells of chunks not generated
+    // yet are left alone, and edits are lost once their chunk is forgotten). Meshed
+    // chunks get the touched sections remeshed right away, handed out by
+    // pollSection(); the others are meshed (again) by the workers.
+    void setVoxel(const glm::ivec3 &p, uint8_t material);
+    void fillBox(const glm::ivec3 &lo, const glm::ivec3 &hi, uint8_t material); // cells in [lo, hi]
+    void fillSphere(const glm::vec3 &centre, float radius, uint8_t material);
+    // Non-blocking: hands over one remeshed section, in edit order. Apply them after
+    // the meshes from poll(); they may name chunks the renderer already dropped.
+    bool pollSection(SectionMesh &out);
+
+    // Ray queries in voxel units: chunk by chunk along the ray (VoxelChunk::raycast),
+    // nearest first; chunks not generated yet count as air, and so does everything
+    // above and below the world. dir need not be normalised: distances are in
+    // voxels, up to a finite maxDistance. Hit cells are world cells.
+    struct Ray {
+        glm::vec3 origin{0.f}, dir{0.f, 0.f, 1.f};
+        float maxDistance = 0.f;
+    };
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxDistance, VoxelChunk::RayHit &hit) const;
+    // Many rays at once (e.g. a particle system's collision pass), reusing chunk
+    // lookups between rays; hits[k].material is 0 where ray k hits nothing.
+    // Returns the number of hits.
+    int raycast(const Ray *rays, int n, VoxelChunk::RayHit *hits) const;
+
+    // queued + in flight + finished but not yet taken over or polled
+    int outstanding() const;
+    size_t chunkCount() const { return m_chunks.size(); }
+
+private:
+    struct Entry {
+        std::shared_ptr<const VoxelChunk> chunk;
+        bool meshed = false;
+        uint32_t version = 0; // bumped by every edit of the chunk
+    };
+    // generates the chunk when chunk is null, meshes it otherwise
+    struct Job {
+        ChunkCoord coord;
+        std::shared_ptr<const VoxelChunk> chunk;
+        std::shared_ptr<const VoxelChunk> neighbours[4]; // -X, +X, -Z, +Z
+        uint32_t version = 0;
+    };
+    struct Generated {
+        ChunkCoord coord;
+        std::shared_ptr<const VoxelChunk> chunk;
+    };
+    struct PendingMesh {
+        MeshResult mesh;
+        uint32_t version = 0; // of the chunk it was made from
+    };
+
+    void workerLoop();
+    // the chunk raycasts last looked up
+    struct ChunkLookup {
+        ChunkCoord coord;
+        const VoxelChunk *chunk = nullptr;
+        bool valid = false;
+    };
+    const VoxelChunk *chunkAt(ChunkCoord c, ChunkLookup &last) const;
+    bool castRay(const Ray &ray, VoxelChunk::RayHit &hit, ChunkLookup &last) const;
+    // Applies edit to a copy of every chunk whose cells in [lo, hi] (or next to
+    // them) it may change, then remeshes the dirty sections of the meshed ones.
+    template <class Edit>
+    void edit(const glm::ivec3 &lo, const glm::ivec3 &hi, Edit &&edit);
+
+    // caller's thread only
+    VoxelChunk m_params;
+    int m_radius = 6;
+    std::unordered_map<ChunkCoord, Entry, ChunkCoordHash> m_chunks;
+    std::vector<std::pair<int, Job>> m_scratch;
+    std::deque<SectionMesh> m_sections;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+
+    VoxelChunk m_workerParams;  // m_params as the workers see it
+    uint64_t m_generation = 0; // bumped by configure()
+
+    std::deque<Job> m_queue;
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_busy; // in flight or finished
+    std::deque<Generated> m_generated;
+    std::deque<PendingMesh> m_meshes;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+// View-frustum planes for box culling.
+//
+// fromMatrix takes a full clip-from-space matrix (proj * view * model); the planes
+// then live in that model's space, so boxes can be tested in their own local
+// coordinates without transforming them first.
+struct Frustum
+{
+    glm::vec4 planes[6]; // (n, d): inside where dot(n, p) + d >= 0; not normalized
+
+    static Frustum fromMatrix(const glm::mat4 &clip)
+    {
+        // Gribb/Hartmann: combinations of the rows of the clip matrix
+        auto row = [&](int i) { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+        Frustum f;
+        f.planes[0] = row(3) + row(0); // left
+        f.planes[1] = row(3) - row(0); // right
+        f.planes[2] = row(3) + row(1); // bottom
+        f.planes[3] = row(3) - row(1); // top
+        f.planes[4] = row(3) + row(2); // near
+        f.planes[5] = row(3) - row(2); // far
+        return f;
+    }
+
+    // false only when the box is entirely outside one plane (conservative)
+    bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        for (const glm::vec4 &p : planes) {
+            // the corner furthest along the plane normal
+            glm::vec3 v(p.x >= 0.f ? boxMax.x : boxMin.x,
+                        p.y >= 0.f ? boxMax.y : boxMin.y,
+                        p.z >= 0.f ? boxMax.z : boxMin.z);
+            if (p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0.f) return false;
+        }
+        return true;
+    }
+};
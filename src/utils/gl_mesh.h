@@ -2,6 +2,7 @@
 #include <GL/glew.h>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 
 // Interleaved vertex: position(3) + normal(3)
 // fitting our lab8 tessellation design
@@ -80,6 +81,30 @@ struct GLMesh{
         glBindVertexArray(0);
     }
 
+    // Draws the instance ranges [firsts[i], firsts[i] + counts[i]) of a tightly
+    // packed mat4 instance attribute at locations loc..loc+3 read from instanceVbo.
+    // GL 4.1 has no base instance, so the attribute is re-pointed per range and
+    // left at instance 0 afterwards.
+    void drawInstancedRanges(GLuint instanceVbo, GLuint loc,
+                             const std::vector<GLuint> &firsts, const std::vector<GLsizei> &counts) const {
+        if (firsts.empty()) return;
+        const GLsizei stride = 16 * sizeof(GLfloat);
+        auto pointAt = [&](size_t first) {
+            for (GLuint i = 0; i < 4; i++)
+                glVertexAttribPointer(loc + i, 4, GL_FLOAT, GL_FALSE, stride,
+                                      reinterpret_cast<void*>(first * stride + i * 4 * sizeof(GLfloat)));
+        };
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        for (size_t r = 0; r < firsts.size(); r++) {
+            pointAt(firsts[r]);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, counts[r]);
+        }
+        pointAt(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
     void destroy() {
         if(vbo) glDeleteBuffers(1, &vbo);
         if (vao) glDeleteVertexArrays(1, &vao);
@@ -88,4 +113,296 @@ struct GLMesh{
     }
 };
 
+// Packed voxel vertex: two words decoded in voxel.vert = 8B
+// (e.g. VoxelChunk::PackedVertex)
+struct GLVertexVoxel {
+    GLuint a, b;
+};
+
+// GLVertexVoxel vertices split into sections (e.g. a voxel chunk's
+// VoxelChunk::meshSections()), each with room to grow, so one section can be
+// replaced in place with glBufferSubData. All sections go in one glMultiDrawArrays.
+struct GLSectionedMesh{
+    GLuint vao = 0, vbo = 0;
+    std::vector<GLint>   first;    // per section, in vertices
+    std::vector<GLsizei> count;
+    std::vector<GLsizei> capacity;
+    GLsizei vertexCapacity = 0;    // of the whole buffer
+
+    static constexpr GLsizei kStride = sizeof(GLVertexVoxel);
+
+    // vertices: the sections back to back; sectionEnds[s] = vertices up to the end of s
+    void upload(const void *vertices, const std::vector<uint32_t> &sectionEnds){
+        if (vao || vbo) destroy();
+        const size_t n = sectionEnds.size();
+        first.resize(n); count.resize(n); capacity.resize(n);
+        vertexCapacity = 0;
+        for (size_t s = 0; s < n; s++) {
+            count[s] = GLsizei(sectionEnds[s] - (s ? sectionEnds[s - 1] : 0));
+            capacity[s] = headroom(count[s]);
+            first[s] = vertexCapacity;
+            vertexCapacity += capacity[s];
+        }
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertexCapacity) * kStride, nullptr, GL_DYNAMIC_DRAW);
+        const char *bytes = static_cast<const char*>(vertices);
+        for (size_t s = 0; s < n; s++) {
+            const size_t from = s ? sectionEnds[s - 1] : 0;
+            if (count[s] > 0)
+                glBufferSubData(GL_ARRAY_BUFFER, GLintptr(first[s]) * kStride, GLsizeiptr(count[s]) * kStride,
+                                bytes + from * kStride);
+        }
+        pointAttributes();
+        glBindVertexArray(0);
+    }
+
+    // Replaces section s with n vertices. Only its bytes are uploaded while it fits
+    // its room; otherwise the buffer is reallocated and the other sections copied
+    // over on the GPU.
+    void updateSection(int s, const void *vertices, size_t n){
+        if (!vbo || s < 0 || s >= int(count.size())) return;
+        if (GLsizei(n) > capacity[s]) grow(s, headroom(GLsizei(n)));
+        count[s] = GLsizei(n);
+        if (n > 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, GLintptr(first[s]) * kStride, GLsizeiptr(n) * kStride, vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
 
+    void draw() const {
+        if (!vao) return;
+        glBindVertexArray(vao);
+        glMultiDrawArrays(GL_TRIANGLES, first.data(), count.data(), GLsizei(count.size()));
+        glBindVertexArray(0);
+    }
+
+    void destroy() {
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (vao) glDeleteVertexArrays(1, &vao);
+        vao = vbo = 0;
+        first.clear(); count.clear(); capacity.clear();
+        vertexCapacity = 0;
+    }
+
+private:
+    // a quarter more, and four quads for sections that start out empty
+    static GLsizei headroom(GLsizei n) { return n + n / 4 + 24; }
+
+    void pointAttributes() {
+        glEnableVertexAttribArray(0); // a_packed, integer: no conversion to float
+        glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, kStride, (void*)0);
+    }
+
+    // section s gets room for cap vertices; the others keep theirs
+    void grow(int s, GLsizei cap) {
+        GLuint fresh = 0;
+        glGenBuffers(1, &fresh);
+        glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, fresh);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(vertexCapacity - capacity[s] + cap) * kStride,
+                     nullptr, GL_DYNAMIC_DRAW);
+        GLint at = 0;
+        for (size_t k = 0; k < count.size(); k++) {
+            if (int(k) == s) capacity[k] = cap;
+            else if (count[k] > 0)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(first[k]) * kStride,
+                                    GLintptr(at) * kStride, GLsizeiptr(count[k]) * kStride);
+            first[k] = at;
+            at += capacity[k];
+        }
+        vertexCapacity = at;
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &vbo);
+        vbo = fresh;
+
+        // the VAO still points at the old buffer
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        pointAttributes();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+// Packed terrain vertex: position(3 float) + octahedral normal(2 snorm16) = 16B
+struct GLVertexPOct {
+    GLfloat x, y, z;      // position
+    GLshort ox, oy;       // octahedral normal
+};
+
+// Shared-vertex mesh drawn with glDrawElements.
+// Indices are narrowed to GL_UNSIGNED_SHORT when every vertex fits in 16 bits.
+struct GLIndexedMesh{
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t byteSize = 0; // vertex + index buffer storage, for memory budgets
+
+    // vertices: tightly packed GLVertexPOct array (e.g. TerrainGenerator::TerrainVertex)
+    void uploadPackedPOct(const void *vertices, size_t vertexCount,
+                          const std::vector<uint32_t> &indices){
+        uploadPackedPOct(vertices, vertexCount, indices.data(), indices.size());
+    }
+
+    // same, from raw index memory (e.g. a mapped file)
+    void uploadPackedPOct(const void *vertices, size_t vertexCount,
+                          const uint32_t *indices, size_t indexCountIn){
+        if (vao || vbo || ebo) destroy();
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     vertexCount * sizeof(GLVertexPOct),
+                     vertices, GL_STATIC_DRAW);
+
+        const GLsizei stride = sizeof(GLVertexPOct); // 16B
+
+        glEnableVertexAttribArray(0); // a_pos
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void*>(offsetof(GLVertexPOct, x)));
+
+        glEnableVertexAttribArray(1); // a_oct (normalized to [-1,1])
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride,
+                              reinterpret_cast<void*>(offsetof(GLVertexPOct, ox)));
+
+        // element buffer binding is VAO state, keep the VAO bound while uploading
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        if (vertexCount <= 0x10000) {
+            std::vector<GLushort> narrow(indices, indices + indexCountIn);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         narrow.size() * sizeof(GLushort),
+                         narrow.data(), GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         indexCountIn * sizeof(GLuint),
+                         indices, GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_INT;
+        }
+
+        glBindVertexArray(0);
+        indexCount = static_cast<GLsizei>(indexCountIn);
+        byteSize = vertexCount * sizeof(GLVertexPOct) +
+                   indexCountIn * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+    }
+
+    void draw() const {
+        glBindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, nullptr);
+        glBindVertexArray(0);
+    }
+
+    // index ranges [firsts[i], firsts[i] + counts[i]) in one glMultiDrawElements
+    void drawRanges(const std::vector<GLsizei> &counts, const std::vector<GLuint> &firsts) const {
+        const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        std::vector<const void*> offsets(firsts.size());
+        for (size_t i = 0; i < firsts.size(); i++)
+            offsets[i] = reinterpret_cast<const void*>(size_t(firsts[i]) * indexSize);
+        glBindVertexArray(vao);
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), indexType, offsets.data(),
+                            static_cast<GLsizei>(counts.size()));
+        glBindVertexArray(0);
+    }
+
+    void destroy() {
+        if (ebo) glDeleteBuffers(1, &ebo);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (vao) glDeleteVertexArrays(1, &vao);
+        vao = vbo = ebo = 0;
+        indexCount = 0;
+        byteSize = 0;
+    }
+};
+
+// CDLOD patch grid: a (dim+1)^2 vec2 grid over [0,1]^2 at attribute 0, drawn
+// instanced with one vec4 per patch (min corner.xy, size, lod level) at attribute 1.
+struct GLPatchGrid{
+    GLuint vao = 0, vbo = 0, ebo = 0, instanceVbo = 0;
+    GLsizei indexCount = 0;
+    GLsizei instanceCount = 0;
+    int dim = 0;
+
+    void create(int gridDim){
+        if (vao) destroy();
+        dim = gridDim;
+
+        std::vector<GLfloat> verts;
+        verts.reserve(size_t(dim + 1) * (dim + 1) * 2);
+        for (int j = 0; j <= dim; j++) {
+            for (int i = 0; i <= dim; i++) {
+                verts.push_back(float(i) / dim);
+                verts.push_back(float(j) / dim);
+            }
+        }
+        // same winding as the terrain mesh (x = first axis, y = second)
+        std::vector<GLushort> idx;
+        idx.reserve(size_t(dim) * dim * 6);
+        for (int j = 0; j < dim; j++) {
+            for (int i = 0; i < dim; i++) {
+                GLushort i1 = GLushort(j * (dim + 1) + i);
+                GLushort i2 = GLushort(i1 + 1);
+                GLushort i3 = GLushort(i2 + (dim + 1));
+                GLushort i4 = GLushort(i1 + (dim + 1));
+                idx.insert(idx.end(), {i1, i2, i3, i1, i3, i4});
+            }
+        }
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(GLfloat), verts.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0); // a_grid
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
+
+        glGenBuffers(1, &instanceVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(1); // a_patch
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)0);
+        glVertexAttribDivisor(1, 1);
+
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLushort), idx.data(), GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        indexCount = static_cast<GLsizei>(idx.size());
+    }
+
+    // instances: tightly packed vec4 array (e.g. CDLODQuadtree::Patch)
+    void uploadInstances(const void *instances, size_t count){
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, count * 4 * sizeof(GLfloat), instances, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        instanceCount = static_cast<GLsizei>(count);
+    }
+
+    void draw() const {
+        if (instanceCount <= 0) return;
+        glBindVertexArray(vao);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, nullptr, instanceCount);
+        glBindVertexArray(0);
+    }
+
+    void destroy() {
+        if (ebo) glDeleteBuffers(1, &ebo);
+        if (instanceVbo) glDeleteBuffers(1, &instanceVbo);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (vao) glDeleteVertexArrays(1, &vao);
+        vao = vbo = ebo = instanceVbo = 0;
+        indexCount = instanceCount = 0;
+        dim = 0;
+    }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace ParallelUtils {
+
+// worker count used when a caller asks for 0 ("auto")
+inline int defaultWorkerCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? int(n) : 1;
+}
+
+/**
+ * @brief Split [begin, end) into contiguous bands and run fn(bandBegin, bandEnd) on each.
+ * @param workers Number of bands / threads (0 = hardware concurrency). The calling
+ *                thread runs the first band itself, so workers == 1 is fully serial.
+ * fn must only write to data owned by its own band; bands never overlap.
+ */
+template <typename Fn>
+void forBands(int begin, int end, int workers, Fn &&fn) {
+    const int count = end - begin;
+    if (count <= 0) return;
+    if (workers <= 0) workers = defaultWorkerCount();
+    workers = std::min(workers, count);
+
+    if (workers == 1) {
+        fn(begin, end);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+
+    // band i covers [begin + i*count/workers, begin + (i+1)*count/workers)
+    auto bandStart = [&](int i) { return begin + int((long long)count * i / workers); };
+    for (int i = 1; i < workers; ++i) {
+        threads.emplace_back([&, i] { fn(bandStart(i), bandStart(i + 1)); });
+    }
+    fn(bandStart(0), bandStart(1));
+
+    for (std::thread &t : threads) t.join();
+}
+
+} // namespace ParallelUtils
@@ -0,0 +1,216 @@
+#include "world_bake.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+constexpr char kMagic[4] = {'A', 'M', 'W', 'B'};
+
+enum SectionId : uint32_t {
+    kHeights,
+    kVertices,
+    kIndices,
+    kBranchModels,
+    kBranchRadii,
+    kLeaves,
+    kRocks,
+    kSectionCount
+};
+
+struct Header {
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+    int32_t  resolution;
+    uint32_t sectionCount;
+};
+
+struct Section {
+    uint32_t id;
+    uint32_t elemSize; // sizeof one element, checked on load
+    uint64_t offset;   // from the start of the file
+    uint64_t count;    // elements
+};
+
+constexpr uint64_t align16(uint64_t v) { return (v + 15) & ~uint64_t(15); }
+
+// FNV-1a, same construction as the terrain stage keys
+struct Fnv {
+    uint64_t value = 14695981039346656037ull;
+    template <typename T>
+    void add(const T &v) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+    }
+};
+
+// keeps the WorldBake::kMaxBakes most recently written bakes in dir
+void evictBakes(const QString &dir)
+{
+    const QFileInfoList bakes = QDir(dir).entryInfoList({"world-*.bake"}, QDir::Files, QDir::Time);
+    for (qsizetype i = WorldBake::kMaxBakes; i < bakes.size(); i++)
+        QFile::remove(bakes[i].absoluteFilePath());
+}
+
+} // namespace
+
+uint64_t WorldBake::key(const TerrainGenerator::TerrainParams &params, int resolution,
+                        std::initializer_list<int> extra)
+{
+    Fnv h;
+    h.add(kVersion);
+    h.add(TerrainGenerator::paramsKey(params));
+    h.add(resolution);
+    for (int v : extra) h.add(v);
+    return h.value;
+}
+
+QString WorldBake::pathFor(uint64_t key)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return dir + QString("/world-%1.bake").arg(quint64(key), 16, 16, QChar('0'));
+}
+
+bool WorldBake::write(const QString &path, uint64_t key, const Contents &c)
+{
+    struct Blob { const void *data; uint32_t elemSize; uint64_t count; };
+    const Blob blobs[kSectionCount] = {
+        {c.heights.data(),      sizeof(float),                           c.heights.size()},
+        {c.vertices.data(),     sizeof(TerrainGenerator::TerrainVertex), c.vertices.size()},
+        {c.indices.data(),      sizeof(uint32_t),                        c.indices.size()},
+        {c.branchModels.data(), sizeof(glm::mat4),                       c.branchModels.size()},
+        {c.branchRadii.data(),  sizeof(float),                           c.branchRadii.size()},
+        {c.leaves.data(),       sizeof(glm::mat4),                       c.leaves.size()},
+        {c.rocks.data(),        sizeof(glm::mat4),                       c.rocks.size()},
+    };
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.key = key;
+    header.resolution = c.resolution;
+    header.sectionCount = kSectionCount;
+
+    Section sections[kSectionCount];
+    uint64_t offset = align16(sizeof(Header) + sizeof(sections));
+    for (uint32_t i = 0; i < kSectionCount; i++) {
+        sections[i] = {i, blobs[i].elemSize, offset, blobs[i].count};
+        offset = align16(offset + blobs[i].count * blobs[i].elemSize);
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    const char zeros[16] = {};
+    auto padTo = [&](uint64_t pos) {
+        if (uint64_t(file.pos()) < pos) file.write(zeros, qint64(pos - file.pos()));
+    };
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(sections), sizeof(sections));
+    for (uint32_t i = 0; i < kSectionCount; i++) {
+        padTo(sections[i].offset);
+        if (blobs[i].count)
+            file.write(static_cast<const char *>(blobs[i].data), qint64(blobs[i].count * blobs[i].elemSize));
+    }
+    padTo(offset);
+
+    if (!file.commit()) {
+        std::cerr << "[WorldBake] failed to write " << path.toStdString() << "\n";
+        return false;
+    }
+    evictBakes(QFileInfo(path).absolutePath());
+    return true;
+}
+
+bool WorldBake::open(const QString &path, uint64_t key)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(Header) + kSectionCount * sizeof(Section))) {
+        close();
+        return false;
+    }
+
+    m_map = m_file.map(0, size);
+    if (!m_map) {
+        close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, m_map, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.key != key || header.sectionCount != kSectionCount || header.resolution <= 0) {
+        close();
+        return false;
+    }
+
+    static constexpr uint32_t kElemSize[kSectionCount] = {
+        sizeof(float), sizeof(TerrainGenerator::TerrainVertex), sizeof(uint32_t),
+        sizeof(glm::mat4), sizeof(float), sizeof(glm::mat4), sizeof(glm::mat4),
+    };
+
+    const void *data[kSectionCount] = {};
+    size_t count[kSectionCount] = {};
+    for (uint32_t i = 0; i < kSectionCount; i++) {
+        Section s;
+        std::memcpy(&s, m_map + sizeof(Header) + i * sizeof(Section), sizeof(s));
+        const bool fits = s.offset % 16 == 0 && s.offset <= uint64_t(size) &&
+                          s.count <= (uint64_t(size) - s.offset) / kElemSize[i];
+        if (s.id != i || s.elemSize != kElemSize[i] || !fits) {
+            close();
+            return false;
+        }
+        data[i] = m_map + s.offset;
+        count[i] = size_t(s.count);
+    }
+
+    const size_t stride = size_t(header.resolution) + 3;
+    if (count[kHeights] != stride * stride || count[kBranchRadii] != count[kBranchModels]) {
+        close();
+        return false;
+    }
+
+    // the terrain goes straight to glDrawElements: whole triangles, every index in range
+    const uint32_t *indices = static_cast<const uint32_t *>(data[kIndices]);
+    if (count[kVertices] == 0 || count[kIndices] == 0 || count[kIndices] % 3 != 0 ||
+        *std::max_element(indices, indices + count[kIndices]) >= count[kVertices]) {
+        close();
+        return false;
+    }
+
+    Contents &c = m_contents;
+    c.resolution = header.resolution;
+    c.heights      = {static_cast<const float *>(data[kHeights]), count[kHeights]};
+    c.vertices     = {static_cast<const TerrainGenerator::TerrainVertex *>(data[kVertices]), count[kVertices]};
+    c.indices      = {static_cast<const uint32_t *>(data[kIndices]), count[kIndices]};
+    c.branchModels = {static_cast<const glm::mat4 *>(data[kBranchModels]), count[kBranchModels]};
+    c.branchRadii  = {static_cast<const float *>(data[kBranchRadii]), count[kBranchRadii]};
+    c.leaves       = {static_cast<const glm::mat4 *>(data[kLeaves]), count[kLeaves]};
+    c.rocks        = {static_cast<const glm::mat4 *>(data[kRocks]), count[kRocks]};
+    return true;
+}
+
+void WorldBake::close()
+{
+    if (m_map) m_file.unmap(m_map);
+    m_map = nullptr;
+    if (m_file.isOpen()) m_file.close();
+    m_contents = Contents();
+}
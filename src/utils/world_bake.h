@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <QFile>
+#include <QString>
+#include "glm/glm.hpp"
+#include "terrain/terraingenerator.h"
+
+// Versioned binary snapshot of everything settingsChanged() generates for one set
+// of settings: the heightfield, the packed terrain vertex/index buffers (normals
+// live in the vertices, octahedral) and the forest/rock instance matrices.
+//
+// Layout (native endianness, every section 16-byte aligned):
+//   Header | Section[sectionCount] | section data ...
+// A file is only accepted when its magic, version, key and every section's
+// element size and extent check out, and its terrain mesh is non-empty with whole
+// triangles and indices in range; anything else counts as a miss.
+//
+// open() memory-maps the file, and the spans in contents() point straight into
+// the mapping, so uploads read from the page cache without an intermediate copy.
+// The mapping stays valid until close() or destruction.
+class WorldBake
+{
+public:
+    static constexpr uint32_t kVersion = 1;
+    // bakes kept in a directory; write() deletes the least recently written ones
+    static constexpr int kMaxBakes = 8;
+
+    struct Contents {
+        int resolution = 0;                                // heightfield quads per side
+        std::span<const float> heights;                    // Heightfield::heights, apron included
+        std::span<const TerrainGenerator::TerrainVertex> vertices;
+        std::span<const uint32_t> indices;
+        std::span<const glm::mat4> branchModels;
+        std::span<const float> branchRadii;                // one per branch model
+        std::span<const glm::mat4> leaves;
+        std::span<const glm::mat4> rocks;
+    };
+
+    WorldBake() = default;
+    ~WorldBake() { close(); }
+    WorldBake(const WorldBake &) = delete;
+    WorldBake &operator=(const WorldBake &) = delete;
+
+    // Key of a bake: terrain params, heightfield resolution and any extra integer
+    // settings the contents depend on (forest/rock sliders).
+    static uint64_t key(const TerrainGenerator::TerrainParams &params, int resolution,
+                        std::initializer_list<int> extra);
+
+    // <cache location>/world-<key>.bake
+    static QString pathFor(uint64_t key);
+
+    // Writes atomically (QSaveFile): a crash mid-write never leaves a partial bake.
+    // Then drops all but the kMaxBakes newest bakes next to it.
+    static bool write(const QString &path, uint64_t key, const Contents &contents);
+
+    // Maps path and validates it against key; false (and nothing mapped) on a miss.
+    bool open(const QString &path, uint64_t key);
+    void close();
+
+    bool isOpen() const { return m_map != nullptr; }
+    const Contents &contents() const { return m_contents; }
+
+private:
+    QFile m_file;
+    uchar *m_map = nullptr;
+    Contents m_contents;
+};